@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "aot_runtime.h"
+
+// Runs bench/aot_workload.ski compiled by ski-compile and interpreted by the graph engine, with
+// and without jets, and reports the best wall time of each from source to printed normal forms.
+// Every path must print the same normal forms.
+extern const Ski::Aot::Program aot_workload_program;
+
+static void print_usage() { std::cerr << "Usage: aot_bench [--repeats=N]\n"; }
+
+int main(int argc, char** argv) {
+  unsigned long repeats = 5;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--repeats=", 0) == 0) {
+      repeats = std::max(1ul, std::strtoul(arg.c_str() + arg.find('=') + 1, nullptr, 10));
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  std::ifstream file(SKI_AOT_WORKLOAD);
+  if (!file) {
+    std::cerr << "Failed to open file: " << SKI_AOT_WORKLOAD << "\n";
+    return 1;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string program = buffer.str();
+
+  auto interpret = [&](bool jets) {
+    Ski::Tokenizer tokenizer(program, "aot_workload.ski");
+    Ski::Parser parser(tokenizer, "aot_workload.ski");
+    Ski::InterpreterOptions options;
+    options.engine = Ski::Engine::kGraph;
+    options.jets = jets;
+    Ski::Interpreter interpreter(parser.parse(), options);
+    std::ostringstream output;
+    interpreter.interpret_exprs(output);
+    return output.str();
+  };
+  auto compiled = [] {
+    std::ostringstream output;
+    std::ostringstream errors;
+    Ski::Aot::run(aot_workload_program, output, errors);
+    return output.str();
+  };
+  struct Path {
+    const char* name;
+    std::function<std::string()> run;
+  };
+  Path paths[] = {{"graph", [&] { return interpret(true); }},
+                  {"graph --no-jets", [&] { return interpret(false); }},
+                  {"compiled", compiled}};
+
+  std::string expected;
+  double baseline = 0;
+  std::cout << "path             seconds  speedup\n";
+  for (const Path& path : paths) {
+    double best = 0;
+    for (unsigned long repeat = 0; repeat < repeats; repeat++) {
+      auto start = std::chrono::steady_clock::now();
+      std::string output = path.run();
+      double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (expected.empty())
+        expected = output;
+      if (output != expected) {
+        std::cerr << "Normal forms of " << path.name << " differ from the graph engine's\n";
+        return 1;
+      }
+      best = repeat ? std::min(best, seconds) : seconds;
+    }
+    if (!baseline)
+      baseline = best;
+    std::cout << std::left << std::setw(15) << path.name << std::right << std::setw(9)
+              << std::fixed << std::setprecision(3) << best << std::setw(9)
+              << std::setprecision(2) << baseline / best << "\n";
+  }
+  return 0;
+}
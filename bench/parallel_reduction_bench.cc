@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+
+// Reduces one program with the tree engine on 1, 2, 4, ... threads and reports how the wall time
+// scales. Every run must print the same normal forms as the single threaded one.
+static const char* kDefaultProgram = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def _3  = inc _2;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I (S K))))(c2 I first);
+
+(_3 fib (pair _1 _1)) first f x;
+)";
+
+static void print_usage() {
+  std::cerr << "Usage: parallel_reduction_bench [--max-threads=N] [--threshold=N] "
+               "[ski-program-path]\n";
+}
+
+int main(int argc, char** argv) {
+  unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+  uint32_t threshold = Ski::InterpreterOptions().subterm_threshold;
+  std::string program = kDefaultProgram;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--max-threads=", 0) == 0) {
+      max_threads = std::max(1ul, std::strtoul(arg.c_str() + arg.find('=') + 1, nullptr, 10));
+    } else if (arg.rfind("--threshold=", 0) == 0) {
+      threshold = std::strtoul(arg.c_str() + arg.find('=') + 1, nullptr, 10);
+    } else if (arg[0] != '-') {
+      std::ifstream file(arg);
+      if (!file) {
+        std::cerr << "Failed to open file: " << arg << "\n";
+        return 1;
+      }
+      std::stringstream buffer;
+      buffer << file.rdbuf();
+      program = buffer.str();
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  auto interpret = [&](unsigned threads) {
+    Ski::Tokenizer tokenizer(program, "bench.ski");
+    Ski::Parser parser(tokenizer, "bench.ski");
+    Ski::InterpreterOptions options;
+    options.subterm_threads = threads;
+    options.subterm_threshold = threshold;
+    Ski::Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  // An untimed serial run provides the expected output and brings the node pool to the state every
+  // later run starts from.
+  std::vector<std::string> expected = interpret(1);
+  double serial_seconds = 0;
+  std::cout << "threads  seconds  speedup\n";
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    auto start = std::chrono::steady_clock::now();
+    auto outputs = interpret(threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (outputs != expected) {
+      std::cerr << "Normal forms on " << threads << " threads differ from the serial run\n";
+      return 1;
+    }
+    if (threads == 1)
+      serial_seconds = seconds;
+    std::cout << std::setw(7) << threads << std::setw(9) << std::fixed << std::setprecision(3)
+              << seconds << std::setw(9) << std::setprecision(2) << serial_seconds / seconds
+              << "\n";
+  }
+  return 0;
+}
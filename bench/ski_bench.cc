@@ -0,0 +1,373 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+
+// Runs scalable workloads through each phase of the interpreter and reports, per phase, the wall
+// time, heap allocations and peak RSS as JSON, so that builds and engines can be compared. Each
+// run happens in a child process, so its peak RSS is its own.
+
+// Every allocation of the process goes through these, so each phase can count its own.
+static std::atomic<size_t> heap_allocations{0};
+static std::atomic<size_t> heap_bytes{0};
+
+void* operator new(size_t size) {
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  heap_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(size ? size : 1))
+    return pointer;
+  throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+
+static const char* kChurchDefinitions = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def _0  = S K;
+def inc = S (S (K S) K);
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def mul = c1;
+)";
+
+static const char* kFibDefinitions = R"(
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def second = S K;
+def _1  = inc _0;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I second)))(c2 I first);
+)";
+
+// Definitions of the numerals 1 to n as n_1 = inc _0, n_2 = inc n_1, ...
+static std::string numerals(uint32_t n) {
+  std::string program;
+  for (uint32_t i = 1; i <= n; i++) {
+    std::string previous = i == 1 ? "_0" : "n_" + std::to_string(i - 1);
+    program += "def n_" + std::to_string(i) + " = inc " + previous + ";\n";
+  }
+  return program;
+}
+
+struct Workload {
+  std::string name;
+  std::vector<uint32_t> sizes;
+  // The tree engine copies shared arguments, so its cost explodes on larger sizes of most
+  // workloads. Sizes above this only run on the graph and bytecode engines.
+  uint32_t tree_max_size;
+  std::function<std::string(uint32_t)> program;
+};
+
+static const std::vector<Workload> kWorkloads = {
+    // add n n f x: 2n applications of f.
+    {"church_add",
+     {64, 256, 1024, 4096},
+     1024,
+     [](uint32_t n) {
+       return kChurchDefinitions + numerals(n) + "add n_" + std::to_string(n) + " n_" +
+              std::to_string(n) + " f x;\n";
+     }},
+    // mul n n f x: n * n applications of f.
+    {"church_mul",
+     {4, 8, 16, 32, 64},
+     8,
+     [](uint32_t n) {
+       return kChurchDefinitions + numerals(n) + "mul n_" + std::to_string(n) + " n_" +
+              std::to_string(n) + " f x;\n";
+     }},
+    // The fibbonacci.ski iteration applied depth times to (1, 1).
+    {"fib",
+     {1, 2, 3, 8, 16},
+     3,
+     [](uint32_t depth) {
+       return kChurchDefinitions + std::string(kFibDefinitions) + numerals(depth) + "(n_" +
+              std::to_string(depth) + " fib (pair _1 _1)) first;\n";
+     }},
+    // S I I (S I I (... x)) nested depth times, whose normal form has 2^depth leaves.
+    {"sii_chain",
+     {4, 8, 12, 16},
+     16,
+     [](uint32_t depth) {
+       std::string program;
+       for (uint32_t i = 0; i < depth; i++)
+         program += "S I I (";
+       program += "x" + std::string(depth, ')') + ";\n";
+       return program;
+     }},
+    // Thousands of small definitions, each used through the ones after it, with an expression
+    // every thousand definitions. Dominated by tokenizing, parsing and resolving.
+    {"wide",
+     {1000, 10000, 100000},
+     100000,
+     [](uint32_t n) {
+       std::string program = "def w_0 = I;\n";
+       for (uint32_t i = 1; i < n; i++)
+         program += "def w_" + std::to_string(i) + " = S (K w_" + std::to_string((i - 1) / 2) +
+                    ") I;\n";
+       for (uint32_t i = 999; i < n; i += 1000)
+         program += "w_" + std::to_string(i) + " x;\n";
+       return program;
+     }},
+};
+
+struct PhaseStats {
+  double seconds = 0;
+  size_t allocations = 0;
+  size_t allocated_bytes = 0;
+  long peak_rss_kb = 0;
+};
+
+static long peak_rss_kb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Runs phase and records what it cost. Peak RSS is the high-water mark of the run so far.
+template <typename Phase> static PhaseStats measure(Phase&& phase) {
+  size_t allocations = heap_allocations.load();
+  size_t bytes = heap_bytes.load();
+  auto start = std::chrono::steady_clock::now();
+  phase();
+  PhaseStats stats;
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.allocations = heap_allocations.load() - allocations;
+  stats.allocated_bytes = heap_bytes.load() - bytes;
+  stats.peak_rss_kb = peak_rss_kb();
+  return stats;
+}
+
+static const char* engine_name(Ski::Engine engine) {
+  switch (engine) {
+  case Ski::Engine::kGraph:
+    return "graph";
+  case Ski::Engine::kBytecode:
+    return "bytecode";
+  default:
+    return "tree";
+  }
+}
+
+static const char* strategy_name(Ski::Strategy strategy) {
+  switch (strategy) {
+  case Ski::Strategy::kLeftmostOutermost:
+    return "leftmost-outermost";
+  case Ski::Strategy::kLeftmostInnermost:
+    return "leftmost-innermost";
+  default:
+    return "full-pass";
+  }
+}
+
+static void write_phase(std::ostream& json, const char* name, const PhaseStats& stats) {
+  json << "\"" << name << "\": {\"seconds\": " << stats.seconds
+       << ", \"allocations\": " << stats.allocations
+       << ", \"allocated_bytes\": " << stats.allocated_bytes
+       << ", \"peak_rss_kb\": " << stats.peak_rss_kb << "}";
+}
+
+// One run of a workload, as a JSON object.
+static std::string run(const std::string& workload, uint32_t size, const std::string& program,
+                       const Ski::InterpreterOptions& options) {
+  std::unique_ptr<std::vector<Ski::Token>> tokens;
+  std::unique_ptr<Ski::Ski> ski_ast;
+  std::unique_ptr<Ski::Interpreter> interpreter;
+  std::vector<Ski::Term> exprs;
+  std::vector<std::string> outputs;
+  // The parser reads materialized tokens here, so that tokenizing and parsing are timed apart.
+  PhaseStats tokenize = measure([&] {
+    Ski::Tokenizer tokenizer(program, workload);
+    tokens = tokenizer.tokenize();
+  });
+  size_t token_count = tokens ? tokens->size() : 0;
+  PhaseStats parse = measure([&] {
+    Ski::Parser parser(std::move(tokens), workload);
+    ski_ast = parser.parse();
+  });
+  if (!ski_ast)
+    throw std::runtime_error(workload + ": Invalid program!");
+  PhaseStats resolve = measure([&] {
+    interpreter = std::make_unique<Ski::Interpreter>(std::move(ski_ast), options);
+    exprs = interpreter->resolve_exprs();
+  });
+  PhaseStats reduce = measure([&] { outputs = interpreter->reduce_exprs(exprs); });
+
+  size_t reductions = 0;
+  for (auto& stats : interpreter->get_reduction_stats())
+    reductions += stats.steps;
+  size_t nodes = 0;
+  for (auto& stats : interpreter->get_allocation_stats())
+    nodes += stats.nodes;
+  // Hashing the normal forms lets runs on other builds and engines be checked for agreement, so
+  // it is FNV-1a rather than the library's std::hash.
+  size_t normal_form_bytes = 0;
+  uint64_t normal_form_hash = 0xcbf29ce484222325ull;
+  for (auto& output : outputs) {
+    normal_form_bytes += output.size() + 1;
+    for (char c : output + ";")
+      normal_form_hash = (normal_form_hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+  }
+
+  std::ostringstream json;
+  json << "{\"workload\": \"" << workload << "\", \"size\": " << size << ", \"engine\": \""
+       << engine_name(options.engine) << "\", \"strategy\": \"" << strategy_name(options.strategy)
+       << "\", \"phases\": {";
+  write_phase(json, "tokenize", tokenize);
+  json << ", ";
+  write_phase(json, "parse", parse);
+  json << ", ";
+  write_phase(json, "resolve", resolve);
+  json << ", ";
+  write_phase(json, "reduce", reduce);
+  json << "}, \"source_bytes\": " << program.size() << ", \"tokens\": " << token_count
+       << ", \"terms\": " << interpreter->get_term_store().size()
+       << ", \"reductions\": " << reductions << ", \"reductions_per_second\": "
+       << (reduce.seconds > 0 ? reductions / reduce.seconds : 0) << ", \"nodes\": " << nodes
+       << ", \"normal_form_bytes\": " << normal_form_bytes << ", \"normal_form_hash\": \""
+       << std::hex << normal_form_hash << std::dec << "\"}";
+  return json.str();
+}
+
+// Runs one workload in a child process and returns its JSON object, or an error object if the
+// child failed.
+static std::string run_isolated(const std::string& workload, uint32_t size,
+                                const std::string& program,
+                                const Ski::InterpreterOptions& options) {
+  int fds[2];
+  if (pipe(fds) != 0)
+    throw std::runtime_error("Failed to create a pipe!");
+  pid_t pid = fork();
+  if (pid < 0)
+    throw std::runtime_error("Failed to fork!");
+  if (pid == 0) {
+    close(fds[0]);
+    std::string json;
+    try {
+      json = run(workload, size, program, options);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      _exit(1);
+    }
+    for (size_t written = 0; written < json.size();) {
+      ssize_t bytes = write(fds[1], json.data() + written, json.size() - written);
+      if (bytes <= 0)
+        _exit(1);
+      written += bytes;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  std::string json;
+  char buffer[4096];
+  for (ssize_t bytes; (bytes = read(fds[0], buffer, sizeof(buffer))) > 0;)
+    json.append(buffer, bytes);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || json.empty()) {
+    return "{\"workload\": \"" + workload + "\", \"size\": " + std::to_string(size) +
+           ", \"engine\": \"" + engine_name(options.engine) + "\", \"error\": \"run failed\"}";
+  }
+  return json;
+}
+
+static void print_usage() {
+  std::cerr << "Usage: ski_bench [--engine=tree|graph|bytecode] "
+               "[--strategy=full-pass|leftmost-outermost|leftmost-innermost] [--workload=NAME] "
+               "[--max-size=N] [--no-jets]\n"
+               "Workloads:";
+  for (auto& workload : kWorkloads)
+    std::cerr << " " << workload.name;
+  std::cerr << "\n";
+}
+
+int main(int argc, char** argv) {
+  std::vector<Ski::Engine> engines = {Ski::Engine::kTree, Ski::Engine::kGraph,
+                                      Ski::Engine::kBytecode};
+  std::string only_workload;
+  uint32_t max_size = ~0u;
+  bool jets = true;
+  Ski::Strategy strategy = Ski::Strategy::kFullPass;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--engine=tree") {
+      engines = {Ski::Engine::kTree};
+    } else if (arg == "--engine=graph") {
+      engines = {Ski::Engine::kGraph};
+    } else if (arg == "--engine=bytecode") {
+      engines = {Ski::Engine::kBytecode};
+    } else if (arg == "--strategy=full-pass") {
+      strategy = Ski::Strategy::kFullPass;
+    } else if (arg == "--strategy=leftmost-outermost") {
+      strategy = Ski::Strategy::kLeftmostOutermost;
+    } else if (arg == "--strategy=leftmost-innermost") {
+      strategy = Ski::Strategy::kLeftmostInnermost;
+    } else if (arg.rfind("--workload=", 0) == 0) {
+      only_workload = arg.substr(arg.find('=') + 1);
+    } else if (arg.rfind("--max-size=", 0) == 0) {
+      char* end;
+      max_size = std::strtoul(arg.c_str() + arg.find('=') + 1, &end, 10);
+      if (*end) {
+        print_usage();
+        return 1;
+      }
+    } else if (arg == "--no-jets") {
+      jets = false;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+
+  std::vector<std::string> results;
+  try {
+    for (auto& workload : kWorkloads) {
+      if (!only_workload.empty() && workload.name != only_workload)
+        continue;
+      for (uint32_t size : workload.sizes) {
+        if (size > max_size)
+          continue;
+        std::string program = workload.program(size);
+        for (Ski::Engine engine : engines) {
+          if (engine == Ski::Engine::kTree && size > workload.tree_max_size)
+            continue;
+          Ski::InterpreterOptions options;
+          options.engine = engine;
+          options.jets = jets;
+          options.strategy = strategy;
+          results.push_back(run_isolated(workload.name, size, program, options));
+          std::cerr << workload.name << " " << size << " " << engine_name(engine) << " done\n";
+        }
+      }
+    }
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  if (results.empty()) {
+    print_usage();
+    return 1;
+  }
+  std::cout << "{\"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++)
+    std::cout << "  " << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+  std::cout << "]}\n";
+  return 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "interpreter.h"
+#include "term_store.h"
+
+namespace Ski {
+
+struct AotOptions {
+  // Name of the generated Ski::Aot::Program, which has external linkage.
+  std::string symbol = "ski_program";
+  // Leave out main, so that the program links into another one as a library.
+  bool library = false;
+  // Bounds on the symbolic reduction that derives each definition's function.
+  uint32_t max_arity = 8;
+  size_t max_steps = 1024;
+  size_t max_nodes = 4096;
+};
+
+// A node of a supercombinator body: a parameter, a term of the store, or an application of two
+// earlier nodes.
+struct BodyNode {
+  enum class Kind : uint8_t { kParam, kTerm, kApp };
+  Kind kind;
+  // kParam: index of the parameter. kTerm: the term. kApp: the children.
+  uint32_t left;
+  uint32_t right;
+};
+
+// A definition compiled to a function of its first arity arguments: the definition applied to
+// parameters x0 ... x(arity - 1) reduces in steps head reduction steps to body.
+struct Supercombinator {
+  std::string name;
+  Term term;
+  uint32_t arity;
+  size_t steps;
+  // Children come before their parents, and the root is last. Nodes may be shared.
+  std::vector<BodyNode> body;
+};
+
+// Ahead-of-time compiler from resolved programs to C++ source for aot_runtime.h. Every definition
+// whose head can be reduced without knowing its arguments becomes a function that builds the
+// result of those steps directly, so the argument count check and the rewiring of the graph are
+// decided at compile time. The generated program prints what ski prints for the source.
+class AotCompiler {
+public:
+  explicit AotCompiler(const TermStore& term_store, const AotOptions& options = {});
+  // Adds the expressions and assertions of a program and the definitions they use, resolving them
+  // in interpreter, whose store must be the one the compiler reads.
+  void add_program(Interpreter& interpreter);
+  // Compiles definition name if symbolic reduction gets anywhere. Returns whether it did.
+  bool add_definition(const std::string& name, Term term);
+  void add_expr(Term term) { exprs.push_back(term); }
+  void add_assertion(const ResolvedAssertion& assertion) { assertions.push_back(assertion); }
+  const std::vector<Supercombinator>& get_supercombinators() const { return supercombinators; }
+  // Writes the program as C++. source names it in failed assertion messages.
+  void emit(std::ostream& output, const std::string& source) const;
+
+private:
+  // Every term the program refers to, children before parents, starting with the combinators.
+  std::vector<Term> collect_terms() const;
+
+  const TermStore& term_store;
+  AotOptions options;
+  std::vector<Supercombinator> supercombinators;
+  // Terms of the compiled definitions, so a term compiled twice is only compiled once.
+  std::unordered_map<Term, size_t> compiled;
+  std::vector<Term> exprs;
+  std::vector<ResolvedAssertion> assertions;
+};
+
+// Body of a supercombinator with parameters named x0, x1, ... and minimal parentheses, cut off
+// with "..." after max_length characters.
+std::string format_body(const Supercombinator& supercombinator, const TermStore& term_store,
+                        size_t max_length = ~size_t{0});
+
+} // namespace Ski
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Runtime of the C++ programs ski-compile writes. It depends on nothing else in the repository, so
+// a generated program builds with this header alone.
+namespace Ski::Aot {
+
+using Ref = uint32_t;
+class Machine;
+
+// Value of TermEntry::right for combinators and variables.
+inline constexpr uint32_t kLeafEntry = ~0u;
+// The first eight terms of every program are S, K, I, B, C, S', B* and C', as in a TermStore.
+inline constexpr uint32_t kCombinators = 8;
+
+// A term of the program. Applications refer to earlier terms; a variable's left is its name.
+struct TermEntry {
+  uint32_t left;
+  uint32_t right;
+};
+
+// A definition compiled to a function. Applied to arity arguments x, the function overwrites
+// redex, the root of the application, with the result of steps head reduction steps.
+struct Definition {
+  const char* name;
+  uint32_t term;
+  uint32_t arity;
+  uint32_t steps;
+  void (*call)(Machine& machine, Ref redex, const Ref* x);
+};
+
+struct Assertion {
+  int line;
+  uint32_t left;
+  uint32_t right;
+};
+
+// Everything a compiled program consists of. Empty tables are null.
+struct Program {
+  // Source file named in failed assertion messages.
+  const char* source;
+  const TermEntry* terms;
+  size_t term_count;
+  const char* const* names;
+  const Definition* definitions;
+  size_t definition_count;
+  const uint32_t* exprs;
+  size_t expr_count;
+  const Assertion* assertions;
+  size_t assertion_count;
+};
+
+// Numbers terms structurally, so that equal terms get the same number however they are shared.
+// Leaves are numbered by their program terms, applications from term_count on.
+class TermNumbering {
+public:
+  explicit TermNumbering(size_t term_count) : next(static_cast<uint32_t>(term_count)) {}
+  uint32_t number(uint32_t left, uint32_t right) {
+    auto [it, inserted] = numbers.try_emplace(uint64_t{left} << 32 | right, next);
+    if (inserted)
+      next++;
+    return it->second;
+  }
+
+private:
+  std::unordered_map<uint64_t, uint32_t> numbers;
+  uint32_t next;
+};
+
+// Call-by-need graph reducer, like the graph engine of the interpreter without jets. A compiled
+// definition is a cell of its own, and once it heads enough arguments the definition's function
+// contracts them in one go. With fewer, that use is expanded into the definition's term and
+// reduced one combinator at a time.
+class Machine {
+public:
+  explicit Machine(const Program& program);
+  static Ref leaf(uint32_t term) { return kLeaf | term; }
+  Ref build(uint32_t term);
+  Ref app(Ref left, Ref right) {
+    cells.push_back({left, right});
+    normal.push_back(false);
+    return static_cast<Ref>(cells.size() - 1);
+  }
+  void set_app(Ref ref, Ref left, Ref right) { cells[ref] = {left, right}; }
+  void set_indirection(Ref ref, Ref target) { cells[ref] = {follow(target), kIndirection}; }
+  // The normal form of term, with every application in parentheses. Diverges if it has none.
+  std::string reduce(uint32_t term);
+  // The normal form of term, numbered in numbering. Shared cells are numbered once, so unlike
+  // printing this takes time linear in the graph.
+  uint32_t reduce_to_number(uint32_t term, TermNumbering& numbering);
+  // Contractions so far, counting every step a definition's function makes.
+  size_t get_steps() const { return steps; }
+
+private:
+  static constexpr Ref kLeaf = 1u << 31;
+  // Values of Cell::right that mark a cell as something other than an application.
+  static constexpr Ref kIndirection = ~0u; // left refers to the result of the reduction
+  static constexpr Ref kUnbuilt = ~0u - 1; // left is the term the cell stands for
+  static constexpr Ref kCompiled = ~0u - 2; // left is the definition the cell stands for
+  static constexpr uint32_t kNone = ~0u;
+
+  struct Cell {
+    Ref left;
+    Ref right;
+  };
+
+  static bool is_leaf(Ref ref) { return ref & kLeaf; }
+  static uint32_t leaf_term(Ref ref) { return ref & ~kLeaf; }
+  bool is_app(Ref ref) const { return !is_leaf(ref) && cells[ref].right < kCompiled; }
+  Ref follow(Ref ref) const {
+    while (!is_leaf(ref) && cells[ref].right == kIndirection)
+      ref = cells[ref].left;
+    return ref;
+  }
+  Ref resolve(Ref ref);
+  void expand(Ref ref, uint32_t term);
+  void whnf(Ref ref);
+  void normalize(Ref ref);
+  std::string to_string(Ref ref) const;
+  uint32_t number(Ref ref, TermNumbering& numbering) const;
+
+  const Program& program;
+  size_t steps = 0;
+  std::vector<Cell> cells;
+  std::vector<bool> normal;
+  // Cells built so far and the definition compiled for each term, indexed by term.
+  std::vector<Ref> built;
+  std::vector<uint32_t> definitions;
+  std::vector<Ref> spine;
+  std::vector<Ref> arguments;
+};
+
+inline Machine::Machine(const Program& program)
+    : program(program), built(program.term_count, kNone),
+      definitions(program.term_count, kNone) {
+  for (size_t i = 0; i < program.definition_count; i++) {
+    if (definitions[program.definitions[i].term] == kNone)
+      definitions[program.definitions[i].term] = static_cast<uint32_t>(i);
+  }
+}
+
+inline Ref Machine::build(uint32_t term) {
+  // Applications expand one level at a time as reduction reaches them. Terms are shared, so
+  // building through built keeps the sharing of the program.
+  if (program.terms[term].right == kLeafEntry)
+    return leaf(term);
+  if (built[term] == kNone) {
+    built[term] = definitions[term] != kNone ? app(definitions[term], kCompiled)
+                                             : app(term, kUnbuilt);
+  }
+  return built[term];
+}
+
+inline void Machine::expand(Ref ref, uint32_t term) {
+  // Building may grow cells, so the children are built first.
+  Ref left = build(program.terms[term].left);
+  Ref right = build(program.terms[term].right);
+  cells[ref] = {left, right};
+}
+
+inline Ref Machine::resolve(Ref ref) {
+  ref = follow(ref);
+  if (!is_leaf(ref) && cells[ref].right == kUnbuilt)
+    expand(ref, cells[ref].left);
+  return ref;
+}
+
+// Reduces the graph at ref to weak head normal form, updating every contracted redex in place.
+inline void Machine::whnf(Ref ref) {
+  static constexpr size_t kArity[kCombinators] = {3, 2, 1, 3, 3, 4, 4, 4};
+  spine.clear();
+  Ref current = ref;
+  while (true) {
+    current = resolve(current);
+    while (is_app(current)) {
+      spine.push_back(current);
+      current = resolve(cells[current].left);
+    }
+    if (!is_leaf(current)) {
+      const Definition& definition = program.definitions[cells[current].left];
+      if (spine.size() < definition.arity) {
+        // Only this use is expanded, so the other uses of the cell keep calling the function. A
+        // definition reduced on its own has to become its term, though.
+        if (spine.empty()) {
+          expand(current, definition.term);
+        } else {
+          Ref left = build(program.terms[definition.term].left);
+          Ref right = build(program.terms[definition.term].right);
+          cells[spine.back()].left = app(left, right);
+          current = cells[spine.back()].left;
+        }
+        continue;
+      }
+      // The function overwrites the redex root; x[0] is the first argument.
+      Ref redex = spine[spine.size() - definition.arity];
+      arguments.clear();
+      for (size_t i = 0; i < definition.arity; i++)
+        arguments.push_back(cells[spine[spine.size() - 1 - i]].right);
+      spine.resize(spine.size() - definition.arity);
+      steps += definition.steps;
+      definition.call(*this, redex, arguments.data());
+      current = redex;
+      continue;
+    }
+    uint32_t head = leaf_term(current);
+    // A free variable or an unsaturated combinator at the head.
+    if (head >= kCombinators || spine.size() < kArity[head])
+      return;
+    steps++;
+    size_t arity = kArity[head];
+    Ref redex = spine[spine.size() - arity];
+    Ref x[4];
+    for (size_t i = 0; i < arity; i++)
+      x[i] = cells[spine[spine.size() - 1 - i]].right;
+    spine.resize(spine.size() - arity);
+    switch (head) {
+    case 2:
+      // I x = x
+    case 1:
+      // K x y = x
+      set_indirection(redex, x[0]);
+      current = cells[redex].left;
+      continue;
+    case 0:
+      // S x y z = x z (y z)
+      set_app(redex, app(x[0], x[2]), app(x[1], x[2]));
+      break;
+    case 3:
+      // B x y z = x (y z)
+      set_app(redex, x[0], app(x[1], x[2]));
+      break;
+    case 4:
+      // C x y z = x z y
+      set_app(redex, app(x[0], x[2]), x[1]);
+      break;
+    case 5:
+      // S' c f g x = c (f x) (g x)
+      set_app(redex, app(x[0], app(x[1], x[3])), app(x[2], x[3]));
+      break;
+    case 6:
+      // B* c f g x = c (f (g x))
+      set_app(redex, x[0], app(x[1], app(x[2], x[3])));
+      break;
+    case 7:
+      // C' c f g x = c (f x) g
+      set_app(redex, app(x[0], app(x[1], x[3])), x[2]);
+      break;
+    }
+    current = redex;
+  }
+}
+
+inline void Machine::normalize(Ref ref) {
+  std::vector<Ref> pending{ref};
+  while (!pending.empty()) {
+    Ref current = resolve(pending.back());
+    pending.pop_back();
+    if (is_leaf(current) || normal[current])
+      continue;
+    whnf(current);
+    // The head can no longer be contracted, so the spine is final once its arguments are.
+    for (current = resolve(current); is_app(current); current = resolve(cells[current].left)) {
+      normal[current] = true;
+      pending.push_back(cells[current].right);
+    }
+  }
+}
+
+inline std::string Machine::to_string(Ref ref) const {
+  static const char* kNames[kCombinators] = {"S", "K", "I", "B", "C", "S'", "B*", "C'"};
+  // Either a cell, a program term (when term is set) or a literal character (when text is set)
+  // still to print.
+  struct Item {
+    Ref ref;
+    uint32_t term;
+    char text;
+  };
+  std::string output;
+  std::vector<Item> pending{{ref, kNone, 0}};
+  while (!pending.empty()) {
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    uint32_t term = item.term;
+    Ref current = 0;
+    if (term == kNone) {
+      current = follow(item.ref);
+      if (is_leaf(current))
+        term = leaf_term(current);
+      else if (cells[current].right >= kCompiled)
+        term = cells[current].right == kCompiled ? program.definitions[cells[current].left].term
+                                                 : cells[current].left;
+    }
+    if (term != kNone && program.terms[term].right == kLeafEntry) {
+      output += term < kCombinators ? kNames[term] : program.names[program.terms[term].left];
+      continue;
+    }
+    output += '(';
+    pending.push_back({0, 0, ')'});
+    if (term == kNone) {
+      pending.push_back({cells[current].right, kNone, 0});
+      pending.push_back({0, 0, ' '});
+      pending.push_back({cells[current].left, kNone, 0});
+      continue;
+    }
+    const TermEntry& entry = program.terms[term];
+    pending.push_back({0, entry.right, 0});
+    pending.push_back({0, 0, ' '});
+    pending.push_back({0, entry.left, 0});
+  }
+  return output;
+}
+
+inline uint32_t Machine::number(Ref ref, TermNumbering& numbering) const {
+  // Either a cell or, when term is set, a program term. Unbuilt and compiled cells stand for their
+  // program terms.
+  struct Item {
+    Ref ref;
+    uint32_t term;
+  };
+  auto item_of = [&](Ref ref) -> Item {
+    ref = follow(ref);
+    if (is_leaf(ref))
+      return {0, leaf_term(ref)};
+    if (cells[ref].right == kUnbuilt)
+      return {0, cells[ref].left};
+    if (cells[ref].right == kCompiled)
+      return {0, program.definitions[cells[ref].left].term};
+    return {ref, kNone};
+  };
+  std::unordered_map<Ref, uint32_t> cell_numbers;
+  std::vector<uint32_t> term_numbers(program.term_count, kNone);
+  auto number_of = [&](const Item& item) -> uint32_t {
+    if (item.term == kNone) {
+      auto it = cell_numbers.find(item.ref);
+      return it == cell_numbers.end() ? kNone : it->second;
+    }
+    return program.terms[item.term].right == kLeafEntry ? item.term : term_numbers[item.term];
+  };
+  // An item is numbered once both of its children are.
+  Item root = item_of(ref);
+  std::vector<Item> pending{root};
+  while (number_of(root) == kNone) {
+    Item item = pending.back();
+    if (number_of(item) != kNone) {
+      pending.pop_back();
+      continue;
+    }
+    Item left = item.term == kNone ? item_of(cells[item.ref].left)
+                                   : Item{0, program.terms[item.term].left};
+    Item right = item.term == kNone ? item_of(cells[item.ref].right)
+                                    : Item{0, program.terms[item.term].right};
+    uint32_t left_number = number_of(left);
+    uint32_t right_number = number_of(right);
+    if (left_number == kNone || right_number == kNone) {
+      if (left_number == kNone)
+        pending.push_back(left);
+      if (right_number == kNone)
+        pending.push_back(right);
+      continue;
+    }
+    uint32_t number = numbering.number(left_number, right_number);
+    if (item.term == kNone)
+      cell_numbers[item.ref] = number;
+    else
+      term_numbers[item.term] = number;
+    pending.pop_back();
+  }
+  return number_of(root);
+}
+
+inline uint32_t Machine::reduce_to_number(uint32_t term, TermNumbering& numbering) {
+  Ref root = build(term);
+  normalize(root);
+  return number(root, numbering);
+}
+
+inline std::string Machine::reduce(uint32_t term) {
+  Ref root = build(term);
+  normalize(root);
+  return to_string(root);
+}
+
+// Writes the normal form of every expression of program to output, one per line, and tells on
+// errors which assertions did not hold, as ski does for the source. Returns the exit status ski
+// would: 1 if an assertion failed, else 0.
+inline int run(const Program& program, std::ostream& output, std::ostream& errors) {
+  // Every expression starts from a fresh graph, as it does in the interpreter.
+  for (size_t i = 0; i < program.expr_count; i++) {
+    Machine machine(program);
+    output << machine.reduce(program.exprs[i]) << '\n';
+    output.flush();
+  }
+  // Normal forms are compared by number rather than printed, since a shared graph can print to
+  // a string exponentially longer than itself.
+  TermNumbering numbering(program.term_count);
+  bool held = true;
+  for (size_t i = 0; i < program.assertion_count; i++) {
+    const Assertion& assertion = program.assertions[i];
+    if (assertion.left == assertion.right)
+      continue;
+    Machine left(program);
+    Machine right(program);
+    if (left.reduce_to_number(assertion.left, numbering) ==
+        right.reduce_to_number(assertion.right, numbering))
+      continue;
+    errors << program.source << ":" << assertion.line
+           << ": assert_eq failed: the normal forms differ\n";
+    held = false;
+  }
+  return held ? 0 : 1;
+}
+
+} // namespace Ski::Aot
@@ -1,133 +1,366 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include "node_pool.h"
+#include "symbol_table.h"
+
 namespace Ski {
 
+enum class ExprKind : uint8_t { kVar, kS, kK, kI, kB, kC, kSPrime, kBStar, kCPrime, kApp };
+
+// Number of arguments a combinator needs before it can be contracted, or 0 for Var and App.
+inline int combinator_arity(ExprKind kind) {
+  switch (kind) {
+  case ExprKind::kI:
+    return 1;
+  case ExprKind::kK:
+    return 2;
+  case ExprKind::kS:
+  case ExprKind::kB:
+  case ExprKind::kC:
+    return 3;
+  case ExprKind::kSPrime:
+  case ExprKind::kBStar:
+  case ExprKind::kCPrime:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+// Finalizer of splitmix64. Spreads every input bit over the whole hash.
+inline uint64_t mix_hash(uint64_t hash) {
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111eb;
+  return hash ^ (hash >> 31);
+}
+
+// Hash of an application whose children hash to left and right. Multiplying the left hash keeps
+// the children's order, so f x and x f differ.
+inline uint64_t app_hash(uint64_t left, uint64_t right) {
+  return mix_hash(left * 0x9e3779b97f4a7c15 + right + static_cast<uint64_t>(ExprKind::kApp));
+}
+
 class Expr {
 public:
-  Expr() = default;
+  Expr(ExprKind kind) : hash(mix_hash(static_cast<uint64_t>(kind))), kind(kind) {}
   Expr(const Expr&) = default;
   virtual ~Expr() = default;
   virtual operator std::string() const = 0;
   virtual std::unique_ptr<Expr> clone() const = 0;
+  // Lets hot loops dispatch on the node kind without RTTI.
+  ExprKind get_kind() const { return kind; }
+  // Number of nodes in the tree rooted here.
+  uint32_t get_size() const { return size; }
+  // Structural hash of the tree rooted here, computed as it is built from the hashes of the
+  // children. Equal trees over one symbol table hash equally, so different hashes prove them
+  // different.
+  uint64_t get_hash() const { return hash; }
+
+  static void* operator new(std::size_t size) { return NodePool::allocate(size); }
+  static void operator delete(void* pointer, std::size_t size) {
+    NodePool::deallocate(pointer, size);
+  }
+
+protected:
+  uint64_t hash;
+  uint32_t size = 1;
+
+private:
+  ExprKind kind;
 };
 
+// Whether two trees are equal. Their hashes and sizes settle most comparisons at once, and equal
+// ones are confirmed node by node, so a hash collision cannot make different trees equal. Both
+// must name their variables in the same symbol table.
+bool equal_exprs(const Expr& a, const Expr& b);
+
+// How many parentheses printed applications get. kAll wraps every application, as in
+// "((S K) (K I))". kMinimal only wraps applications in argument position, the ones left
+// associativity cannot do without, as in "S K (K I)". Both read back as the same term.
+enum class Parens : uint8_t { kAll, kMinimal };
+
+// Prints expr in time linear in its size, with an explicit stack so that deep terms cannot
+// overflow the C stack. The string overload appends to output. The stream overload writes to
+// output in large chunks as it goes, so the whole text is never held at once.
+void print_expr(const Expr& expr, std::string& output, Parens parens = Parens::kAll);
+void print_expr(const Expr& expr, std::ostream& output, Parens parens = Parens::kAll);
+
 inline std::ostream& operator<<(std::ostream& os, const Expr& expr) {
-  os << static_cast<std::string>(expr);
+  print_expr(expr, os);
   return os;
 }
 
+// A free variable or a reference to a definition, named by its symbol in the program's table.
 class Var : public Expr {
 public:
   Var(const Var&) = default;
-  Var(std::string identifier) : identifier(std::move(identifier)) {}
-  operator std::string() const override { return identifier; }
-  const std::string& get_identifier() const { return identifier; }
+  Var(Symbol symbol, const SymbolTable& symbols)
+      : Expr(ExprKind::kVar), symbol(symbol), symbols(&symbols) {
+    hash = mix_hash((uint64_t{symbol} + 1) << 8 | static_cast<uint64_t>(ExprKind::kVar));
+  }
+  operator std::string() const override { return get_identifier(); }
+  Symbol get_symbol() const { return symbol; }
+  const SymbolTable& get_symbols() const { return *symbols; }
+  const std::string& get_identifier() const { return symbols->name(symbol); }
   std::unique_ptr<Expr> clone() const override { return std::make_unique<Var>(*this); }
 
 private:
-  std::string identifier;
+  Symbol symbol;
+  const SymbolTable* symbols;
 };
 
 class S : public Expr {
 public:
-  S() = default;
+  S() : Expr(ExprKind::kS) {}
   S(const S&) = default;
   operator std::string() const override { return "S"; }
   std::unique_ptr<Expr> clone() const override { return std::make_unique<S>(*this); }
-
-private:
-  char val = 'S';
 };
 
 class K : public Expr {
 public:
-  K() = default;
+  K() : Expr(ExprKind::kK) {}
   K(const K&) = default;
   operator std::string() const override { return "K"; }
   std::unique_ptr<Expr> clone() const override { return std::make_unique<K>(*this); }
-
-private:
-  char val = 'K';
 };
 
 class I : public Expr {
 public:
-  I() = default;
+  I() : Expr(ExprKind::kI) {}
   I(const I&) = default;
   operator std::string() const override { return "I"; }
   std::unique_ptr<Expr> clone() const override { return std::make_unique<I>(*this); }
+};
 
-private:
-  char val = 'I';
+class B : public Expr {
+public:
+  B() : Expr(ExprKind::kB) {}
+  B(const B&) = default;
+  operator std::string() const override { return "B"; }
+  std::unique_ptr<Expr> clone() const override { return std::make_unique<B>(*this); }
+};
+
+class C : public Expr {
+public:
+  C() : Expr(ExprKind::kC) {}
+  C(const C&) = default;
+  operator std::string() const override { return "C"; }
+  std::unique_ptr<Expr> clone() const override { return std::make_unique<C>(*this); }
+};
+
+class SPrime : public Expr {
+public:
+  SPrime() : Expr(ExprKind::kSPrime) {}
+  SPrime(const SPrime&) = default;
+  operator std::string() const override { return "S'"; }
+  std::unique_ptr<Expr> clone() const override { return std::make_unique<SPrime>(*this); }
+};
+
+class BStar : public Expr {
+public:
+  BStar() : Expr(ExprKind::kBStar) {}
+  BStar(const BStar&) = default;
+  operator std::string() const override { return "B*"; }
+  std::unique_ptr<Expr> clone() const override { return std::make_unique<BStar>(*this); }
+};
+
+class CPrime : public Expr {
+public:
+  CPrime() : Expr(ExprKind::kCPrime) {}
+  CPrime(const CPrime&) = default;
+  operator std::string() const override { return "C'"; }
+  std::unique_ptr<Expr> clone() const override { return std::make_unique<CPrime>(*this); }
 };
 
 class App : public Expr {
 public:
   App(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right)
-      : left(std::move(left)), right(std::move(right)) {}
-  App(const App& app) : left(app.left->clone()), right(app.right->clone()) {}
+      : Expr(ExprKind::kApp), left(std::move(left)), right(std::move(right)) {
+    update_summary();
+  }
+  App(const App& app) : Expr(app), left(app.left->clone()), right(app.right->clone()) {}
+  ~App() override {
+    // Destroying a deep application chain recursively can overflow the C stack, so unless the
+    // children are shallow, nested applications are detached onto a heap stack and destroyed
+    // childless.
+    if (is_shallow(left.get()) && is_shallow(right.get()))
+      return;
+    std::vector<std::unique_ptr<Expr>> pending;
+    pending.push_back(std::move(left));
+    pending.push_back(std::move(right));
+    while (!pending.empty()) {
+      std::unique_ptr<Expr> expr = std::move(pending.back());
+      pending.pop_back();
+      if (expr && expr->get_kind() == ExprKind::kApp) {
+        auto app = static_cast<App*>(expr.get());
+        pending.push_back(std::move(app->left));
+        pending.push_back(std::move(app->right));
+      }
+    }
+  }
   operator std::string() const override {
-    return "(" + (left ? static_cast<std::string>(*left) : "") + " " +
-           (right ? static_cast<std::string>(*right) : "") + ")";
+    std::string output;
+    print_expr(*this, output);
+    return output;
   }
   std::unique_ptr<Expr> move_left() { return std::move(left); }
   std::unique_ptr<Expr> move_right() { return std::move(right); }
   Expr* get_left() const { return left.get(); }
   Expr* get_right() const { return right.get(); }
-  void set_left(std::unique_ptr<Expr> expr) { left = std::move(expr); }
-  void set_right(std::unique_ptr<Expr> expr) { right = std::move(expr); }
+  // The size and hash are only kept up to date by the setters, not while a child is moved out.
+  void set_left(std::unique_ptr<Expr> expr) {
+    left = std::move(expr);
+    update_summary();
+  }
+  void set_right(std::unique_ptr<Expr> expr) {
+    right = std::move(expr);
+    update_summary();
+  }
   std::unique_ptr<Expr> clone() const override { return std::make_unique<App>(*this); }
 
 private:
+  void update_summary() {
+    size = 1 + (left ? left->get_size() : 0) + (right ? right->get_size() : 0);
+    hash = app_hash(left ? left->get_hash() : 0, right ? right->get_hash() : 0);
+  }
+
+  // True if expr has no application below its direct children.
+  static bool is_shallow(const Expr* expr) {
+    if (!expr || expr->get_kind() != ExprKind::kApp)
+      return true;
+    auto app = static_cast<const App*>(expr);
+    return (!app->left || app->left->get_kind() != ExprKind::kApp) &&
+           (!app->right || app->right->get_kind() != ExprKind::kApp);
+  }
+
   std::unique_ptr<Expr> left;
   std::unique_ptr<Expr> right;
 };
 
 class Defn {
 public:
-  Defn(std::string identifier, std::unique_ptr<Expr> expr)
-      : identifier(identifier), expr(std::move(expr)) {}
-  const std::string& get_identifier() const { return identifier; }
+  Defn(Symbol symbol, const SymbolTable& symbols, std::unique_ptr<Expr> expr)
+      : symbol(symbol), symbols(&symbols), expr(std::move(expr)) {}
+  Symbol get_symbol() const { return symbol; }
+  const std::string& get_identifier() const { return symbols->name(symbol); }
   Expr* get_expr() const { return expr.get(); }
   operator std::string() const {
-    return "def " + identifier + " = " + static_cast<std::string>(*expr);
+    std::string output = "def " + get_identifier() + " = ";
+    print_expr(*expr, output);
+    return output;
   }
 
 private:
-  std::string identifier;
+  Symbol symbol;
+  const SymbolTable* symbols;
   std::unique_ptr<Expr> expr;
 };
 
+// An assert_eq statement, which holds if both sides have the same normal form.
+class Assertion {
+public:
+  Assertion(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, int line)
+      : left(std::move(left)), right(std::move(right)), line(line) {}
+  const Expr& get_left() const { return *left; }
+  const Expr& get_right() const { return *right; }
+  // Source line of the statement.
+  int get_line() const { return line; }
+  operator std::string() const {
+    std::string output = "assert_eq ";
+    print_expr(*left, output);
+    output += " ";
+    print_expr(*right, output);
+    return output;
+  }
+
+private:
+  std::unique_ptr<Expr> left;
+  std::unique_ptr<Expr> right;
+  int line;
+};
+
 class Ski {
 public:
+  // definitions holds the body of each defined symbol at its index, and null elsewhere.
   Ski(std::vector<std::unique_ptr<Defn>> defns, std::vector<std::unique_ptr<Expr>> exprs,
-      std::vector<std::string> ordered_defs, std::unordered_map<std::string, Expr*> def_map)
-      : defns(std::move(defns)), exprs(std::move(exprs)), ordered_defs(std::move(ordered_defs)),
-        def_map(std::move(def_map)) {}
+      std::vector<std::unique_ptr<Assertion>> assertions, std::vector<Symbol> ordered_defs,
+      std::vector<Expr*> definitions, std::shared_ptr<SymbolTable> symbols)
+      : defns(std::move(defns)), exprs(std::move(exprs)), assertions(std::move(assertions)),
+        definitions(std::move(definitions)), ordered_defs(std::move(ordered_defs)),
+        symbols(std::move(symbols)) {}
+  // An empty program, to be extended with append.
+  explicit Ski(std::shared_ptr<SymbolTable> symbols) : symbols(std::move(symbols)) {}
   const std::vector<std::unique_ptr<Defn>>& get_defns() const { return defns; }
   const std::vector<std::unique_ptr<Expr>>& get_exprs() const { return exprs; }
-  const std::vector<std::string>& get_ordered_defs() const { return ordered_defs; }
-  const std::unordered_map<std::string, Expr*>& get_def_map() const { return def_map; }
+  const std::vector<std::unique_ptr<Assertion>>& get_assertions() const { return assertions; }
+  const std::vector<Symbol>& get_ordered_defs() const { return ordered_defs; }
+  // The body of the last definition of symbol, or null if it is not defined.
+  const Expr* get_definition(Symbol symbol) const {
+    return symbol < definitions.size() ? definitions[symbol] : nullptr;
+  }
+  const Expr* get_definition(std::string_view identifier) const {
+    std::optional<Symbol> symbol = symbols->find(identifier);
+    return symbol ? get_definition(*symbol) : nullptr;
+  }
+  const std::shared_ptr<SymbolTable>& get_symbols() const { return symbols; }
+  // Adds the definitions and expressions of addition after the ones of this program, as if they
+  // followed it in the source. addition must be parsed with the same symbol table.
+  void append(Ski&& addition) {
+    if (addition.symbols != symbols)
+      throw std::runtime_error("Cannot append a program parsed with other symbols!");
+    for (auto& defn : addition.defns) {
+      if (defn->get_symbol() >= definitions.size())
+        definitions.resize(symbols->size(), nullptr);
+      definitions[defn->get_symbol()] = defn->get_expr();
+      ordered_defs.push_back(defn->get_symbol());
+      defns.push_back(std::move(defn));
+    }
+    for (auto& expr : addition.exprs)
+      exprs.push_back(std::move(expr));
+    for (auto& assertion : addition.assertions)
+      assertions.push_back(std::move(assertion));
+    addition.defns.clear();
+    addition.exprs.clear();
+    addition.assertions.clear();
+    addition.definitions.clear();
+    addition.ordered_defs.clear();
+  }
   operator std::string() const {
     std::string result;
-    for (const auto& defn : defns)
-      result += static_cast<std::string>(*defn) + ";\n";
+    for (const auto& defn : defns) {
+      result += "def " + defn->get_identifier() + " = ";
+      print_expr(*defn->get_expr(), result);
+      result += ";\n";
+    }
     result += "\n";
-    for (const auto& expr : exprs)
-      result += static_cast<std::string>(*expr) + ";\n";
+    for (const auto& expr : exprs) {
+      print_expr(*expr, result);
+      result += ";\n";
+    }
+    for (const auto& assertion : assertions)
+      result += static_cast<std::string>(*assertion) + ";\n";
     return result;
   }
 
 private:
   std::vector<std::unique_ptr<Defn>> defns;
   std::vector<std::unique_ptr<Expr>> exprs;
-  std::unordered_map<std::string, Expr*> def_map;
-  std::vector<std::string> ordered_defs;
+  std::vector<std::unique_ptr<Assertion>> assertions;
+  std::vector<Expr*> definitions;
+  std::vector<Symbol> ordered_defs;
+  std::shared_ptr<SymbolTable> symbols;
 };
 
 } // namespace Ski
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "evaluation_budget.h"
+#include "interpreter_stats.h"
+#include "term_store.h"
+
+namespace Ski {
+
+// Instructions of the bytecode. Each opcode is one word of the code, followed by its operand if it
+// has one.
+enum class Opcode : uint32_t {
+  // Instantiation, which builds the graph of a term on the stack.
+  kPushLeaf,   // term: pushes a combinator or variable
+  kPushGlobal, // global: pushes the global's cell, which is instantiated when first unwound
+  kStore,      // local: keeps the top of the stack in a local, without popping it
+  kLoad,       // local: pushes the cell kept in a local
+  kMkap,       // pops a right and then a left child, and pushes their application
+  kReturn,     // ends the code of an expression, whose graph is on top of the stack
+  kSetGlobal,  // ends the code of a global: pops its graph, which the global's cell then refers to
+  // Reduction, with the head combinator on top of the stack and the spine below it.
+  kPushArg,   // n: pushes the nth argument, the right child of the nth cell of the spine
+  kUpdate,    // n: pops the result, makes the redex root (the nth cell) refer to it, and pops the
+              // spine down to the root
+  kUpdateApp, // n: pops a right and then a left child, and overwrites the redex root with their
+              // application, popping the spine down to it
+  kUnwind,    // follows the spine down from the top of the stack and runs its head's code
+};
+
+// Definitions and expressions compiled to bytecode in the style of a G-machine. Every term compiles
+// to a linear sequence of pushes and applications that instantiates its graph, sharing the
+// subterms it uses more than once through locals. Terms added as globals, the definitions, are
+// pushed as cells of their own instead, which are instantiated by their own code when reduction
+// first reaches them. Each combinator has code that builds its right-hand side from the arguments
+// on the spine and overwrites the redex with it, so a reduction step runs as a few instructions.
+class BytecodeProgram {
+public:
+  explicit BytecodeProgram(const TermStore& term_store);
+  // Subterms equal to term compiled from now on are pushed as the same global.
+  void add_global(Term term);
+  // Compiles the code that instantiates term, unless it was compiled before, and returns its
+  // address. Globals it uses are compiled along with it.
+  uint32_t compile(Term term);
+  // The instructions at address up to the end of the code they belong to, one per line.
+  std::string disassemble(uint32_t address) const;
+
+  const TermStore& get_term_store() const { return term_store; }
+  const uint32_t* get_code() const { return code.data(); }
+  uint32_t get_combinator_address(TermKind kind) const {
+    return combinator_addresses[static_cast<size_t>(kind)];
+  }
+  size_t get_global_count() const { return globals.size(); }
+  Term get_global_term(uint32_t global) const { return globals[global].term; }
+  uint32_t get_global_address(uint32_t global) const { return globals[global].address; }
+  // Locals the code of any term needs.
+  uint32_t get_max_locals() const { return max_locals; }
+  // Address of an unwind instruction, where reduction to weak head normal form starts.
+  static constexpr uint32_t kUnwindAddress = 0;
+
+private:
+  static constexpr uint32_t kNoAddress = ~0u;
+  static constexpr uint32_t kQueued = ~0u - 1;
+
+  struct Global {
+    Term term;
+    uint32_t address;
+  };
+
+  void emit(Opcode opcode) { code.push_back(static_cast<uint32_t>(opcode)); }
+  void emit(Opcode opcode, uint32_t operand) {
+    code.push_back(static_cast<uint32_t>(opcode));
+    code.push_back(operand);
+  }
+  // Compiles the instantiation of term, ending with end. global is the index of term if it is
+  // compiled as a global, whose own code does not push it.
+  uint32_t compile_block(Term term, Opcode end, uint32_t global);
+
+  const TermStore& term_store;
+  std::vector<uint32_t> code;
+  uint32_t combinator_addresses[8];
+  std::vector<Global> globals;
+  std::unordered_map<Term, uint32_t> global_indexes;
+  // Globals used by compiled code whose own code is still to compile.
+  std::vector<uint32_t> queued;
+  std::unordered_map<Term, uint32_t> compiled;
+  uint32_t max_locals = 0;
+};
+
+// Runs bytecode on an explicit stack over a contiguous heap of 8 byte application cells, addressed
+// as in GraphReducer: leaves are immediates, and every redex root is overwritten with its result,
+// so a shared subterm is reduced at most once. The dispatch loop is a switch over the opcodes.
+// Reduces in normal order, like the graph engine without jets, to the same normal forms.
+class BytecodeVm {
+public:
+  explicit BytecodeVm(const BytecodeProgram& program);
+  // Instantiates the term compiled at address and reduces it to normal form. Stops early once
+  // meter refuses a step, leaving a partially reduced graph, and returns whether the term reached
+  // its normal form.
+  bool evaluate(uint32_t address, BudgetMeter* meter = nullptr);
+  // The term reduced so far, cut off with "..." after max_length characters. Shared cells are
+  // printed once per use.
+  std::string normal_form(size_t max_length = ~size_t{0}, Parens parens = Parens::kAll) const;
+  // The term reduced so far, interned into store, which must be the store the program reads.
+  Term normal_form_term(TermStore& store) const;
+  // Nodes of the term reduced so far: every reachable cell once, every reference to a leaf, and
+  // the nodes of the terms of global cells.
+  size_t count_nodes() const;
+  AllocationStats get_allocation_stats() const {
+    return {cells.size(), cells.size() * sizeof(Cell)};
+  }
+  size_t get_steps() const { return steps; }
+  // Counters of every contraction so far. The peak is the number of cells built, which are never
+  // freed, and the final node count is count_nodes.
+  ReductionStats get_stats() const {
+    ReductionStats stats = rule_stats;
+    stats.steps = steps;
+    stats.peak_nodes = cells.size();
+    return stats;
+  }
+
+private:
+  using Ref = uint32_t;
+  static constexpr Ref kLeaf = 1u << 31;
+  // Values of Cell::right that mark a cell as something other than an application.
+  static constexpr Ref kIndirection = ~0u; // left refers to the result of the reduction
+  static constexpr Ref kGlobal = ~0u - 1;  // left is a global still to instantiate
+  static constexpr Ref kNone = ~0u;
+  static constexpr size_t kFingerprintVisits = 256;
+
+  struct Cell {
+    Ref left;
+    Ref right;
+  };
+
+  static bool is_leaf(Ref ref) { return ref & kLeaf; }
+  static Term leaf_term(Ref ref) { return ref & ~kLeaf; }
+  bool is_app(Ref ref) const { return !is_leaf(ref) && cells[ref].right < kGlobal; }
+  Ref make_cell(Ref left, Ref right) {
+    cells.push_back({left, right});
+    normal.push_back(false);
+    return static_cast<Ref>(cells.size() - 1);
+  }
+  Ref follow(Ref ref) const {
+    while (!is_leaf(ref) && cells[ref].right == kIndirection)
+      ref = cells[ref].left;
+    return ref;
+  }
+  Ref global_cell(uint32_t global);
+  // Runs the code from pc until it returns, reaches a weak head normal form or is refused a step.
+  // Returns false only in the last case.
+  bool run(uint32_t pc);
+  bool whnf(Ref ref);
+  bool normalize(Ref ref);
+  // Charges meter for the next step and checks it for a cycle. Returns whether the step may run.
+  bool charge_step();
+  // Hash of the term the graph at ref stands for, or nullopt if hashing it takes more than
+  // kFingerprintVisits visits. Globals hash as their terms.
+  std::optional<uint64_t> fingerprint(Ref ref);
+
+  const BytecodeProgram& program;
+  const TermStore& term_store;
+  size_t steps = 0;
+  // Per-rule counters, only updated with SKI_ENABLE_STATS.
+  ReductionStats rule_stats;
+  BudgetMeter* meter = nullptr;
+  size_t charged_cells = 0;
+  Ref root = 0;
+  std::vector<Cell> cells;
+  std::vector<bool> normal;
+  std::vector<Ref> global_cells;
+  std::vector<Ref> stack;
+  std::vector<Ref> locals;
+  // Index on the stack of the head of the redex being contracted. The root being reduced to weak
+  // head normal form is at the bottom.
+  size_t frame = 0;
+  // Cycle detection state of the current reduction to weak head normal form, as in GraphReducer.
+  CycleDetector cycles;
+  size_t skipped_steps = 0;
+  size_t skip = 1;
+  // Scratch space of fingerprint.
+  std::unordered_map<uint64_t, uint64_t> fingerprints;
+};
+
+} // namespace Ski
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "term_store.h"
+
+namespace Ski {
+
+// Load-time pass that rewrites the S/K plumbing left by bracket abstraction into Turner's extended
+// combinators, bottom-up:
+//
+//   S (K p) I       => p
+//   S (K p) (B q r) => B* p q r
+//   S (K p) q       => B p q
+//   S (B p q) (K r) => C' p q r
+//   S p (K q)       => C p q
+//   S (B p q) r     => S' p q r
+//
+// The result is extensionally equal to the input: applied to enough arguments both reduce to the
+// same term, but normal forms that still contain unsaturated combinators print differently.
+class CombinatorOptimizer {
+public:
+  CombinatorOptimizer(TermStore& term_store);
+  Term optimize(Term term);
+
+private:
+  Term rewrite(Term left, Term right);
+  bool match_app(Term term, Term function, Term& argument) const;
+  bool match_app2(Term term, Term function, Term& first, Term& second) const;
+
+  TermStore& term_store;
+  std::unordered_map<Term, Term> optimized;
+};
+
+} // namespace Ski
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Ski {
+
+// Lets another thread, or a signal handler, stop evaluations that were given the token. Engines
+// poll it every few hundred steps.
+class CancellationToken {
+public:
+  void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+  void reset() { cancelled.store(false, std::memory_order_relaxed); }
+  bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> cancelled{false};
+};
+
+// Limits on the evaluation of one expression. Zero means no limit.
+struct EvaluationBudget {
+  size_t max_steps = 0;
+  // Nodes of the tree engine's expression, or cells built by the graph and bytecode engines.
+  size_t max_nodes = 0;
+  std::chrono::nanoseconds max_time{0};
+  // Not owned, and must outlive the evaluations using it.
+  const CancellationToken* cancellation = nullptr;
+  // Stop once the engine sees the term it is reducing come back to an earlier state, after
+  // which a deterministic strategy would go round forever. For the graph and bytecode engines and
+  // the leftmost-outermost strategy the term then has no normal form; the other strategies can
+  // also loop on terms that have one.
+  bool detect_cycles = false;
+
+  bool is_limited() const {
+    return max_steps || max_nodes || max_time.count() || cancellation || detect_cycles;
+  }
+};
+
+// How the evaluation of an expression ended. Anything but kNormalForm leaves a partially reduced
+// term.
+enum class EvalStatus : uint8_t {
+  kNormalForm,
+  kStepLimit,
+  kNodeLimit,
+  kTimeLimit,
+  kCancelled,
+  kCycle,
+};
+
+const char* eval_status_name(EvalStatus status);
+
+// A repetition found in the states of a reduction: the state reached after step start came back
+// length steps later.
+struct Cycle {
+  size_t start = 0;
+  size_t length = 0;
+};
+
+// Brent's cycle detection over the fingerprints of a deterministic sequence of states, such as
+// the terms one position of an expression passes through. A single fingerprint is saved, and it
+// is replaced by the state 2, 4, 8, ... visits later. Memory and time per state are therefore
+// constant, and a cycle is found within about twice its start plus its length. The length found
+// is exact.
+// The saved state was already in the cycle but need not be its first state, so the cycle may
+// have been entered before start.
+class CycleDetector {
+public:
+  // Visits the state reached after step. Returns whether it is the saved state again, which
+  // get_cycle then describes.
+  bool visit(uint64_t fingerprint, size_t step);
+  // Forgets every state, for a sequence with a gap in it.
+  void reset() { *this = CycleDetector(); }
+  Cycle get_cycle() const { return cycle; }
+
+private:
+  uint64_t saved = 0;
+  size_t saved_step = 0;
+  bool has_saved = false;
+  size_t power = 1;
+  size_t visits = 0;
+  Cycle cycle;
+};
+
+// Holds one expression's evaluation to a budget. Engines charge it before each contraction and
+// stop, leaving a valid term, once it refuses. Subterm threads may share it.
+class BudgetMeter {
+public:
+  explicit BudgetMeter(const EvaluationBudget& budget);
+
+  // Counts nodes the term has before its first contraction.
+  void add_nodes(ptrdiff_t nodes) { this->nodes.fetch_add(nodes, std::memory_order_relaxed); }
+  // Counts a contraction that changes the term's size by growth nodes. Returns false, and the
+  // contraction must not be made, once a limit is reached.
+  bool charge(ptrdiff_t growth) {
+    if (is_exhausted())
+      return false;
+    size_t step = steps.fetch_add(1, std::memory_order_relaxed) + 1;
+    ptrdiff_t node_count = nodes.fetch_add(growth, std::memory_order_relaxed) + growth;
+    if ((budget.max_steps && step > budget.max_steps) ||
+        (budget.max_nodes && node_count > static_cast<ptrdiff_t>(budget.max_nodes)) ||
+        step % kPollInterval == 1)
+      return check(step, node_count);
+    return true;
+  }
+  bool is_exhausted() const { return get_status() != EvalStatus::kNormalForm; }
+  EvalStatus get_status() const { return status.load(std::memory_order_relaxed); }
+  // Steps charged so far, counting the one refused last.
+  size_t get_steps() const { return steps.load(std::memory_order_relaxed); }
+
+  // Whether engines should feed CycleDetectors and report what they find.
+  bool detects_cycles() const { return budget.detect_cycles; }
+  // Stops the evaluation with kCycle, unless another limit stopped it first.
+  void report_cycle(const Cycle& cycle);
+  // The cycle reported, if the status is kCycle.
+  Cycle get_cycle() const { return cycle; }
+
+private:
+  // Steps between reads of the clock and the cancellation token, starting with the first.
+  static constexpr size_t kPollInterval = 256;
+
+  bool check(size_t step, ptrdiff_t node_count);
+
+  EvaluationBudget budget;
+  std::chrono::steady_clock::time_point deadline;
+  std::atomic<size_t> steps{0};
+  std::atomic<ptrdiff_t> nodes{0};
+  std::atomic<EvalStatus> status{EvalStatus::kNormalForm};
+  // Only written by the thread that set status to kCycle.
+  Cycle cycle;
+};
+
+} // namespace Ski
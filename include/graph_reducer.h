@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "node_pool.h"
+#include "evaluation_budget.h"
+#include "interpreter_stats.h"
+#include "normal_form_cache.h"
+#include "term_store.h"
+
+namespace Ski {
+
+// Resolved terms of the Church numeral definitions that the graph reducer can run natively.
+struct ChurchJets {
+  Term zero; // S K
+  Term inc;  // S (S (K S) K)
+  Term add;  // c2 (c1 c1 (c2 I inc)) I
+};
+
+// Call-by-need graph reducer in the style of Turner's SK machine. Arguments are shared rather than
+// copied, and every redex root is overwritten in place with its result (or an indirection to it),
+// so a shared subterm is reduced at most once.
+//
+// The graph is a flat array of 8 byte application cells addressed by 32 bit references. Leaves are
+// not stored at all: a reference with the kLeaf bit set is an immediate carrying the term store
+// handle of a combinator or variable. Cells are built from the term lazily, as reduction reaches
+// them.
+//
+// With jets, subterms equal to a Church numeral, inc or add are built as native cells instead.
+// Every jet rule is a shortcut for a sequence of ordinary reduction steps, and numbers are expanded
+// back to their combinator form whenever no rule applies, so normal forms are unchanged.
+class GraphReducer {
+public:
+  // Terms found in cache are replaced by their normal forms as they are built.
+  GraphReducer(const TermStore& term_store, const ChurchJets* jets = nullptr,
+               const NormalFormCache* cache = nullptr);
+  std::string reduce(Term term);
+  // reduce in two steps, which lets reducing and printing be timed apart. evaluate stops early
+  // once meter refuses a step, leaving a partially reduced graph, and returns whether the term
+  // reached its normal form. Jets are charged after they fire, so they may overrun a limit by one.
+  bool evaluate(Term term, BudgetMeter* meter = nullptr);
+  // The term reduced so far, cut off with "..." after max_length characters. Shared cells are
+  // printed once per use, so a partial term can print far longer than its cells.
+  std::string normal_form(size_t max_length = ~size_t{0}, Parens parens = Parens::kAll) const {
+    return to_string(root, max_length, parens);
+  }
+  // The term reduced so far, interned into store, which must be the store the reducer reads. The
+  // store is hash-consed, so equal normal forms get the same handle.
+  Term normal_form_term(TermStore& store) const {
+    std::unordered_map<Ref, Term> terms;
+    return to_term(root, store, terms);
+  }
+  // Nodes of the term reduced so far: every reachable cell once, every reference to a leaf, and
+  // the nodes of the terms of unbuilt cells. Jet cells count as one node each.
+  size_t count_nodes() const;
+  // Like reduce, but gives up once more than max_steps contractions were needed. Returns whether
+  // the term reached its normal form.
+  bool try_normalize(Term term, size_t max_steps);
+  AllocationStats get_allocation_stats() const {
+    return {cells.size(), cells.size() * sizeof(Cell)};
+  }
+  // Contractions so far, counting each jet rule as one.
+  size_t get_steps() const { return steps; }
+  // Counters of every contraction so far. The peak is the number of cells built, which are never
+  // freed, and the final node count is count_nodes.
+  ReductionStats get_stats() const {
+    ReductionStats stats = rule_stats;
+    stats.steps = steps;
+    stats.peak_nodes = cells.size();
+    return stats;
+  }
+  size_t get_cache_hits() const { return cache_hits; }
+  size_t get_cache_misses() const { return cache_misses; }
+  // After a finished reduction, records the normal forms of the reduced term and of every term that
+  // was built and reached its normal form as part of the result. The normal forms are interned into
+  // store, which must be the store the reducer reads.
+  void record_normal_forms(TermStore& store, NormalFormCache& cache);
+
+private:
+  using Ref = uint32_t;
+  static constexpr Ref kLeaf = 1u << 31;
+  // Values of Cell::right that mark a cell as something other than an application.
+  static constexpr Ref kIndirection = ~0u; // left refers to the result of the reduction
+  static constexpr Ref kNumber = ~0u - 1;  // left is the value of a Church numeral
+  static constexpr Ref kIncJet = ~0u - 2;
+  static constexpr Ref kAddJet = ~0u - 3;
+  static constexpr Ref kUnbuilt = ~0u - 4; // left is the term the cell stands for
+  static constexpr uint32_t kNotNumeral = ~0u;
+  static constexpr size_t kFingerprintVisits = 256;
+
+  struct Cell {
+    Ref left;
+    Ref right;
+  };
+
+  static bool is_leaf(Ref ref) { return ref & kLeaf; }
+  static Term leaf_term(Ref ref) { return ref & ~kLeaf; }
+  bool is_app(Ref ref) const { return !is_leaf(ref) && cells[ref].right < kUnbuilt; }
+  bool is_number(Ref ref) const { return !is_leaf(ref) && cells[ref].right == kNumber; }
+
+  Ref build(Term term);
+  void expand(Ref ref);
+  uint32_t numeral_value(Term term);
+  Ref make_app(Ref left, Ref right);
+  Ref make_cell(Ref left, Ref right);
+  void set_app(Ref ref, Ref left, Ref right);
+  Ref follow(Ref ref) const;
+  // Follows indirections and expands the cell found if it is unbuilt.
+  Ref resolve(Ref ref);
+  bool whnf(Ref ref);
+  // Hash of the term the graph at ref stands for, or nullopt if hashing it takes more than
+  // kFingerprintVisits visits. Unbuilt and jet cells hash as their terms, so equal terms hash
+  // equally however they are built.
+  std::optional<uint64_t> fingerprint(Ref ref);
+  bool contract_jet(Ref head, Ref& current);
+  bool normalize(Ref ref);
+  Term to_term(Ref ref, TermStore& store, std::unordered_map<Ref, Term>& terms) const;
+  std::string to_string(Ref ref, size_t max_length, Parens parens) const;
+  // Charges meter for the next step and the cells built since the last one.
+  bool charge_step();
+
+  const TermStore& term_store;
+  const ChurchJets* jets;
+  const NormalFormCache* cache;
+  size_t cache_hits = 0;
+  size_t cache_misses = 0;
+  size_t steps = 0;
+  // Per-rule and jet counters, only updated with SKI_ENABLE_STATS.
+  ReductionStats rule_stats;
+  size_t max_steps = ~size_t{0};
+  BudgetMeter* meter = nullptr;
+  size_t charged_cells = 0;
+  Ref root = 0;
+  std::vector<Cell> cells;
+  std::vector<bool> normal;
+  std::unordered_map<Term, Ref> built;
+  std::unordered_map<Term, uint32_t> numeral_values;
+  std::vector<Ref> spine;
+  // Scratch space of fingerprint.
+  std::unordered_map<uint64_t, uint64_t> fingerprints;
+};
+
+} // namespace Ski
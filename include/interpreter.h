@@ -3,26 +3,211 @@
 #include <memory>
 #include <unordered_map>
 
+#include "node_pool.h"
 #include "ast.h"
+#include "bytecode_vm.h"
+#include "combinator_optimizer.h"
+#include "evaluation_budget.h"
+#include "graph_reducer.h"
+#include "interpreter_stats.h"
+#include "normal_form_cache.h"
+#include "program_image.h"
+#include "task_scheduler.h"
+#include "term_store.h"
+#include "thread_pool.h"
 
 namespace Ski {
 
+enum class Engine {
+  kTree,     // rewrites a private copy of the expression tree until it stops changing
+  kGraph,    // call-by-need graph reduction with shared arguments
+  kBytecode, // the same reduction, compiled to bytecode for a G-machine style virtual machine
+};
+
+// The order in which the tree engine contracts redexes. Every strategy that terminates reaches
+// the same normal form; they differ in which terms they terminate on and in the steps they take.
+enum class Strategy {
+  // Contracts every redex of a pass over the tree, children before parents, until a pass finds
+  // none. The outermost redexes fire in every pass, so it terminates whenever a normal form
+  // exists, but it also reduces arguments that are later discarded or copied.
+  kFullPass,
+  // Normal order: one redex at a time, always the leftmost of the outermost ones. Terminates
+  // whenever a normal form exists and never reduces a discarded argument, but reduces an argument
+  // once per copy S makes of it.
+  kLeftmostOutermost,
+  // Applicative order: one redex at a time, always the leftmost of those with no redex inside.
+  // Arguments are normal before they are copied, so each is reduced once, but it diverges
+  // whenever any argument does, even one K discards.
+  kLeftmostInnermost,
+};
+
+struct InterpreterOptions {
+  Engine engine = Engine::kTree;
+  // How the tree engine picks redexes. The graph engine always reduces in normal order, sharing
+  // arguments instead of copying them.
+  Strategy strategy = Strategy::kFullPass;
+  // Rewrite S/K patterns into Turner's extended combinators before reducing. See
+  // CombinatorOptimizer for how this affects printed normal forms.
+  bool optimize = false;
+  // Let the graph engine run Church numerals, inc and add natively. Printed normal forms are the
+  // same with and without jets. Ignored with optimize, which rewrites the terms jets recognize.
+  bool jets = true;
+  // Threads reducing top-level expressions concurrently. Results keep their source order.
+  unsigned jobs = 1;
+  // Threads the tree engine uses to rewrite disjoint subterms of one expression, when both
+  // children of an application have at least subterm_threshold nodes. Ignored with jobs > 1 and
+  // by every strategy but the full pass.
+  unsigned subterm_threads = 1;
+  uint32_t subterm_threshold = 4096;
+  // Parentheses in printed normal forms. Minimal ones are shorter and read the same, but differ
+  // from the output of earlier versions.
+  Parens parens = Parens::kAll;
+  // Limits on reducing each expression, none by default. An expression that reaches one is
+  // printed as far as it got, its status says why, and the next expression starts afresh.
+  EvaluationBudget budget;
+  // Memory cap of the normal form cache, which is off when 0. The cache outlives interpret_exprs,
+  // so later calls reuse the normal forms of earlier ones.
+  size_t cache_bytes = 0;
+  // Reduction steps spent on the normal form of a definition when it is resolved. Definitions
+  // that need more, or have none, are left to the expressions using them.
+  size_t cache_definition_steps = 100000;
+};
+
+// How an assert_eq statement ended.
+struct AssertionResult {
+  // Source line of the statement.
+  int line;
+  // Whether both sides reached the same normal form.
+  bool passed;
+  // kNormalForm if both sides reached their normal forms, or else why one of them did not.
+  EvalStatus status;
+};
+
 class Interpreter {
 public:
-  Interpreter(std::unique_ptr<Ski> ski_ast);
-  std::unordered_map<std::string, std::unique_ptr<Expr>>& get_resolved_definitions_map() {
-    return resolved_definitions_map;
-  }
+  Interpreter(std::unique_ptr<Ski> ski_ast, Engine engine = Engine::kTree);
+  Interpreter(std::unique_ptr<Ski> ski_ast, const InterpreterOptions& options);
+  // Evaluates a compiled program. Its definitions and expressions are already resolved.
+  Interpreter(const ProgramImage& image, const InterpreterOptions& options);
+  // Resolves every definition, expression and assertion and writes them to a program image at
+  // path.
+  void compile(const std::string& path);
+  // Definitions are resolved on first use, so this only holds the ones used so far.
+  std::unordered_map<std::string, Term> get_resolved_definitions_map() const;
+  const TermStore& get_term_store() const { return term_store; }
+  // The symbols additions must be parsed with.
+  const std::shared_ptr<SymbolTable>& get_symbols() const { return term_store.get_symbols(); }
   std::vector<std::string> interpret_exprs();
+  // Like interpret_exprs, but writes each normal form to output on its own line as soon as it and
+  // the ones before it are reduced, instead of collecting them all first.
+  void interpret_exprs(std::ostream& output);
+  // The two halves of interpret_exprs: interns every expression, resolving the definitions it
+  // uses, and then reduces the interned expressions to their printed normal forms.
+  std::vector<Term> resolve_exprs();
+  // Interns both sides of every assertion, resolving the definitions they use. The assertions of
+  // a program image come first.
+  std::vector<ResolvedAssertion> resolve_assertions();
+  // strategies overrides options.strategy for the expressions it covers. With stream, normal
+  // forms are written to it as interpret_exprs(std::ostream&) does, and returned empty.
+  std::vector<std::string> reduce_exprs(const std::vector<Term>& source_exprs,
+                                        const std::vector<Strategy>& strategies = {},
+                                        std::ostream* stream = nullptr);
+  // Adds the definitions and expressions of addition to the program, and returns the normal
+  // forms of its expressions only. Definitions resolved so far are kept, so earlier ones are not
+  // processed again. A redefinition only applies to what follows it: the definitions before it
+  // keep the meaning they had when they were added.
+  std::vector<std::string> extend(std::unique_ptr<Ski> addition);
+  // Nodes and bytes allocated while reducing each expression of the last interpret_exprs or
+  // extend call.
+  const std::vector<AllocationStats>& get_allocation_stats() const { return allocation_stats; }
+  // How the reduction of each expression of the last call ended.
+  const std::vector<EvalStatus>& get_statuses() const { return statuses; }
+  // The cycle found in each expression of the last call whose status is kCycle.
+  const std::vector<Cycle>& get_cycles() const { return cycles; }
+  // The assertions of the last interpret_exprs or extend call, in source order. Both sides are
+  // reduced with options.budget each and compared by structural hash, never printed. They are
+  // compared as plain combinator terms, even with optimize.
+  const std::vector<AssertionResult>& get_assertion_results() const { return assertion_results; }
+  // Counters of each expression of the last call. Only steps is counted without SKI_ENABLE_STATS.
+  const std::vector<ReductionStats>& get_reduction_stats() const { return reduction_stats; }
+  // Counters and phase timers of everything this interpreter did so far, all zero without
+  // SKI_ENABLE_STATS. Tokenizing and parsing happen before the interpreter exists, so callers
+  // add their time with add_phase_time.
+  const InterpreterStats& get_stats() const { return stats; }
+  void add_phase_time(Phase phase, uint64_t ns) {
+    if constexpr (kStatsEnabled)
+      stats.phase_ns[static_cast<size_t>(phase)] += ns;
+  }
+  // Hits and misses so far, all zero without a cache.
+  CacheStats get_cache_stats() const { return cache ? cache->get_stats() : CacheStats{}; }
 
 private:
-  std::unique_ptr<Expr> substitute_identifiers(
-      std::unique_ptr<Expr> expr,
-      std::unordered_map<std::string, std::unique_ptr<Expr>>& resolved_definitions_map);
-  std::unique_ptr<Expr> rewite_expr(std::unique_ptr<Expr> expr);
+  Term substitute_identifiers(const Expr& expr);
+  Term resolve_definition(Symbol symbol);
+  bool is_visible(Symbol symbol, size_t position) const;
+  bool is_resolved(Symbol symbol) const {
+    return symbol < resolved_definitions.size() && resolved_definitions[symbol] != kUnresolved;
+  }
+  void set_resolved(Symbol symbol, Term term);
+  // Interns the assertions of the program source from index first on.
+  std::vector<ResolvedAssertion> resolve_source_assertions(size_t first);
+  void check_assertions(const std::vector<ResolvedAssertion>& assertions);
+  // Reduction only reads the interpreter, so it may run on several threads at once.
+  // Stops early, leaving a partially reduced expression, once meter refuses a step.
+  std::unique_ptr<Expr> reduce_tree(Term term, Strategy strategy, ReductionStats& reductions,
+                                    BudgetMeter* meter) const;
+  void set_up_engine();
+  void resolve_jets();
+  const ChurchJets* active_jets() const;
+  void cache_definition(Term term);
+  Term apply_cache(Term term);
+  // Makes the definitions resolved so far globals of the bytecode, which terms compiled from then
+  // on share instead of instantiating them again.
+  void add_bytecode_globals();
+  // Contracts every redex of one pass over expr, counting them in reductions.
+  std::unique_ptr<Expr> rewite_expr(std::unique_ptr<Expr> expr, ReductionStats& reductions,
+                                    BudgetMeter* meter) const;
+  // Reduce expr to normal form one leftmost-outermost or leftmost-innermost redex at a time.
+  // spine is scratch space shared by the recursive calls.
+  static std::unique_ptr<Expr> normalize_outermost(std::unique_ptr<Expr> expr,
+                                                   std::vector<App*>& spine,
+                                                   ReductionStats& reductions, BudgetMeter* meter);
+  static std::unique_ptr<Expr> normalize_innermost(std::unique_ptr<Expr> expr,
+                                                   ReductionStats& reductions, BudgetMeter* meter);
+  // The normal form of an application whose children are normal already.
+  static std::unique_ptr<Expr> contract_innermost(std::unique_ptr<Expr> expr,
+                                                  ReductionStats& reductions, BudgetMeter* meter);
+
+  static constexpr size_t kUndefined = ~size_t{0};
+  static constexpr Term kUnresolved = ~0u;
 
+  // Null for a compiled program, whose expressions and assertions are compiled_exprs and
+  // compiled_assertions instead, until it is extended.
   std::unique_ptr<Ski> ski_ast;
-  std::unordered_map<std::string, std::unique_ptr<Expr>> resolved_definitions_map;
+  std::vector<Term> compiled_exprs;
+  std::vector<ResolvedAssertion> compiled_assertions;
+  InterpreterOptions options;
+  TermStore term_store;
+  CombinatorOptimizer optimizer;
+  // Source position of every definition, indexed by symbol. A definition only sees the ones
+  // before it.
+  std::vector<size_t> definition_positions;
+  // Positions handed out so far. The definitions of a program image come first.
+  size_t definition_count = 0;
+  // Resolved definitions indexed by symbol, kUnresolved for the others.
+  std::vector<Term> resolved_definitions;
+  ChurchJets jets{};
+  std::vector<AllocationStats> allocation_stats;
+  std::vector<ReductionStats> reduction_stats;
+  std::vector<EvalStatus> statuses;
+  std::vector<Cycle> cycles;
+  std::vector<AssertionResult> assertion_results;
+  InterpreterStats stats;
+  std::unique_ptr<ThreadPool> pool;
+  std::unique_ptr<TaskScheduler> scheduler;
+  std::unique_ptr<NormalFormCache> cache;
+  // Only set for the bytecode engine.
+  std::unique_ptr<BytecodeProgram> bytecode;
 };
 
 } // namespace Ski
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Ski {
+
+// The counters and timers below are only updated in builds with SKI_ENABLE_STATS, which the
+// SKI_ENABLE_STATS CMake option defines. Without it every update is discarded at compile time.
+#ifdef SKI_ENABLE_STATS
+inline constexpr bool kStatsEnabled = true;
+#else
+inline constexpr bool kStatsEnabled = false;
+#endif
+
+// S, K, I, B, C, S', B* and C', in TermKind order.
+inline constexpr size_t kRuleCount = 8;
+
+enum class Phase { kTokenize, kParse, kResolve, kReduce, kPrint };
+inline constexpr size_t kPhaseCount = 5;
+
+struct ReductionStats {
+  // Contractions of any kind. Counted in every build, since the engines need it anyway.
+  size_t steps = 0;
+  // Contractions per combinator rule, indexed by TermKind.
+  std::array<size_t, kRuleCount> rule_steps{};
+  // Contractions the graph engine's jets made natively.
+  size_t jet_steps = 0;
+  // Passes the tree engine made over the expression, including the last one that found no redex.
+  size_t passes = 0;
+  // Largest size the expression reached, in tree nodes or graph cells.
+  size_t peak_nodes = 0;
+  // Nodes of the normal form.
+  size_t final_nodes = 0;
+
+  // Sums two sets of counters, keeping the larger peak.
+  void add(const ReductionStats& other) {
+    steps += other.steps;
+    for (size_t rule = 0; rule < kRuleCount; rule++)
+      rule_steps[rule] += other.rule_steps[rule];
+    jet_steps += other.jet_steps;
+    passes += other.passes;
+    peak_nodes = std::max(peak_nodes, other.peak_nodes);
+    final_nodes += other.final_nodes;
+  }
+};
+
+struct InterpreterStats {
+  // Summed over every expression reduced.
+  ReductionStats reductions;
+  size_t exprs = 0;
+  // Normal forms by size: bucket i counts the ones with 2^i to 2^(i+1) - 1 nodes.
+  std::array<size_t, 32> normal_form_sizes{};
+  // Nanoseconds per Phase. Reducing and printing are summed over the expressions, so with several
+  // jobs they can exceed the wall time.
+  std::array<uint64_t, kPhaseCount> phase_ns{};
+
+  void add_normal_form(size_t nodes) {
+    size_t bucket = 0;
+    while (bucket + 1 < normal_form_sizes.size() && nodes >> (bucket + 1))
+      bucket++;
+    normal_form_sizes[bucket]++;
+  }
+};
+
+// One line per kind of counter, for people.
+std::string format_stats(const InterpreterStats& stats);
+// The same counters as a JSON object, for scripts.
+std::string format_stats_json(const InterpreterStats& stats);
+
+// Adds the nanoseconds between its construction and destruction to a counter. Does nothing, not
+// even reading the clock, without SKI_ENABLE_STATS.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(uint64_t& ns) : ns(ns) {
+    if constexpr (kStatsEnabled)
+      start = std::chrono::steady_clock::now();
+  }
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+  ~PhaseTimer() {
+    if constexpr (kStatsEnabled) {
+      ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+    }
+  }
+
+private:
+  uint64_t& ns;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace Ski
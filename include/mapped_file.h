@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Ski {
+
+// A whole file mapped read-only into memory. Throws std::runtime_error if the file cannot be
+// opened or mapped. An empty file maps to an empty view.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return static_cast<const char*>(mapping); }
+  size_t size() const { return length; }
+  std::string_view view() const { return {data(), length}; }
+
+private:
+  void* mapping = nullptr;
+  size_t length = 0;
+};
+
+} // namespace Ski
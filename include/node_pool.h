@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Ski {
+
+struct AllocationStats {
+  size_t nodes = 0;
+  size_t bytes = 0;
+};
+
+// Size-class free lists for AST nodes. Each thread keeps its own lists, so allocation and
+// deallocation never lock; memory freed by one thread is reused by whichever thread frees it.
+class NodePool {
+public:
+  static void* allocate(size_t size);
+  static void deallocate(void* pointer, size_t size);
+  // Cumulative allocations made by the calling thread.
+  static AllocationStats get_stats();
+};
+
+} // namespace Ski
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+
+#include "term_store.h"
+
+namespace Ski {
+
+struct CacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+};
+
+// Normal forms of terms that reduction has already computed, keyed by the hash-consed handle of the
+// term. A term and its normal form are interchangeable anywhere, so a hit lets the reducers skip
+// straight to the result. Normal forms live in the term store, which never frees nodes, so the
+// memory cap covers the entries and the store nodes added for them, and once it is reached new
+// normal forms are dropped instead of evicting old ones.
+class NormalFormCache {
+public:
+  explicit NormalFormCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+  std::optional<Term> find(Term term) const {
+    auto it = normal_forms.find(term);
+    if (it == normal_forms.end())
+      return std::nullopt;
+    return it->second;
+  }
+  bool is_full() const { return stats.bytes >= max_bytes; }
+  // Records the normal form of term. Returns false if the cache is full.
+  bool insert(Term term, Term normal_form);
+  // Charges the term store nodes that were added to hold normal forms against the cap.
+  void count_terms(size_t new_terms) { stats.bytes += new_terms * kTermBytes; }
+  void count(size_t hits, size_t misses) {
+    stats.hits += hits;
+    stats.misses += misses;
+  }
+  const CacheStats& get_stats() const { return stats; }
+
+private:
+  // Approximate footprint of an entry and of a term store node with its index entry.
+  static constexpr size_t kEntryBytes = 32;
+  static constexpr size_t kTermBytes = 40;
+
+  size_t max_bytes;
+  std::unordered_map<Term, Term> normal_forms;
+  CacheStats stats;
+};
+
+} // namespace Ski
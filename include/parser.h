@@ -3,36 +3,66 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 #include "token.h"
+#include "tokenizer.h"
 #include "ast.h"
 
 namespace Ski {
 
 class Parser {
 public:
-  Parser(std::unique_ptr<std::vector<Token>> tokens, std::string ski_filename);
+  // end is the kEnd token the tokenizer returned after tokens, so that errors at the end of the
+  // input are reported where a pulling parser reports them. Without it they are reported at the
+  // last token.
+  Parser(std::unique_ptr<std::vector<Token>> tokens, std::string ski_filename,
+         std::optional<Token> end = std::nullopt);
+  // Pulls tokens from tokenizer as it goes instead of reading a materialized token vector.
+  Parser(Tokenizer& tokenizer, std::string ski_filename);
   std::unique_ptr<Ski> parse();
+  // Parses only the next definition or expression, so that a session can evaluate statements as
+  // they arrive and in any order. The result can be appended to a program parsed with the same
+  // symbols. Null at the end of the tokens, or after printing the error if they are invalid.
+  std::unique_ptr<Ski> parse_statement();
 
 private:
   void parse_dfns(std::vector<std::unique_ptr<Defn>>& defns);
+  void add_dfn(std::unique_ptr<Defn> dfn, std::vector<std::unique_ptr<Defn>>& defns);
+  std::unique_ptr<Ski> make_ski(std::vector<std::unique_ptr<Defn>> defns,
+                                std::vector<std::unique_ptr<Expr>> exprs,
+                                std::vector<std::unique_ptr<Assertion>> assertions);
   std::unique_ptr<Defn> parse_dfn();
-  void parse_exprs(std::vector<std::unique_ptr<Expr>>& exprs);
+  // Expressions and assertions, which may be interleaved.
+  void parse_exprs(std::vector<std::unique_ptr<Expr>>& exprs,
+                   std::vector<std::unique_ptr<Assertion>>& assertions);
+  std::unique_ptr<Assertion> parse_assertion();
   std::unique_ptr<Expr> parse_expr();
   std::unique_ptr<Expr> parse_subexpr();
 
   std::unique_ptr<Expr> read_and_create_ast_node(Kind kind);
+  void advance();
   inline Kind current_token_kind();
   inline void read_and_ignore_token(Kind kind);
   inline bool has_tokens();
   inline bool is_subexpr_start();
 
+  Symbol intern_current_identifier() const;
+
+  // Tokens come from tokenizer when it is set, and from tokens otherwise.
+  Tokenizer* tokenizer = nullptr;
   std::unique_ptr<std::vector<Token>> tokens;
+  std::optional<Token> end;
   std::string ski_filename;
-  int token_index;
-  std::vector<std::string> ordered_defs;
-  std::unordered_map<std::string, Expr*> def_map;
+  size_t token_index;
+  bool started = false;
+  Token current_token{Kind::kEnd, {}, 1, 0};
+  // The tokenizer's table when pulling, since its tokens are interned already.
+  std::shared_ptr<SymbolTable> symbols;
+  std::vector<Symbol> ordered_defs;
+  // Definition bodies indexed by symbol.
+  std::vector<Expr*> definitions;
 
   static std::unordered_map<Kind, std::string> kind_to_name;
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "term_store.h"
+
+namespace Ski {
+
+// Both sides of an assert_eq statement, interned.
+struct ResolvedAssertion {
+  int line;
+  Term left;
+  Term right;
+};
+
+// A compiled program: the term store with every definition, expression and assertion of a program
+// already resolved, so it can be evaluated without tokenizing, parsing or resolving it again.
+//
+// The file is a header followed by the term store nodes in store order, the expression roots, the
+// definitions, the assertions and the identifiers, all 32-bit words in host byte order. Images are
+// only read on the kind of machine that wrote them, and a version or size mismatch is rejected.
+struct ProgramImageHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t expr_count;
+  uint32_t definition_count;
+  uint32_t assertion_count;
+  // Bytes of NUL-terminated identifiers, padded to a multiple of 4.
+  uint32_t identifier_bytes;
+};
+
+struct ProgramImageNode {
+  uint32_t kind;
+  // App: child handles. Var: offset of the identifier.
+  uint32_t left;
+  uint32_t right;
+};
+
+struct ProgramImageDefinition {
+  uint32_t identifier;
+  uint32_t term;
+};
+
+struct ProgramImageAssertion {
+  // Source line of the statement.
+  uint32_t line;
+  uint32_t left;
+  uint32_t right;
+};
+
+// Writes the image of the resolved expressions, definitions and assertions in term_store to path.
+// Throws std::runtime_error if the file cannot be written.
+void write_program_image(const std::string& path, const TermStore& term_store,
+                         const std::vector<Term>& exprs,
+                         const std::vector<std::pair<std::string, Term>>& definitions,
+                         const std::vector<ResolvedAssertion>& assertions = {});
+
+// A program image mapped into memory. Throws std::runtime_error if the file cannot be mapped or is
+// not a valid image.
+class ProgramImage {
+public:
+  explicit ProgramImage(const std::string& path);
+
+  // Whether path starts like a program image rather than program source.
+  static bool is_image(const std::string& path);
+
+  // Adds the image's terms to term_store, which must not hold anything but the combinators yet, so
+  // that the handles in the image stay valid.
+  void load(TermStore& term_store) const;
+  std::vector<Term> get_exprs() const;
+  std::vector<std::pair<std::string, Term>> get_definitions() const;
+  std::vector<ResolvedAssertion> get_assertions() const;
+
+private:
+  void validate() const;
+  const ProgramImageHeader& header() const {
+    return *reinterpret_cast<const ProgramImageHeader*>(file.data());
+  }
+  const ProgramImageNode* nodes() const;
+  const uint32_t* exprs() const;
+  const ProgramImageDefinition* definitions() const;
+  const ProgramImageAssertion* assertions() const;
+  const char* identifiers() const;
+
+  std::string path;
+  MappedFile file;
+};
+
+} // namespace Ski
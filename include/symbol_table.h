@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Ski {
+
+// Dense ID of an identifier, numbered from 0 in the order identifiers are first seen.
+using Symbol = uint32_t;
+
+// Interns the identifiers of a program. The tokenizer, the parser, the term store and the
+// interpreter of a program share one table, so they compare and index identifiers by Symbol
+// instead of hashing strings. Names never move once interned, so references to them stay valid.
+class SymbolTable {
+public:
+  Symbol intern(std::string_view identifier);
+  std::optional<Symbol> find(std::string_view identifier) const;
+  const std::string& name(Symbol symbol) const { return names[symbol]; }
+  size_t size() const { return names.size(); }
+
+private:
+  std::deque<std::string> names;
+  // Keys are views into names.
+  std::unordered_map<std::string_view, Symbol> symbols;
+};
+
+} // namespace Ski
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "node_pool.h"
+
+namespace Ski {
+
+// Work-stealing fork-join scheduler. Every worker owns a deque of forked tasks that it pushes and
+// pops at the back, while idle workers steal from the front of the other deques, where the oldest
+// and usually largest pieces of work are. A worker waiting to join a stolen task steals in turn.
+class TaskScheduler {
+public:
+  explicit TaskScheduler(unsigned threads);
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+  ~TaskScheduler();
+
+  unsigned size() const { return workers.size(); }
+  // Runs root on the calling thread, which acts as a worker until root returns. Concurrent calls
+  // are serialized.
+  void run(const std::function<void()>& root);
+  // Runs first and second, possibly in parallel, and returns once both have finished. Only forks
+  // when called from inside run; otherwise both run inline. The first exception thrown by either
+  // is rethrown here.
+  void fork_join(const std::function<void()>& first, const std::function<void()>& second);
+  // Nodes allocated by the helper threads since the last call. The thread calling run tracks its
+  // own allocations.
+  AllocationStats take_worker_allocation_stats();
+
+private:
+  struct Task {
+    const std::function<void()>* body;
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task*> tasks;
+  };
+
+  void work(unsigned index);
+  Task* steal(unsigned thief);
+  static void execute(Task* task);
+
+  // Worker 0 is the thread inside run.
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::mutex run_mutex;
+  std::atomic<size_t> queued{0};
+  std::atomic<unsigned> sleeping{0};
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::mutex stats_mutex;
+  AllocationStats worker_stats;
+};
+
+} // namespace Ski
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast.h"
+#include "symbol_table.h"
+
+namespace Ski {
+
+enum class TermKind : uint8_t { kS, kK, kI, kB, kC, kSPrime, kBStar, kCPrime, kVar, kApp };
+
+// Number of arguments a combinator needs before it can be contracted, or 0 for Var and App.
+inline int combinator_arity(TermKind kind) {
+  switch (kind) {
+  case TermKind::kI:
+    return 1;
+  case TermKind::kK:
+    return 2;
+  case TermKind::kS:
+  case TermKind::kB:
+  case TermKind::kC:
+    return 3;
+  case TermKind::kSPrime:
+  case TermKind::kBStar:
+  case TermKind::kCPrime:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+// Handle to a canonical node of a TermStore. Handles stay valid for the lifetime of the store, and
+// two handles of the same store are equal iff the terms they denote are structurally equal.
+using Term = uint32_t;
+
+// Hash-consed store of immutable terms. Every distinct (combinator|Var|App(l,r)) shape exists only
+// once, so identical subterms anywhere in a program are shared instead of copied. Variables are
+// named by their symbols in a table the store can share with the parser of the program.
+class TermStore {
+public:
+  // The combinators have fixed handles in every store.
+  static constexpr Term kSTerm = 0;
+  static constexpr Term kKTerm = 1;
+  static constexpr Term kITerm = 2;
+  static constexpr Term kBTerm = 3;
+  static constexpr Term kCTerm = 4;
+  static constexpr Term kSPrimeTerm = 5;
+  static constexpr Term kBStarTerm = 6;
+  static constexpr Term kCPrimeTerm = 7;
+
+  TermStore();
+  explicit TermStore(std::shared_ptr<SymbolTable> symbols);
+  Term s() const { return kSTerm; }
+  Term k() const { return kKTerm; }
+  Term i() const { return kITerm; }
+  Term b() const { return kBTerm; }
+  Term c() const { return kCTerm; }
+  Term s_prime() const { return kSPrimeTerm; }
+  Term b_star() const { return kBStarTerm; }
+  Term c_prime() const { return kCPrimeTerm; }
+  Term var(Symbol symbol);
+  Term var(std::string_view identifier) { return var(symbols->intern(identifier)); }
+  Term app(Term left, Term right);
+
+  TermKind kind(Term term) const { return nodes[term].kind; }
+  Term left(Term term) const { return nodes[term].left; }
+  Term right(Term term) const { return nodes[term].right; }
+  Symbol symbol(Term term) const { return nodes[term].left; }
+  const std::string& identifier(Term term) const { return symbols->name(nodes[term].left); }
+  const std::shared_ptr<SymbolTable>& get_symbols() const { return symbols; }
+  size_t size() const { return nodes.size(); }
+  // Makes room for terms in total without reallocating as they are added.
+  void reserve(size_t terms);
+  // Adds an application known not to be in the store yet, such as one loaded from a program
+  // image. It is only indexed once app is next called, so loading does not pay for the index.
+  Term append_app(Term left, Term right);
+
+  // Variables bound in substitutions are replaced by their terms.
+  Term intern(const Expr& expr,
+              const std::unordered_map<std::string, Term>* substitutions = nullptr);
+  // Variables for which lookup returns a term are replaced by it. Lookup gets the symbol of the
+  // variable in this store's table, which is the parser's symbol if the table is shared.
+  Term intern(const Expr& expr, const std::function<std::optional<Term>(Symbol)>& lookup);
+  std::unique_ptr<Expr> to_expr(Term term) const;
+  std::string to_string(Term term, Parens parens = Parens::kAll) const;
+  // Nodes of term, counting every application not yet in counted once and every reference to a
+  // leaf. The applications are added to counted, so terms sharing them can be counted in turn.
+  size_t count_nodes(Term term, std::unordered_set<Term>& counted) const;
+
+private:
+  struct Node {
+    TermKind kind;
+    // App: child handles. Var: symbol.
+    Term left;
+    Term right;
+  };
+
+  size_t app_slot(Term left, Term right) const;
+  void index_app(Term term);
+
+  static constexpr Term kEmptySlot = ~0u;
+
+  std::vector<Node> nodes;
+  std::shared_ptr<SymbolTable> symbols;
+  // Var terms indexed by symbol, or kEmptySlot for symbols without one yet.
+  std::vector<Term> var_terms;
+  // Open-addressing index of the applications by their children, holding handles into nodes.
+  std::vector<Term> app_slots;
+  size_t app_slot_bits = 0;
+  size_t app_count = 0;
+  // Terms before this one are in the indexes.
+  size_t indexed_terms = 0;
+};
+
+} // namespace Ski
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ski {
+
+// Fixed set of worker threads that run the iterations of a loop concurrently. Iterations are handed
+// out one at a time, so a few slow iterations do not hold back the rest of the loop.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned threads);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  unsigned size() const { return workers.size() + 1; }
+  // Calls body(i) for every i in [0, count) and returns once all calls have finished. The calling
+  // thread takes part in the loop. The first exception thrown by body is rethrown here.
+  void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+private:
+  void work();
+  void run_iterations();
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  // The current loop. generation changes whenever a new loop starts.
+  const std::function<void(size_t)>* body = nullptr;
+  size_t count = 0;
+  size_t next = 0;
+  size_t finished = 0;
+  size_t generation = 0;
+  unsigned busy = 0;
+  std::exception_ptr error;
+  bool stopping = false;
+};
+
+} // namespace Ski
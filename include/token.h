@@ -1,6 +1,8 @@
 #pragma once
 
-#include <string>
+#include <string_view>
+
+#include "symbol_table.h"
 
 namespace Ski {
 
@@ -9,20 +11,28 @@ enum class Kind {
   kSCombinator,      // K
   kKCombinator,      // S
   kICombinator,      // I
+  kBCombinator,      // B
+  kCCombinator,      // C
+  kSPrimeCombinator, // S'
+  kBStarCombinator,  // B*
+  kCPrimeCombinator, // C'
   kOpenParanthesis,  // (
   kCloseParanthesis, // )
   kDef,              // Def
+  kAssertEq,         // assert_eq
   kSemiColon,        // ;
   kEqual,            // =
-  kLineComment,
-  kIngored
+  kEnd,              // end of input
 };
 
 struct Token {
   Kind kind;
-  std::string lexeme;
+  // A view into the tokenized source.
+  std::string_view lexeme;
   int line;
   int column;
+  // The interned lexeme of a kIdentifier.
+  Symbol symbol = 0;
 };
 
 } // namespace Ski
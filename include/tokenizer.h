@@ -1,30 +1,43 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <memory>
 #include <vector>
 
 #include "token.h"
 
 namespace Ski {
 
+// A pull lexer over a program held in memory, such as a mapped file. Whitespace and comments are
+// skipped without producing tokens, and lexemes are views into the source, so tokenizing needs no
+// memory beyond the source itself. The source must outlive the tokenizer and its tokens.
+// Identifiers are interned into symbols as they are read, into a new table unless one is given.
 class Tokenizer {
 
 public:
-  Tokenizer(std::string ski_string, std::string ski_filename);
+  Tokenizer(std::string_view ski_source, std::string ski_filename,
+            std::shared_ptr<SymbolTable> symbols = nullptr);
+  // The next token, or a kEnd token once the source is exhausted. Throws std::runtime_error on a
+  // character that cannot start a token.
+  Token next();
+  // Every remaining token, or null after printing the error if the source is invalid.
   [[nodiscard]]
   std::unique_ptr<std::vector<Token>> tokenize();
+  const std::shared_ptr<SymbolTable>& get_symbols() const { return symbols; }
 
 private:
-  Token find_next_token();
   Token find_identifier();
-  Token find_line_comment();
-  char get_current_char();
+  char get_current_char() const;
+  // Unlike substr, does not check the bounds, which the callers already have.
+  std::string_view lexeme(size_t start, size_t length) const {
+    return {ski_source.data() + start, length};
+  }
 
-  std::unique_ptr<std::vector<Token>> tokens;
-  std::string ski_string;
+  std::string_view ski_source;
   std::string ski_filename;
-  std::string lexeme;
-  int position;
+  std::shared_ptr<SymbolTable> symbols;
+  size_t position;
   int line;
   int column;
 };
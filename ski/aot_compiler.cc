@@ -0,0 +1,463 @@
+#include <map>
+
+#include "aot_compiler.h"
+
+namespace Ski {
+
+AotCompiler::AotCompiler(const TermStore& term_store, const AotOptions& options)
+    : term_store(term_store), options(options) {}
+
+void AotCompiler::add_program(Interpreter& interpreter) {
+  for (Term term : interpreter.resolve_exprs())
+    add_expr(term);
+  for (const ResolvedAssertion& assertion : interpreter.resolve_assertions())
+    add_assertion(assertion);
+  // Only the definitions used are resolved. They are compiled in name order, so compiling the same
+  // program gives the same source.
+  std::unordered_map<std::string, Term> resolved = interpreter.get_resolved_definitions_map();
+  std::map<std::string, Term> definitions(resolved.begin(), resolved.end());
+  for (auto& [name, term] : definitions)
+    add_definition(name, term);
+}
+
+bool AotCompiler::add_definition(const std::string& name, Term term) {
+  // Leaves have no cell of their own at runtime to call a function from.
+  if (term_store.kind(term) != TermKind::kApp || compiled.count(term))
+    return false;
+  // Graph reduction of the term applied to parameters, one more whenever the head combinator
+  // lacks an argument, as the graph reducer does it: redex roots are overwritten with their
+  // results, so shared nodes are reduced once. Nodes of the same store term are shared too.
+  // Indirections stand for the results of I and K.
+  //
+  // A node that started out as a store term still stands for that term once it is unfolded or
+  // reduced, since neither changes what a term means. The body builds it as the term, which the
+  // runtime shares between every call, so reducing it is not repeated per call.
+  struct Node {
+    enum class Kind : uint8_t { kParam, kTerm, kApp, kIndirection } kind;
+    uint32_t left;
+    uint32_t right;
+  };
+  static constexpr Term kNoTerm = ~0u;
+  std::vector<Node> nodes;
+  std::vector<Term> origins;
+  std::unordered_map<Term, uint32_t> term_nodes;
+  auto make = [&](Node::Kind kind, uint32_t left, uint32_t right = 0) {
+    nodes.push_back({kind, left, right});
+    origins.push_back(kind == Node::Kind::kTerm ? left : kNoTerm);
+    return static_cast<uint32_t>(nodes.size() - 1);
+  };
+  auto app = [&](uint32_t left, uint32_t right) { return make(Node::Kind::kApp, left, right); };
+  auto term_node = [&](Term subterm) {
+    auto it = term_nodes.find(subterm);
+    if (it != term_nodes.end())
+      return it->second;
+    uint32_t node = make(Node::Kind::kTerm, subterm);
+    term_nodes.emplace(subterm, node);
+    return node;
+  };
+  auto follow = [&](uint32_t node) {
+    while (nodes[node].kind == Node::Kind::kIndirection)
+      node = nodes[node].left;
+    return node;
+  };
+  // Whether node is a parameter, a store term, or a combinator or variable applied to such values
+  // that has no redex at its root: building it again repeats no reduction.
+  auto is_value = [&](uint32_t node) {
+    std::vector<uint32_t> pending{node};
+    while (!pending.empty()) {
+      uint32_t current = follow(pending.back());
+      pending.pop_back();
+      size_t args = 0;
+      while (origins[current] == kNoTerm && nodes[current].kind == Node::Kind::kApp) {
+        pending.push_back(nodes[current].right);
+        current = follow(nodes[current].left);
+        args++;
+      }
+      if (args == 0)
+        continue;
+      if (origins[current] == kNoTerm)
+        return false;
+      Term head = origins[current];
+      for (; term_store.kind(head) == TermKind::kApp; head = term_store.left(head))
+        args++;
+      TermKind kind = term_store.kind(head);
+      if (kind != TermKind::kVar && args >= static_cast<size_t>(combinator_arity(kind)))
+        return false;
+    }
+    return true;
+  };
+  uint32_t root = term_node(term);
+  uint32_t arity = 0;
+  size_t steps = 0;
+  // The root and arity after the last step. Parameters added after it are dropped again.
+  uint32_t stepped_root = root;
+  uint32_t stepped_arity = 0;
+  // The applications from the root down to the head.
+  std::vector<uint32_t> spine;
+  uint32_t current = root;
+  while (true) {
+    current = follow(current);
+    Node node = nodes[current];
+    if (node.kind == Node::Kind::kApp) {
+      spine.push_back(current);
+      current = node.left;
+      continue;
+    }
+    if (node.kind == Node::Kind::kParam)
+      break;
+    TermKind kind = term_store.kind(node.left);
+    if (kind == TermKind::kApp) {
+      uint32_t left = term_node(term_store.left(node.left));
+      uint32_t right = term_node(term_store.right(node.left));
+      nodes[current] = {Node::Kind::kApp, left, right};
+      continue;
+    }
+    size_t combinator = combinator_arity(kind);
+    if (combinator == 0)
+      break;
+    if (spine.size() < combinator) {
+      // Calls with the same first arguments can share a partial application, but each of them
+      // builds the body afresh. So a parameter is only added if the arguments built so far need no
+      // reducing: otherwise every call would reduce them again.
+      bool values = true;
+      for (uint32_t app_node : spine)
+        values = values && is_value(nodes[app_node].right);
+      if (arity == options.max_arity || !values)
+        break;
+      // The whole term is applied to the next parameter, so it goes under every other argument.
+      root = app(root, make(Node::Kind::kParam, arity++));
+      spine.insert(spine.begin(), root);
+      continue;
+    }
+    if (steps == options.max_steps || nodes.size() > options.max_nodes)
+      break;
+    uint32_t redex = spine[spine.size() - combinator];
+    uint32_t x[4];
+    for (size_t i = 0; i < combinator; i++)
+      x[i] = nodes[spine[spine.size() - 1 - i]].right;
+    spine.resize(spine.size() - combinator);
+    switch (kind) {
+    case TermKind::kI:
+    case TermKind::kK:
+      nodes[redex] = {Node::Kind::kIndirection, x[0], 0};
+      break;
+    case TermKind::kS:
+      nodes[redex] = {Node::Kind::kApp, app(x[0], x[2]), app(x[1], x[2])};
+      break;
+    case TermKind::kB:
+      nodes[redex] = {Node::Kind::kApp, x[0], app(x[1], x[2])};
+      break;
+    case TermKind::kC:
+      nodes[redex] = {Node::Kind::kApp, app(x[0], x[2]), x[1]};
+      break;
+    case TermKind::kSPrime:
+      nodes[redex] = {Node::Kind::kApp, app(x[0], app(x[1], x[3])), app(x[2], x[3])};
+      break;
+    case TermKind::kBStar:
+      nodes[redex] = {Node::Kind::kApp, x[0], app(x[1], app(x[2], x[3]))};
+      break;
+    case TermKind::kCPrime:
+      nodes[redex] = {Node::Kind::kApp, app(x[0], app(x[1], x[3])), x[2]};
+      break;
+    default:
+      break;
+    }
+    steps++;
+    stepped_root = root;
+    stepped_arity = arity;
+    current = redex;
+  }
+  if (stepped_arity == 0)
+    return false;
+
+  // The body is what the root reaches, children before parents.
+  Supercombinator result{name, term, stepped_arity, steps, {}};
+  std::vector<uint32_t> index(nodes.size(), ~0u);
+  std::vector<uint32_t> pending{follow(stepped_root)};
+  while (!pending.empty()) {
+    uint32_t node = pending.back();
+    if (index[node] != ~0u) {
+      pending.pop_back();
+      continue;
+    }
+    Node body_node = nodes[node];
+    if (origins[node] != kNoTerm) {
+      result.body.push_back({BodyNode::Kind::kTerm, origins[node], 0});
+    } else if (body_node.kind == Node::Kind::kApp) {
+      uint32_t left = follow(body_node.left);
+      uint32_t right = follow(body_node.right);
+      if (index[left] == ~0u || index[right] == ~0u) {
+        if (index[right] == ~0u)
+          pending.push_back(right);
+        if (index[left] == ~0u)
+          pending.push_back(left);
+        continue;
+      }
+      result.body.push_back({BodyNode::Kind::kApp, index[left], index[right]});
+    } else {
+      result.body.push_back({BodyNode::Kind::kParam, body_node.left, 0});
+    }
+    index[node] = static_cast<uint32_t>(result.body.size() - 1);
+    pending.pop_back();
+  }
+  compiled.emplace(term, supercombinators.size());
+  supercombinators.push_back(std::move(result));
+  return true;
+}
+
+std::vector<Term> AotCompiler::collect_terms() const {
+  std::vector<Term> order;
+  std::unordered_map<Term, bool> visited;
+  for (Term term = TermStore::kSTerm; term <= TermStore::kCPrimeTerm; term++) {
+    order.push_back(term);
+    visited[term] = true;
+  }
+  std::vector<Term> roots = exprs;
+  for (const ResolvedAssertion& assertion : assertions) {
+    roots.push_back(assertion.left);
+    roots.push_back(assertion.right);
+  }
+  for (const Supercombinator& supercombinator : supercombinators) {
+    roots.push_back(supercombinator.term);
+    for (const BodyNode& node : supercombinator.body) {
+      if (node.kind == BodyNode::Kind::kTerm)
+        roots.push_back(node.left);
+    }
+  }
+  // A term is added once both of its children are.
+  for (Term root : roots) {
+    std::vector<Term> pending{root};
+    while (!pending.empty()) {
+      Term current = pending.back();
+      if (visited.count(current)) {
+        pending.pop_back();
+        continue;
+      }
+      if (term_store.kind(current) == TermKind::kApp) {
+        Term left = term_store.left(current);
+        Term right = term_store.right(current);
+        if (!visited.count(left) || !visited.count(right)) {
+          if (!visited.count(right))
+            pending.push_back(right);
+          if (!visited.count(left))
+            pending.push_back(left);
+          continue;
+        }
+      }
+      visited[current] = true;
+      order.push_back(current);
+      pending.pop_back();
+    }
+  }
+  return order;
+}
+
+// s as a C++ string literal.
+static std::string quote(const std::string& s) {
+  std::string literal = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      literal += '\\';
+    literal += c;
+  }
+  return literal + "\"";
+}
+
+// Writes items separated by commas, wrapping lines before they reach 100 characters.
+static void emit_list(std::ostream& output, const std::vector<std::string>& items) {
+  std::string line = "   ";
+  for (const std::string& item : items) {
+    if (line.size() + item.size() + 2 > 100) {
+      output << line << "\n";
+      line = "   ";
+    }
+    line += " " + item + ",";
+  }
+  output << line << "\n";
+}
+
+void AotCompiler::emit(std::ostream& output, const std::string& source) const {
+  std::vector<Term> terms = collect_terms();
+  std::unordered_map<Term, uint32_t> ids;
+  for (uint32_t id = 0; id < terms.size(); id++)
+    ids[terms[id]] = id;
+  std::vector<std::string> names;
+  std::vector<std::string> entries;
+  for (Term term : terms) {
+    switch (term_store.kind(term)) {
+    case TermKind::kApp:
+      entries.push_back("{" + std::to_string(ids[term_store.left(term)]) + ", " +
+                        std::to_string(ids[term_store.right(term)]) + "}");
+      break;
+    case TermKind::kVar:
+      entries.push_back("{" + std::to_string(names.size()) + ", kLeaf}");
+      names.push_back(quote(term_store.identifier(term)));
+      break;
+    default:
+      entries.push_back("{0, kLeaf}");
+      break;
+    }
+  }
+
+  output << "// Generated by ski-compile from " << source << ". Do not edit.\n";
+  output << "#include \"aot_runtime.h\"\n";
+  if (!options.library)
+    output << "\n#include <iostream>\n";
+  output << "\nnamespace {\n\n";
+  output << "using Ski::Aot::Machine;\nusing Ski::Aot::Ref;\n\n";
+  output << "constexpr uint32_t kLeaf = Ski::Aot::kLeafEntry;\n\n";
+  output << "const Ski::Aot::TermEntry kTerms[] = {\n";
+  emit_list(output, entries);
+  output << "};\n";
+  if (!names.empty()) {
+    output << "\nconst char* const kNames[] = {\n";
+    emit_list(output, names);
+    output << "};\n";
+  }
+
+  std::vector<std::string> definitions;
+  for (size_t i = 0; i < supercombinators.size(); i++) {
+    const Supercombinator& supercombinator = supercombinators[i];
+    const std::vector<BodyNode>& body = supercombinator.body;
+    std::string function = "definition_" + std::to_string(i);
+    std::string head = supercombinator.name;
+    for (uint32_t param = 0; param < supercombinator.arity; param++)
+      head += " x" + std::to_string(param);
+    output << "\n// " << head << " = " << format_body(supercombinator, term_store, 60) << "\n";
+    bool uses_params = false;
+    for (const BodyNode& node : body)
+      uses_params |= node.kind == BodyNode::Kind::kParam;
+    output << "void " << function << "(Machine& m, Ref redex, const Ref*"
+           << (uses_params ? " x" : "") << ") {\n";
+    // Applications and store terms that are not leaves get a local each; the root overwrites the
+    // redex instead.
+    auto operand = [&](uint32_t node) -> std::string {
+      switch (body[node].kind) {
+      case BodyNode::Kind::kParam:
+        return "x[" + std::to_string(body[node].left) + "]";
+      case BodyNode::Kind::kTerm:
+        if (term_store.kind(body[node].left) != TermKind::kApp)
+          return "Machine::leaf(" + std::to_string(ids[body[node].left]) + ")";
+        break;
+      case BodyNode::Kind::kApp:
+        break;
+      }
+      return "t" + std::to_string(node);
+    };
+    uint32_t root = static_cast<uint32_t>(body.size() - 1);
+    for (uint32_t node = 0; node < root; node++) {
+      if (operand(node) != "t" + std::to_string(node))
+        continue;
+      output << "  Ref t" << node << " = ";
+      if (body[node].kind == BodyNode::Kind::kTerm)
+        output << "m.build(" << ids[body[node].left] << ");\n";
+      else
+        output << "m.app(" << operand(body[node].left) << ", " << operand(body[node].right)
+               << ");\n";
+    }
+    if (body[root].kind == BodyNode::Kind::kApp)
+      output << "  m.set_app(redex, " << operand(body[root].left) << ", "
+             << operand(body[root].right) << ");\n";
+    else if (body[root].kind == BodyNode::Kind::kTerm &&
+             term_store.kind(body[root].left) == TermKind::kApp)
+      output << "  m.set_indirection(redex, m.build(" << ids[body[root].left] << "));\n";
+    else
+      output << "  m.set_indirection(redex, " << operand(root) << ");\n";
+    output << "}\n";
+    definitions.push_back("{" + quote(supercombinator.name) + ", " +
+                          std::to_string(ids[supercombinator.term]) + ", " +
+                          std::to_string(supercombinator.arity) + ", " +
+                          std::to_string(supercombinator.steps) + ", " + function + "}");
+  }
+  if (!definitions.empty()) {
+    output << "\nconst Ski::Aot::Definition kDefinitions[] = {\n";
+    emit_list(output, definitions);
+    output << "};\n";
+  }
+
+  std::vector<std::string> expr_ids;
+  for (Term term : exprs)
+    expr_ids.push_back(std::to_string(ids[term]));
+  if (!expr_ids.empty()) {
+    output << "\nconst uint32_t kExprs[] = {\n";
+    emit_list(output, expr_ids);
+    output << "};\n";
+  }
+  std::vector<std::string> assertion_entries;
+  for (const ResolvedAssertion& assertion : assertions) {
+    assertion_entries.push_back("{" + std::to_string(assertion.line) + ", " +
+                                std::to_string(ids[assertion.left]) + ", " +
+                                std::to_string(ids[assertion.right]) + "}");
+  }
+  if (!assertion_entries.empty()) {
+    output << "\nconst Ski::Aot::Assertion kAssertions[] = {\n";
+    emit_list(output, assertion_entries);
+    output << "};\n";
+  }
+  output << "\n} // namespace\n\n";
+
+  auto table = [](const char* name, size_t size) {
+    return size ? std::string(name) + ", " + std::to_string(size) : std::string("nullptr, 0");
+  };
+  output << "extern const Ski::Aot::Program " << options.symbol << " = {\n";
+  output << "    " << quote(source) << ",\n";
+  output << "    " << table("kTerms", terms.size()) << ",\n";
+  output << "    " << (names.empty() ? "nullptr" : "kNames") << ",\n";
+  output << "    " << table("kDefinitions", definitions.size()) << ",\n";
+  output << "    " << table("kExprs", exprs.size()) << ",\n";
+  output << "    " << table("kAssertions", assertions.size()) << "};\n";
+  if (!options.library) {
+    output << "\nint main() { return Ski::Aot::run(" << options.symbol
+           << ", std::cout, std::cerr); }\n";
+  }
+}
+
+std::string format_body(const Supercombinator& supercombinator, const TermStore& term_store,
+                        size_t max_length) {
+  // Either a node still to print or, when text is set, a literal character. argument tells
+  // whether the node is the right child of an application.
+  struct Item {
+    uint32_t node;
+    char text;
+    bool argument;
+  };
+  const std::vector<BodyNode>& body = supercombinator.body;
+  std::string output;
+  std::vector<Item> pending{{static_cast<uint32_t>(body.size() - 1), 0, false}};
+  while (!pending.empty()) {
+    if (output.size() >= max_length) {
+      output.resize(max_length);
+      return output + "...";
+    }
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    const BodyNode& node = body[item.node];
+    switch (node.kind) {
+    case BodyNode::Kind::kParam:
+      output += "x" + std::to_string(node.left);
+      break;
+    case BodyNode::Kind::kTerm: {
+      bool wrap = item.argument && term_store.kind(node.left) == TermKind::kApp;
+      output += wrap ? "(" + term_store.to_string(node.left, Parens::kMinimal) + ")"
+                     : term_store.to_string(node.left, Parens::kMinimal);
+      break;
+    }
+    case BodyNode::Kind::kApp:
+      if (item.argument) {
+        output += '(';
+        pending.push_back({0, ')', false});
+      }
+      pending.push_back({node.right, 0, true});
+      pending.push_back({0, ' ', false});
+      pending.push_back({node.left, 0, false});
+      break;
+    }
+  }
+  return output;
+}
+
+} // namespace Ski
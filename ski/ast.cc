@@ -0,0 +1,122 @@
+#include <utility>
+#include <vector>
+
+#include "ast.h"
+
+namespace Ski {
+
+// Text of a childless node.
+static void print_leaf(const Expr& expr, std::string& output) {
+  switch (expr.get_kind()) {
+  case ExprKind::kVar:
+    output += static_cast<const Var&>(expr).get_identifier();
+    break;
+  case ExprKind::kS:
+    output += 'S';
+    break;
+  case ExprKind::kK:
+    output += 'K';
+    break;
+  case ExprKind::kI:
+    output += 'I';
+    break;
+  case ExprKind::kB:
+    output += 'B';
+    break;
+  case ExprKind::kC:
+    output += 'C';
+    break;
+  case ExprKind::kSPrime:
+    output += "S'";
+    break;
+  case ExprKind::kBStar:
+    output += "B*";
+    break;
+  case ExprKind::kCPrime:
+    output += "C'";
+    break;
+  case ExprKind::kApp:
+    break;
+  }
+}
+
+// Appends expr to output, handing output to flush whenever it reaches chunk bytes.
+template <typename Flush>
+static void print(const Expr& expr, Parens parens, std::string& output, size_t chunk,
+                  Flush flush) {
+  // Either an expression still to print or, when text is set, a literal character. argument
+  // tells whether the expression is the right child of an application.
+  struct Item {
+    const Expr* expr;
+    char text;
+    bool argument;
+  };
+  std::vector<Item> pending{{&expr, 0, false}};
+  while (!pending.empty()) {
+    if (output.size() >= chunk)
+      flush(output);
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    // Applications still being built may lack a child, which prints as nothing.
+    if (!item.expr)
+      continue;
+    if (item.expr->get_kind() != ExprKind::kApp) {
+      print_leaf(*item.expr, output);
+      continue;
+    }
+    auto app = static_cast<const App*>(item.expr);
+    bool wrap = parens == Parens::kAll || item.argument;
+    if (wrap) {
+      output += '(';
+      pending.push_back({nullptr, ')', false});
+    }
+    pending.push_back({app->get_right(), 0, true});
+    pending.push_back({nullptr, ' ', false});
+    pending.push_back({app->get_left(), 0, false});
+  }
+}
+
+void print_expr(const Expr& expr, std::string& output, Parens parens) {
+  print(expr, parens, output, ~size_t{0}, [](std::string&) {});
+}
+
+void print_expr(const Expr& expr, std::ostream& output, Parens parens) {
+  static constexpr size_t kChunkBytes = size_t{1} << 16;
+  std::string buffer;
+  auto flush = [&](std::string& text) {
+    output.write(text.data(), text.size());
+    text.clear();
+  };
+  print(expr, parens, buffer, kChunkBytes, flush);
+  flush(buffer);
+}
+
+bool equal_exprs(const Expr& a, const Expr& b) {
+  std::vector<std::pair<const Expr*, const Expr*>> pending{{&a, &b}};
+  while (!pending.empty()) {
+    auto [left, right] = pending.back();
+    pending.pop_back();
+    if (left == right)
+      continue;
+    if (!left || !right || left->get_hash() != right->get_hash() ||
+        left->get_size() != right->get_size() || left->get_kind() != right->get_kind())
+      return false;
+    if (left->get_kind() == ExprKind::kVar) {
+      if (static_cast<const Var*>(left)->get_symbol() !=
+          static_cast<const Var*>(right)->get_symbol())
+        return false;
+    } else if (left->get_kind() == ExprKind::kApp) {
+      auto left_app = static_cast<const App*>(left);
+      auto right_app = static_cast<const App*>(right);
+      pending.push_back({left_app->get_right(), right_app->get_right()});
+      pending.push_back({left_app->get_left(), right_app->get_left()});
+    }
+  }
+  return true;
+}
+
+} // namespace Ski
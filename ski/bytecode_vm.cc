@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <initializer_list>
+#include <unordered_set>
+
+#include "bytecode_vm.h"
+
+namespace Ski {
+
+static constexpr uint32_t kNoGlobal = ~0u;
+
+BytecodeProgram::BytecodeProgram(const TermStore& term_store) : term_store(term_store) {
+  emit(Opcode::kUnwind);
+  // Each rule pushes its right-hand side in postfix, n standing for the nth argument and 0 for an
+  // application. The last application overwrites the redex instead, and a lone argument becomes
+  // the result the redex refers to.
+  auto rule = [&](TermKind kind, std::initializer_list<uint32_t> rhs) {
+    combinator_addresses[static_cast<size_t>(kind)] = static_cast<uint32_t>(code.size());
+    uint32_t arity = static_cast<uint32_t>(combinator_arity(kind));
+    for (auto it = rhs.begin(); it != rhs.end(); ++it) {
+      if (*it)
+        emit(Opcode::kPushArg, *it);
+      else if (it + 1 != rhs.end())
+        emit(Opcode::kMkap);
+      else
+        emit(Opcode::kUpdateApp, arity);
+    }
+    if (rhs.size() == 1)
+      emit(Opcode::kUpdate, arity);
+    emit(Opcode::kUnwind);
+  };
+  // S x y z = x z (y z)
+  rule(TermKind::kS, {1, 3, 0, 2, 3, 0, 0});
+  // K x y = x
+  rule(TermKind::kK, {1});
+  // I x = x
+  rule(TermKind::kI, {1});
+  // B x y z = x (y z)
+  rule(TermKind::kB, {1, 2, 3, 0, 0});
+  // C x y z = x z y
+  rule(TermKind::kC, {1, 3, 0, 2, 0});
+  // S' c f g x = c (f x) (g x)
+  rule(TermKind::kSPrime, {1, 2, 4, 0, 0, 3, 4, 0, 0});
+  // B* c f g x = c (f (g x))
+  rule(TermKind::kBStar, {1, 2, 3, 4, 0, 0, 0});
+  // C' c f g x = c (f x) g
+  rule(TermKind::kCPrime, {1, 2, 4, 0, 0, 3, 0});
+}
+
+void BytecodeProgram::add_global(Term term) {
+  // Leaves are pushed directly, which is cheaper than any global.
+  if (term_store.kind(term) != TermKind::kApp || global_indexes.count(term))
+    return;
+  global_indexes.emplace(term, static_cast<uint32_t>(globals.size()));
+  globals.push_back({term, kNoAddress});
+}
+
+uint32_t BytecodeProgram::compile(Term term) {
+  auto it = compiled.find(term);
+  if (it != compiled.end())
+    return it->second;
+  uint32_t address = compile_block(term, Opcode::kReturn, kNoGlobal);
+  compiled.emplace(term, address);
+  // Compiling a global may reach globals no code used before.
+  while (!queued.empty()) {
+    uint32_t global = queued.back();
+    queued.pop_back();
+    globals[global].address = compile_block(globals[global].term, Opcode::kSetGlobal, global);
+  }
+  return address;
+}
+
+uint32_t BytecodeProgram::compile_block(Term term, Opcode end, uint32_t global) {
+  auto global_of = [&](Term subterm) {
+    auto it = global_indexes.find(subterm);
+    return it == global_indexes.end() || it->second == global ? kNoGlobal : it->second;
+  };
+  // Applications used more than once are built once and kept in locals. Globals are cells of
+  // their own, so their uses are not counted.
+  std::unordered_map<Term, uint32_t> uses;
+  std::vector<Term> pending{term};
+  while (!pending.empty()) {
+    Term current = pending.back();
+    pending.pop_back();
+    if (term_store.kind(current) != TermKind::kApp || global_of(current) != kNoGlobal)
+      continue;
+    if (uses[current]++)
+      continue;
+    pending.push_back(term_store.left(current));
+    pending.push_back(term_store.right(current));
+  }
+  // The graph is built in postorder, left child first. Every use of a shared application after
+  // the first loads it, which is safe since the first is finished before any other is reached.
+  uint32_t address = static_cast<uint32_t>(code.size());
+  std::unordered_map<Term, uint32_t> locals;
+  struct Item {
+    Term term;
+    bool children_pushed;
+  };
+  std::vector<Item> items{{term, false}};
+  while (!items.empty()) {
+    Item item = items.back();
+    items.pop_back();
+    Term current = item.term;
+    if (term_store.kind(current) != TermKind::kApp) {
+      emit(Opcode::kPushLeaf, current);
+      continue;
+    }
+    uint32_t current_global = global_of(current);
+    if (current_global != kNoGlobal) {
+      emit(Opcode::kPushGlobal, current_global);
+      if (globals[current_global].address == kNoAddress) {
+        globals[current_global].address = kQueued;
+        queued.push_back(current_global);
+      }
+      continue;
+    }
+    if (item.children_pushed) {
+      emit(Opcode::kMkap);
+      if (uses[current] > 1) {
+        uint32_t local = static_cast<uint32_t>(locals.size());
+        locals.emplace(current, local);
+        emit(Opcode::kStore, local);
+      }
+      continue;
+    }
+    auto it = locals.find(current);
+    if (it != locals.end()) {
+      emit(Opcode::kLoad, it->second);
+      continue;
+    }
+    items.push_back({current, true});
+    items.push_back({term_store.right(current), false});
+    items.push_back({term_store.left(current), false});
+  }
+  emit(end);
+  // A global's cell is unwound again once it refers to its graph.
+  if (end == Opcode::kSetGlobal)
+    emit(Opcode::kUnwind);
+  max_locals = std::max(max_locals, static_cast<uint32_t>(locals.size()));
+  return address;
+}
+
+std::string BytecodeProgram::disassemble(uint32_t address) const {
+  std::string output;
+  for (uint32_t pc = address;;) {
+    Opcode opcode = static_cast<Opcode>(code[pc++]);
+    switch (opcode) {
+    case Opcode::kPushLeaf:
+      output += "push_leaf " + term_store.to_string(code[pc++]);
+      break;
+    case Opcode::kPushGlobal:
+      output += "push_global " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kStore:
+      output += "store " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kLoad:
+      output += "load " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kMkap:
+      output += "mkap";
+      break;
+    case Opcode::kReturn:
+      output += "return";
+      break;
+    case Opcode::kSetGlobal:
+      output += "set_global";
+      break;
+    case Opcode::kPushArg:
+      output += "push_arg " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kUpdate:
+      output += "update " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kUpdateApp:
+      output += "update_app " + std::to_string(code[pc++]);
+      break;
+    case Opcode::kUnwind:
+      output += "unwind";
+      break;
+    }
+    output += '\n';
+    if (opcode == Opcode::kReturn || opcode == Opcode::kUnwind)
+      return output;
+  }
+}
+
+BytecodeVm::BytecodeVm(const BytecodeProgram& program)
+    : program(program), term_store(program.get_term_store()),
+      global_cells(program.get_global_count(), kNone) {}
+
+bool BytecodeVm::evaluate(uint32_t address, BudgetMeter* meter) {
+  this->meter = meter;
+  locals.resize(program.get_max_locals());
+  stack.clear();
+  run(address);
+  root = stack.back();
+  bool finished = normalize(root);
+  this->meter = nullptr;
+  return finished;
+}
+
+BytecodeVm::Ref BytecodeVm::global_cell(uint32_t global) {
+  if (global_cells[global] == kNone)
+    global_cells[global] = make_cell(global, kGlobal);
+  return global_cells[global];
+}
+
+bool BytecodeVm::run(uint32_t pc) {
+  const uint32_t* code = program.get_code();
+  while (true) {
+    switch (static_cast<Opcode>(code[pc++])) {
+    case Opcode::kPushLeaf:
+      stack.push_back(kLeaf | code[pc++]);
+      break;
+    case Opcode::kPushGlobal:
+      stack.push_back(global_cell(code[pc++]));
+      break;
+    case Opcode::kStore:
+      locals[code[pc++]] = stack.back();
+      break;
+    case Opcode::kLoad:
+      stack.push_back(locals[code[pc++]]);
+      break;
+    case Opcode::kMkap: {
+      Ref right = stack.back();
+      stack.pop_back();
+      stack.back() = make_cell(stack.back(), right);
+      break;
+    }
+    case Opcode::kReturn:
+      return true;
+    case Opcode::kSetGlobal: {
+      // The global's cell is below its graph, where unwinding left it.
+      Ref graph = stack.back();
+      stack.pop_back();
+      cells[stack.back()] = {follow(graph), kIndirection};
+      break;
+    }
+    case Opcode::kPushArg:
+      stack.push_back(cells[stack[frame - code[pc++]]].right);
+      break;
+    case Opcode::kUpdate: {
+      uint32_t n = code[pc++];
+      Ref result = stack.back();
+      Ref redex = stack[frame - n];
+      cells[redex] = {follow(result), kIndirection};
+      stack.resize(frame - n + 1);
+      break;
+    }
+    case Opcode::kUpdateApp: {
+      uint32_t n = code[pc++];
+      Ref right = stack.back();
+      Ref left = stack[stack.size() - 2];
+      Ref redex = stack[frame - n];
+      cells[redex] = {left, right};
+      stack.resize(frame - n + 1);
+      break;
+    }
+    case Opcode::kUnwind: {
+      Ref current = follow(stack.back());
+      stack.back() = current;
+      while (is_app(current)) {
+        current = follow(cells[current].left);
+        stack.push_back(current);
+      }
+      if (!is_leaf(current)) {
+        pc = program.get_global_address(cells[current].left);
+        break;
+      }
+      TermKind kind = term_store.kind(leaf_term(current));
+      size_t arity = combinator_arity(kind);
+      // A free variable or an unsaturated combinator at the head.
+      if (arity == 0 || stack.size() - 1 < arity)
+        return true;
+      if (meter && !charge_step())
+        return false;
+      steps++;
+      if constexpr (kStatsEnabled)
+        rule_stats.rule_steps[static_cast<size_t>(kind)]++;
+      frame = stack.size() - 1;
+      pc = program.get_combinator_address(kind);
+      break;
+    }
+    }
+  }
+}
+
+bool BytecodeVm::whnf(Ref ref) {
+  stack.clear();
+  stack.push_back(ref);
+  cycles.reset();
+  skipped_steps = 0;
+  skip = 1;
+  return run(BytecodeProgram::kUnwindAddress);
+}
+
+bool BytecodeVm::normalize(Ref ref) {
+  std::vector<Ref> pending{ref};
+  while (!pending.empty()) {
+    Ref current = follow(pending.back());
+    pending.pop_back();
+    if (is_leaf(current) || normal[current])
+      continue;
+    if (!whnf(current))
+      return false;
+    // Unwinding instantiated every global on the spine, which is final once its arguments are.
+    for (current = follow(current); is_app(current); current = follow(cells[current].left)) {
+      normal[current] = true;
+      pending.push_back(cells[current].right);
+    }
+  }
+  return true;
+}
+
+bool BytecodeVm::charge_step() {
+  // The root being reduced is fingerprinted before every step, which the graph engine does too.
+  if (meter->detects_cycles()) {
+    if (skipped_steps) {
+      skipped_steps--;
+    } else if (std::optional<uint64_t> hash = fingerprint(stack.front())) {
+      if (cycles.visit(*hash, meter->get_steps())) {
+        meter->report_cycle(cycles.get_cycle());
+        return false;
+      }
+    } else {
+      cycles.reset();
+      skipped_steps = skip;
+      skip *= 2;
+    }
+  }
+  // Cells are never freed, so the graph only grows.
+  ptrdiff_t growth = cells.size() - charged_cells;
+  charged_cells = cells.size();
+  return meter->charge(growth);
+}
+
+std::optional<uint64_t> BytecodeVm::fingerprint(Ref ref) {
+  // Keys with kTermKey set stand for store terms, the others for application cells.
+  static constexpr uint64_t kTermKey = uint64_t{1} << 32;
+  auto key_of = [&](Ref child) {
+    child = follow(child);
+    if (is_leaf(child))
+      return kTermKey | leaf_term(child);
+    if (cells[child].right == kGlobal)
+      return kTermKey | program.get_global_term(cells[child].left);
+    return uint64_t{child};
+  };
+  // A node's hash is known once both of its children's are.
+  fingerprints.clear();
+  size_t visits = 0;
+  std::vector<uint64_t> pending{key_of(ref)};
+  while (!pending.empty()) {
+    uint64_t key = pending.back();
+    if (fingerprints.count(key)) {
+      pending.pop_back();
+      continue;
+    }
+    if (++visits > kFingerprintVisits)
+      return std::nullopt;
+    uint64_t children[2];
+    if (key & kTermKey) {
+      Term term = static_cast<Term>(key);
+      if (term_store.kind(term) != TermKind::kApp) {
+        fingerprints[key] = mix_hash(term);
+        pending.pop_back();
+        continue;
+      }
+      children[0] = kTermKey | term_store.left(term);
+      children[1] = kTermKey | term_store.right(term);
+    } else {
+      children[0] = key_of(cells[key].left);
+      children[1] = key_of(cells[key].right);
+    }
+    if (!fingerprints.count(children[0]) || !fingerprints.count(children[1])) {
+      for (uint64_t child : children) {
+        if (!fingerprints.count(child))
+          pending.push_back(child);
+      }
+      continue;
+    }
+    fingerprints[key] = app_hash(fingerprints[children[0]], fingerprints[children[1]]);
+    pending.pop_back();
+  }
+  return fingerprints[key_of(ref)];
+}
+
+Term BytecodeVm::normal_form_term(TermStore& store) const {
+  // Shared cells are converted once; a cell's term is known once both of its children's are.
+  std::unordered_map<Ref, Term> terms;
+  auto term_of = [&](Ref ref) -> std::optional<Term> {
+    if (is_leaf(ref))
+      return leaf_term(ref);
+    if (cells[ref].right == kGlobal)
+      return program.get_global_term(cells[ref].left);
+    auto it = terms.find(ref);
+    return it == terms.end() ? std::nullopt : std::optional<Term>(it->second);
+  };
+  std::vector<Ref> pending{follow(root)};
+  while (!pending.empty()) {
+    Ref current = pending.back();
+    if (term_of(current)) {
+      pending.pop_back();
+      continue;
+    }
+    Ref left = follow(cells[current].left);
+    Ref right = follow(cells[current].right);
+    std::optional<Term> left_term = term_of(left);
+    std::optional<Term> right_term = term_of(right);
+    if (!left_term)
+      pending.push_back(left);
+    if (!right_term)
+      pending.push_back(right);
+    if (left_term && right_term) {
+      terms[current] = store.app(*left_term, *right_term);
+      pending.pop_back();
+    }
+  }
+  return *term_of(follow(root));
+}
+
+size_t BytecodeVm::count_nodes() const {
+  std::vector<bool> counted(cells.size());
+  std::unordered_set<Term> counted_terms;
+  size_t count = 0;
+  std::vector<Ref> pending{root};
+  while (!pending.empty()) {
+    Ref current = follow(pending.back());
+    pending.pop_back();
+    if (is_leaf(current)) {
+      count++;
+      continue;
+    }
+    if (counted[current])
+      continue;
+    counted[current] = true;
+    if (cells[current].right == kGlobal) {
+      count += term_store.count_nodes(program.get_global_term(cells[current].left), counted_terms);
+      continue;
+    }
+    count++;
+    pending.push_back(cells[current].left);
+    pending.push_back(cells[current].right);
+  }
+  return count;
+}
+
+std::string BytecodeVm::normal_form(size_t max_length, Parens parens) const {
+  // Either a reference still to print or, when text is set, a literal character. argument tells
+  // whether the reference is the right child of an application.
+  struct Item {
+    Ref ref;
+    char text;
+    bool argument;
+  };
+  std::string output;
+  std::vector<Item> pending{{root, 0, false}};
+  while (!pending.empty()) {
+    if (output.size() >= max_length) {
+      output.resize(max_length);
+      return output + "...";
+    }
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    Ref current = follow(item.ref);
+    if (is_leaf(current)) {
+      output += term_store.to_string(leaf_term(current));
+      continue;
+    }
+    if (cells[current].right == kGlobal) {
+      // Stored terms print their own inner parentheses, but not the ones their position needs.
+      bool wrap = parens == Parens::kMinimal && item.argument;
+      if (wrap)
+        output += '(';
+      output += term_store.to_string(program.get_global_term(cells[current].left), parens);
+      if (wrap)
+        output += ')';
+      continue;
+    }
+    if (parens == Parens::kAll || item.argument) {
+      output += '(';
+      pending.push_back({0, ')', false});
+    }
+    pending.push_back({cells[current].right, 0, true});
+    pending.push_back({0, ' ', false});
+    pending.push_back({cells[current].left, 0, false});
+  }
+  return output;
+}
+
+} // namespace Ski
@@ -0,0 +1,87 @@
+#include <vector>
+
+#include "combinator_optimizer.h"
+
+namespace Ski {
+
+CombinatorOptimizer::CombinatorOptimizer(TermStore& term_store) : term_store(term_store) {}
+
+Term CombinatorOptimizer::optimize(Term term) {
+  // Post-order walk with an explicit stack; the cache keeps the sharing of the store.
+  std::vector<Term> pending{term};
+  while (!pending.empty()) {
+    Term current = pending.back();
+    if (term_store.kind(current) != TermKind::kApp) {
+      optimized.emplace(current, current);
+      pending.pop_back();
+      continue;
+    }
+    if (optimized.count(current)) {
+      pending.pop_back();
+      continue;
+    }
+    Term left = term_store.left(current);
+    Term right = term_store.right(current);
+    bool ready = true;
+    for (Term child : {right, left}) {
+      if (!optimized.count(child)) {
+        pending.push_back(child);
+        ready = false;
+      }
+    }
+    if (!ready)
+      continue;
+    pending.pop_back();
+    optimized.emplace(current, rewrite(optimized.at(left), optimized.at(right)));
+  }
+  return optimized.at(term);
+}
+
+// Rewrites the application of already optimized terms left and right.
+Term CombinatorOptimizer::rewrite(Term left, Term right) {
+  Term x;
+  if (!match_app(left, term_store.s(), x))
+    return term_store.app(left, right);
+  Term y = right;
+  Term p, q, r;
+  if (match_app(x, term_store.k(), p)) {
+    // S (K p) I => p
+    if (y == term_store.i())
+      return p;
+    // S (K p) (B q r) => B* p q r
+    if (match_app2(y, term_store.b(), q, r))
+      return term_store.app(term_store.app(term_store.app(term_store.b_star(), p), q), r);
+    // S (K p) q => B p q
+    return term_store.app(term_store.app(term_store.b(), p), y);
+  }
+  if (match_app2(x, term_store.b(), p, q)) {
+    // S (B p q) (K r) => C' p q r
+    if (match_app(y, term_store.k(), r))
+      return term_store.app(term_store.app(term_store.app(term_store.c_prime(), p), q), r);
+    // S (B p q) r => S' p q r
+    return term_store.app(term_store.app(term_store.app(term_store.s_prime(), p), q), y);
+  }
+  // S p (K q) => C p q
+  if (match_app(y, term_store.k(), q))
+    return term_store.app(term_store.app(term_store.c(), x), q);
+  return term_store.app(left, right);
+}
+
+// Matches term against (function argument).
+bool CombinatorOptimizer::match_app(Term term, Term function, Term& argument) const {
+  if (term_store.kind(term) != TermKind::kApp || term_store.left(term) != function)
+    return false;
+  argument = term_store.right(term);
+  return true;
+}
+
+// Matches term against (function first second).
+bool CombinatorOptimizer::match_app2(Term term, Term function, Term& first, Term& second) const {
+  if (term_store.kind(term) != TermKind::kApp ||
+      !match_app(term_store.left(term), function, first))
+    return false;
+  second = term_store.right(term);
+  return true;
+}
+
+} // namespace Ski
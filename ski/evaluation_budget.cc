@@ -0,0 +1,69 @@
+#include "evaluation_budget.h"
+
+namespace Ski {
+
+const char* eval_status_name(EvalStatus status) {
+  switch (status) {
+  case EvalStatus::kNormalForm:
+    return "normal form";
+  case EvalStatus::kStepLimit:
+    return "step limit";
+  case EvalStatus::kNodeLimit:
+    return "node limit";
+  case EvalStatus::kTimeLimit:
+    return "time limit";
+  case EvalStatus::kCancelled:
+    return "cancelled";
+  case EvalStatus::kCycle:
+    return "cycle";
+  }
+  return "unknown";
+}
+
+BudgetMeter::BudgetMeter(const EvaluationBudget& budget) : budget(budget) {
+  if (budget.max_time.count())
+    deadline = std::chrono::steady_clock::now() + budget.max_time;
+}
+
+bool BudgetMeter::check(size_t step, ptrdiff_t node_count) {
+  EvalStatus reason = EvalStatus::kNormalForm;
+  if (budget.max_steps && step > budget.max_steps)
+    reason = EvalStatus::kStepLimit;
+  else if (budget.max_nodes && node_count > static_cast<ptrdiff_t>(budget.max_nodes))
+    reason = EvalStatus::kNodeLimit;
+  else if (budget.max_time.count() && std::chrono::steady_clock::now() >= deadline)
+    reason = EvalStatus::kTimeLimit;
+  else if (budget.cancellation && budget.cancellation->is_cancelled())
+    reason = EvalStatus::kCancelled;
+  if (reason == EvalStatus::kNormalForm)
+    return true;
+  // The first limit reached wins when subterm threads reach several at once.
+  EvalStatus expected = EvalStatus::kNormalForm;
+  status.compare_exchange_strong(expected, reason, std::memory_order_relaxed);
+  return false;
+}
+
+bool CycleDetector::visit(uint64_t fingerprint, size_t step) {
+  if (has_saved && fingerprint == saved) {
+    cycle = {saved_step, step - saved_step};
+    return true;
+  }
+  // Once the saved state is in the cycle and power is at least its length, the state comes back
+  // before it is replaced.
+  if (!has_saved || ++visits == power) {
+    saved = fingerprint;
+    saved_step = step;
+    has_saved = true;
+    power *= 2;
+    visits = 0;
+  }
+  return false;
+}
+
+void BudgetMeter::report_cycle(const Cycle& cycle) {
+  EvalStatus expected = EvalStatus::kNormalForm;
+  if (status.compare_exchange_strong(expected, EvalStatus::kCycle, std::memory_order_relaxed))
+    this->cycle = cycle;
+}
+
+} // namespace Ski
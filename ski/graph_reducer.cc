@@ -0,0 +1,625 @@
+#include <limits>
+#include <unordered_set>
+
+#include "graph_reducer.h"
+
+namespace Ski {
+
+GraphReducer::GraphReducer(const TermStore& term_store, const ChurchJets* jets,
+                           const NormalFormCache* cache)
+    : term_store(term_store), jets(jets), cache(cache) {}
+
+std::string GraphReducer::reduce(Term term) {
+  evaluate(term);
+  return normal_form();
+}
+
+bool GraphReducer::evaluate(Term term, BudgetMeter* meter) {
+  this->meter = meter;
+  root = build(term);
+  bool finished = normalize(root);
+  this->meter = nullptr;
+  return finished;
+}
+
+bool GraphReducer::try_normalize(Term term, size_t max_steps) {
+  this->max_steps = steps + max_steps;
+  root = build(term);
+  bool finished = normalize(root);
+  this->max_steps = ~size_t{0};
+  return finished;
+}
+
+void GraphReducer::record_normal_forms(TermStore& store, NormalFormCache& cache) {
+  // Everything reachable from the root is in normal form now. Other cells may have been left
+  // anywhere between their term and its normal form.
+  std::vector<bool> reachable(cells.size());
+  std::vector<Ref> pending{root};
+  while (!pending.empty()) {
+    Ref current = follow(pending.back());
+    pending.pop_back();
+    if (is_leaf(current) || reachable[current])
+      continue;
+    reachable[current] = true;
+    if (is_app(current)) {
+      pending.push_back(cells[current].left);
+      pending.push_back(cells[current].right);
+    }
+  }
+  std::unordered_map<Ref, Term> terms;
+  for (auto [term, ref] : built) {
+    Ref current = follow(ref);
+    if (!is_leaf(current) && !reachable[current])
+      continue;
+    size_t store_size = store.size();
+    Term normal_form = to_term(current, store, terms);
+    cache.count_terms(store.size() - store_size);
+    if (!cache.insert(term, normal_form))
+      return;
+  }
+}
+
+GraphReducer::Ref GraphReducer::build(Term term) {
+  // Applications start out as unbuilt cells that expand one level at a time when the reducer first
+  // looks at them, so parts of the term (and the definitions they use) that reduction discards are
+  // never built. Terms are hash-consed, so building through the cache keeps the sharing of the
+  // store.
+  if (term_store.kind(term) != TermKind::kApp)
+    return kLeaf | term;
+  auto it = built.find(term);
+  if (it != built.end())
+    return it->second;
+  Ref ref = make_cell(term, kUnbuilt);
+  built.emplace(term, ref);
+  return ref;
+}
+
+void GraphReducer::expand(Ref ref) {
+  Term term = cells[ref].left;
+  if (cache) {
+    if (std::optional<Term> normal_form = cache->find(term)) {
+      cache_hits++;
+      // Building may grow cells, so the target is indexed afterwards.
+      Ref target = build(*normal_form);
+      cells[ref] = {target, kIndirection};
+      return;
+    }
+    cache_misses++;
+  }
+  if (jets) {
+    uint32_t value = numeral_value(term);
+    if (value != kNotNumeral) {
+      cells[ref] = {value, kNumber};
+      return;
+    }
+    if (term == jets->inc) {
+      cells[ref] = {0, kIncJet};
+      return;
+    }
+    if (term == jets->add) {
+      cells[ref] = {0, kAddJet};
+      return;
+    }
+  }
+  Ref left = build(term_store.left(term));
+  Ref right = build(term_store.right(term));
+  cells[ref] = {left, right};
+}
+
+// The value of term if it is inc (inc ... (inc 0)), or kNotNumeral.
+uint32_t GraphReducer::numeral_value(Term term) {
+  std::vector<Term> chain;
+  uint32_t value = kNotNumeral;
+  while (true) {
+    auto it = numeral_values.find(term);
+    if (it != numeral_values.end()) {
+      value = it->second;
+      break;
+    }
+    if (term == jets->zero) {
+      value = 0;
+      break;
+    }
+    chain.push_back(term);
+    if (term_store.kind(term) != TermKind::kApp || term_store.left(term) != jets->inc)
+      break;
+    term = term_store.right(term);
+  }
+  // Every term on the chain is one more than the next, or no numeral at all.
+  while (!chain.empty()) {
+    if (value != kNotNumeral)
+      value = value + 1 < kNotNumeral ? value + 1 : kNotNumeral;
+    numeral_values.emplace(chain.back(), value);
+    chain.pop_back();
+  }
+  return value;
+}
+
+GraphReducer::Ref GraphReducer::make_app(Ref left, Ref right) { return make_cell(left, right); }
+
+GraphReducer::Ref GraphReducer::make_cell(Ref left, Ref right) {
+  cells.push_back({left, right});
+  normal.push_back(false);
+  return cells.size() - 1;
+}
+
+void GraphReducer::set_app(Ref ref, Ref left, Ref right) { cells[ref] = {left, right}; }
+
+GraphReducer::Ref GraphReducer::follow(Ref ref) const {
+  while (!is_leaf(ref) && cells[ref].right == kIndirection)
+    ref = cells[ref].left;
+  return ref;
+}
+
+GraphReducer::Ref GraphReducer::resolve(Ref ref) {
+  ref = follow(ref);
+  while (!is_leaf(ref) && cells[ref].right == kUnbuilt) {
+    // A cached normal form turns the cell into an indirection.
+    expand(ref);
+    ref = follow(ref);
+  }
+  return ref;
+}
+
+// Reduces the graph at ref to weak head normal form, updating every contracted redex in place.
+// Returns false if the step budget ran out first.
+bool GraphReducer::whnf(Ref ref) {
+  spine.clear();
+  Ref current = ref;
+  // With cycle detection every state is fingerprinted. Each combinator step contracts the head
+  // redex, and cached normal forms only reduce the term further, so a state coming back means the
+  // term has no head normal form. Jets are shortcuts rather than head reductions, so they start
+  // the sequence afresh, and so does a term too big to fingerprint, which is then left alone for
+  // twice as many steps as the last time.
+  CycleDetector cycles;
+  bool detect_cycles = meter && meter->detects_cycles();
+  size_t skipped_steps = 0;
+  size_t skip = 1;
+  while (true) {
+    if (steps > max_steps)
+      return false;
+    if (detect_cycles) {
+      if (skipped_steps) {
+        skipped_steps--;
+      } else if (std::optional<uint64_t> hash = fingerprint(ref)) {
+        if (cycles.visit(*hash, meter->get_steps())) {
+          meter->report_cycle(cycles.get_cycle());
+          return false;
+        }
+      } else {
+        cycles.reset();
+        skipped_steps = skip;
+        skip *= 2;
+      }
+    }
+    current = resolve(current);
+    while (is_app(current)) {
+      spine.push_back(current);
+      current = resolve(cells[current].left);
+    }
+    if (!is_leaf(current)) {
+      if (!contract_jet(current, current))
+        return true;
+      steps++;
+      if constexpr (kStatsEnabled)
+        rule_stats.jet_steps++;
+      if (meter && !charge_step())
+        return false;
+      if (detect_cycles)
+        cycles.reset();
+      continue;
+    }
+    Term head = leaf_term(current);
+    size_t arity = combinator_arity(term_store.kind(head));
+    // A free variable or an unsaturated combinator at the head.
+    if (arity == 0 || spine.size() < arity)
+      return true;
+    if (meter && !charge_step())
+      return false;
+    steps++;
+    if constexpr (kStatsEnabled)
+      rule_stats.rule_steps[static_cast<size_t>(term_store.kind(head))]++;
+    // The redex root is overwritten with the result; x[0] is the first argument.
+    Ref redex = spine[spine.size() - arity];
+    Ref x[4];
+    for (size_t i = 0; i < arity; i++)
+      x[i] = cells[spine[spine.size() - 1 - i]].right;
+    spine.resize(spine.size() - arity);
+    switch (head) {
+    case TermStore::kITerm:
+      // I x = x
+    case TermStore::kKTerm:
+      // K x y = x
+      cells[redex] = {follow(x[0]), kIndirection};
+      current = cells[redex].left;
+      continue;
+    case TermStore::kSTerm:
+      // S x y z = x z (y z)
+      set_app(redex, make_app(x[0], x[2]), make_app(x[1], x[2]));
+      break;
+    case TermStore::kBTerm:
+      // B x y z = x (y z)
+      set_app(redex, x[0], make_app(x[1], x[2]));
+      break;
+    case TermStore::kCTerm:
+      // C x y z = x z y
+      set_app(redex, make_app(x[0], x[2]), x[1]);
+      break;
+    case TermStore::kSPrimeTerm:
+      // S' c f g x = c (f x) (g x)
+      set_app(redex, make_app(x[0], make_app(x[1], x[3])), make_app(x[2], x[3]));
+      break;
+    case TermStore::kBStarTerm:
+      // B* c f g x = c (f (g x))
+      set_app(redex, x[0], make_app(x[1], make_app(x[2], x[3])));
+      break;
+    case TermStore::kCPrimeTerm:
+      // C' c f g x = c (f x) g
+      set_app(redex, make_app(x[0], make_app(x[1], x[3])), x[2]);
+      break;
+    }
+    current = redex;
+  }
+}
+
+std::optional<uint64_t> GraphReducer::fingerprint(Ref ref) {
+  // Keys with kTermKey set stand for store terms, the others for application and number cells.
+  static constexpr uint64_t kTermKey = uint64_t{1} << 32;
+  auto key_of = [&](Ref child) {
+    child = follow(child);
+    if (is_leaf(child))
+      return kTermKey | leaf_term(child);
+    switch (cells[child].right) {
+    case kUnbuilt:
+      return kTermKey | cells[child].left;
+    case kIncJet:
+      return kTermKey | jets->inc;
+    case kAddJet:
+      return kTermKey | jets->add;
+    }
+    return uint64_t{child};
+  };
+  // A node's hash is known once both of its children's are, as in to_term.
+  fingerprints.clear();
+  size_t visits = 0;
+  std::vector<uint64_t> pending{key_of(ref)};
+  while (!pending.empty()) {
+    uint64_t key = pending.back();
+    if (fingerprints.count(key)) {
+      pending.pop_back();
+      continue;
+    }
+    if (++visits > kFingerprintVisits)
+      return std::nullopt;
+    bool number = !(key & kTermKey) && cells[key].right == kNumber;
+    uint64_t children[2];
+    if (key & kTermKey) {
+      Term term = static_cast<Term>(key);
+      if (term_store.kind(term) != TermKind::kApp) {
+        fingerprints[key] = mix_hash(term);
+        pending.pop_back();
+        continue;
+      }
+      children[0] = kTermKey | term_store.left(term);
+      children[1] = kTermKey | term_store.right(term);
+    } else if (number) {
+      // n stands for inc (inc ... (inc zero)), with n applications.
+      children[0] = kTermKey | jets->inc;
+      children[1] = kTermKey | jets->zero;
+    } else {
+      children[0] = key_of(cells[key].left);
+      children[1] = key_of(cells[key].right);
+    }
+    if (!fingerprints.count(children[0]) || !fingerprints.count(children[1])) {
+      for (uint64_t child : children) {
+        if (!fingerprints.count(child))
+          pending.push_back(child);
+      }
+      continue;
+    }
+    uint64_t left = fingerprints[children[0]];
+    uint64_t hash = fingerprints[children[1]];
+    if (number) {
+      Ref n = cells[key].left;
+      if ((visits += n) > kFingerprintVisits)
+        return std::nullopt;
+      for (Ref i = 0; i < n; i++)
+        hash = app_hash(left, hash);
+    } else {
+      hash = app_hash(left, hash);
+    }
+    fingerprints[key] = hash;
+    pending.pop_back();
+  }
+  return fingerprints[key_of(ref)];
+}
+
+bool GraphReducer::charge_step() {
+  // Cells are never freed, so the graph only grows.
+  ptrdiff_t growth = cells.size() - charged_cells;
+  charged_cells = cells.size();
+  return meter->charge(growth);
+}
+
+// Contracts the redex headed by a jet cell and points current at its root. Returns false if the
+// head is already in weak head normal form.
+bool GraphReducer::contract_jet(Ref head, Ref& current) {
+  size_t args = spine.size();
+  // x[0] is the first argument.
+  Ref x[2] = {args >= 1 ? cells[spine[args - 1]].right : 0,
+              args >= 2 ? cells[spine[args - 2]].right : 0};
+  switch (cells[head].right) {
+  case kNumber: {
+    Ref n = cells[head].left;
+    if (args == 0)
+      return false;
+    if (args == 1) {
+      // 0 f = S K f and n f = S (K f) ((n - 1) f) are both weak head normal.
+      Ref redex = spine[args - 1];
+      if (n == 0)
+        set_app(redex, make_app(kLeaf | TermStore::kSTerm, kLeaf | TermStore::kKTerm), x[0]);
+      else
+        set_app(redex,
+                make_app(kLeaf | TermStore::kSTerm, make_app(kLeaf | TermStore::kKTerm, x[0])),
+                make_app(make_cell(n - 1, kNumber), x[0]));
+      return false;
+    }
+    Ref f = resolve(x[0]);
+    bool inc = !is_leaf(f) && cells[f].right == kIncJet;
+    if (inc && args >= 4) {
+      // n inc m g y = g^n (m g y) = n g (m g y), which skips building the intermediate numeral.
+      Ref redex = spine[args - 4];
+      Ref g = cells[spine[args - 3]].right;
+      Ref y = cells[spine[args - 4]].right;
+      set_app(redex, make_app(head, g), make_app(make_app(x[1], g), y));
+      spine.resize(args - 4);
+      current = redex;
+      return true;
+    }
+    Ref redex = spine[args - 2];
+    Ref m = resolve(x[1]);
+    if (inc && is_number(m) &&
+        cells[m].left <= std::numeric_limits<Ref>::max() - n) {
+      // n inc m = n + m
+      cells[redex] = {n + cells[m].left, kNumber};
+    } else if (n == 0) {
+      // 0 f x = x
+      cells[redex] = {m, kIndirection};
+    } else {
+      // n f x = f ((n - 1) f x)
+      set_app(redex, x[0], make_app(make_app(make_cell(n - 1, kNumber), x[0]), x[1]));
+    }
+    spine.resize(args - 2);
+    current = redex;
+    return true;
+  }
+  case kIncJet: {
+    if (args == 0)
+      return false;
+    Ref redex = spine[args - 1];
+    Ref n = resolve(x[0]);
+    if (is_number(n) && cells[n].left < std::numeric_limits<Ref>::max()) {
+      // inc n = n + 1
+      cells[redex] = {cells[n].left + 1, kNumber};
+    } else {
+      // inc x = S (S (K S) K) x
+      set_app(redex, make_app(kLeaf | TermStore::kSTerm, build(term_store.right(jets->inc))), x[0]);
+    }
+    spine.pop_back();
+    current = redex;
+    return true;
+  }
+  case kAddJet: {
+    // The combinator body, built without recognizing add itself at the root.
+    auto expansion = [&] {
+      return make_app(build(term_store.left(jets->add)), build(term_store.right(jets->add)));
+    };
+    if (args == 0) {
+      current = expansion();
+      cells[head] = {current, kIndirection};
+      return true;
+    }
+    if (args == 1) {
+      Ref redex = spine[args - 1];
+      set_app(redex, expansion(), x[0]);
+      spine.pop_back();
+      current = redex;
+      return true;
+    }
+    Ref redex = spine[args - 2];
+    Ref a = resolve(x[0]);
+    Ref b = resolve(x[1]);
+    if (is_number(a) && is_number(b) &&
+        cells[a].left <= std::numeric_limits<Ref>::max() - cells[b].left) {
+      // add a b = a + b
+      cells[redex] = {cells[a].left + cells[b].left, kNumber};
+    } else {
+      // add a b = a inc b
+      set_app(redex, make_app(x[0], build(jets->inc)), x[1]);
+    }
+    spine.resize(args - 2);
+    current = redex;
+    return true;
+  }
+  }
+  return false;
+}
+
+bool GraphReducer::normalize(Ref ref) {
+  std::vector<Ref> pending{ref};
+  while (!pending.empty()) {
+    Ref current = resolve(pending.back());
+    pending.pop_back();
+    if (is_leaf(current) || normal[current])
+      continue;
+    if (!whnf(current))
+      return false;
+    // The head can no longer be contracted, so the spine is final once its arguments are. Marking
+    // it now keeps shared spines from being scheduled twice.
+    for (current = resolve(current); is_app(current); current = resolve(cells[current].left)) {
+      normal[current] = true;
+      pending.push_back(cells[current].right);
+    }
+  }
+  return true;
+}
+
+size_t GraphReducer::count_nodes() const {
+  std::vector<bool> counted(cells.size());
+  std::unordered_set<Term> counted_terms;
+  size_t count = 0;
+  std::vector<Ref> pending{root};
+  while (!pending.empty()) {
+    Ref current = follow(pending.back());
+    pending.pop_back();
+    if (is_leaf(current)) {
+      count++;
+      continue;
+    }
+    if (counted[current])
+      continue;
+    counted[current] = true;
+    if (cells[current].right == kUnbuilt) {
+      count += term_store.count_nodes(cells[current].left, counted_terms);
+      continue;
+    }
+    count++;
+    if (is_app(current)) {
+      pending.push_back(cells[current].left);
+      pending.push_back(cells[current].right);
+    }
+  }
+  return count;
+}
+
+// Shared cells are converted once across calls through terms; a cell's term is known once both
+// of its children's are.
+Term GraphReducer::to_term(Ref ref, TermStore& store, std::unordered_map<Ref, Term>& terms) const {
+  std::vector<Ref> pending{follow(ref)};
+  while (!pending.empty()) {
+    Ref current = pending.back();
+    if (is_leaf(current)) {
+      pending.pop_back();
+      continue;
+    }
+    if (terms.count(current)) {
+      pending.pop_back();
+      continue;
+    }
+    switch (cells[current].right) {
+    case kNumber: {
+      Term numeral = jets->zero;
+      for (Ref i = 0; i < cells[current].left; i++)
+        numeral = store.app(jets->inc, numeral);
+      terms[current] = numeral;
+      pending.pop_back();
+      continue;
+    }
+    case kIncJet:
+      terms[current] = jets->inc;
+      pending.pop_back();
+      continue;
+    case kAddJet:
+      terms[current] = jets->add;
+      pending.pop_back();
+      continue;
+    case kUnbuilt:
+      terms[current] = cells[current].left;
+      pending.pop_back();
+      continue;
+    }
+    Ref left = follow(cells[current].left);
+    Ref right = follow(cells[current].right);
+    bool left_done = is_leaf(left) || terms.count(left);
+    bool right_done = is_leaf(right) || terms.count(right);
+    if (!left_done)
+      pending.push_back(left);
+    if (!right_done)
+      pending.push_back(right);
+    if (left_done && right_done) {
+      auto term_of = [&](Ref child) { return is_leaf(child) ? leaf_term(child) : terms[child]; };
+      terms[current] = store.app(term_of(left), term_of(right));
+      pending.pop_back();
+    }
+  }
+  ref = follow(ref);
+  return is_leaf(ref) ? leaf_term(ref) : terms[ref];
+}
+
+std::string GraphReducer::to_string(Ref ref, size_t max_length, Parens parens) const {
+  // Either a reference still to print or, when text is set, a literal character. argument tells
+  // whether the reference is the right child of an application.
+  struct Item {
+    Ref ref;
+    char text;
+    bool argument;
+  };
+  std::string output;
+  // Stored terms print their own inner parentheses, but not the ones their position needs.
+  auto print_term = [&](Term term, bool argument) {
+    bool wrap = parens == Parens::kMinimal && argument &&
+                term_store.kind(term) == TermKind::kApp;
+    if (wrap)
+      output += '(';
+    output += term_store.to_string(term, parens);
+    if (wrap)
+      output += ')';
+  };
+  std::vector<Item> pending{{ref, 0, false}};
+  while (!pending.empty()) {
+    if (output.size() >= max_length) {
+      output.resize(max_length);
+      return output + "...";
+    }
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    Ref current = follow(item.ref);
+    if (is_leaf(current)) {
+      output += term_store.to_string(leaf_term(current));
+      continue;
+    }
+    if (is_number(current)) {
+      // n = inc (inc ... (inc 0)). Without all parentheses, only the outermost inc can go
+      // without them, and only if it is not an argument itself.
+      Ref n = cells[current].left;
+      bool wrap_outer = parens == Parens::kAll || item.argument;
+      std::string inc = term_store.to_string(jets->inc, parens) + " ";
+      for (Ref i = 0; i < n && output.size() < max_length; i++) {
+        if (i || wrap_outer)
+          output += '(';
+        output += inc;
+      }
+      if (output.size() >= max_length)
+        continue;
+      print_term(jets->zero, n || item.argument);
+      output.append(n && !wrap_outer ? n - 1 : n, ')');
+      continue;
+    }
+    if (cells[current].right == kIncJet) {
+      print_term(jets->inc, item.argument);
+      continue;
+    }
+    if (cells[current].right == kAddJet) {
+      print_term(jets->add, item.argument);
+      continue;
+    }
+    if (cells[current].right == kUnbuilt) {
+      print_term(cells[current].left, item.argument);
+      continue;
+    }
+    if (parens == Parens::kAll || item.argument) {
+      output += '(';
+      pending.push_back({0, ')', false});
+    }
+    pending.push_back({cells[current].right, 0, true});
+    pending.push_back({0, ' ', false});
+    pending.push_back({cells[current].left, 0, false});
+  }
+  return output;
+}
+
+} // namespace Ski
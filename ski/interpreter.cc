@@ -1,75 +1,800 @@
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 
 #include "interpreter.h"
+#include "tokenizer.h"
+#include "parser.h"
 
 namespace Ski {
 
-Interpreter::Interpreter(std::unique_ptr<Ski> ski_ast) : ski_ast(std::move(ski_ast)) {
-  for (auto& def : this->ski_ast->get_ordered_defs()) {
-    std::unique_ptr<Expr> cloned_expr = this->ski_ast->get_def_map().at(def)->clone();
-    resolved_definitions_map[def] =
-        substitute_identifiers(std::move(cloned_expr), resolved_definitions_map);
+static InterpreterOptions engine_options(Engine engine) {
+  InterpreterOptions options;
+  options.engine = engine;
+  return options;
+}
+
+Interpreter::Interpreter(std::unique_ptr<Ski> ski_ast, Engine engine)
+    : Interpreter(std::move(ski_ast), engine_options(engine)) {}
+
+Interpreter::Interpreter(std::unique_ptr<Ski> ski_ast, const InterpreterOptions& options)
+    : ski_ast(std::move(ski_ast)), options(options), term_store(this->ski_ast->get_symbols()),
+      optimizer(term_store) {
+  // Definitions are only resolved once an expression uses them. A redefinition takes the place of
+  // the last one.
+  auto& ordered_defs = this->ski_ast->get_ordered_defs();
+  definition_positions.assign(this->ski_ast->get_symbols()->size(), kUndefined);
+  for (size_t position = 0; position < ordered_defs.size(); position++)
+    definition_positions[ordered_defs[position]] = position;
+  definition_count = ordered_defs.size();
+  set_up_engine();
+}
+
+Interpreter::Interpreter(const ProgramImage& image, const InterpreterOptions& options)
+    : options(options), optimizer(term_store) {
+  // The image's handles are only valid in a store that holds nothing else yet.
+  image.load(term_store);
+  compiled_exprs = image.get_exprs();
+  compiled_assertions = image.get_assertions();
+  // Positions only matter once the program is extended, and make the image's definitions visible
+  // to the additions.
+  for (auto& [identifier, term] : image.get_definitions()) {
+    Symbol symbol = term_store.get_symbols()->intern(identifier);
+    set_resolved(symbol, term);
+    definition_positions.resize(term_store.get_symbols()->size(), kUndefined);
+    definition_positions[symbol] = definition_count++;
   }
+  set_up_engine();
 }
 
-std::unique_ptr<Expr> Interpreter::substitute_identifiers(
-    std::unique_ptr<Expr> expr,
-    std::unordered_map<std::string, std::unique_ptr<Expr>>& resolved_definitions_map) {
-  if (auto var = dynamic_cast<Var*>(expr.get())) {
-    if (resolved_definitions_map.find(var->get_identifier()) != resolved_definitions_map.end())
-      return resolved_definitions_map[var->get_identifier()]->clone();
-    else
-      return expr->clone();
-  } else if (auto app = dynamic_cast<App*>(expr.get())) {
-    return std::make_unique<App>(
-        substitute_identifiers(app->move_left(), resolved_definitions_map),
-        substitute_identifiers(app->move_right(), resolved_definitions_map));
+std::unordered_map<std::string, Term> Interpreter::get_resolved_definitions_map() const {
+  std::unordered_map<std::string, Term> resolved;
+  for (Symbol symbol = 0; symbol < resolved_definitions.size(); symbol++) {
+    if (is_resolved(symbol))
+      resolved[term_store.get_symbols()->name(symbol)] = resolved_definitions[symbol];
+  }
+  return resolved;
+}
+
+void Interpreter::set_resolved(Symbol symbol, Term term) {
+  if (symbol >= resolved_definitions.size())
+    resolved_definitions.resize(term_store.get_symbols()->size(), kUnresolved);
+  resolved_definitions[symbol] = term;
+}
+
+void Interpreter::set_up_engine() {
+  if (options.engine == Engine::kGraph && options.jets && !options.optimize)
+    resolve_jets();
+  if (options.jobs > 1)
+    pool = std::make_unique<ThreadPool>(options.jobs);
+  else if (options.engine == Engine::kTree && options.subterm_threads > 1)
+    scheduler = std::make_unique<TaskScheduler>(options.subterm_threads);
+  if (options.cache_bytes)
+    cache = std::make_unique<NormalFormCache>(options.cache_bytes);
+  if (options.engine == Engine::kBytecode)
+    bytecode = std::make_unique<BytecodeProgram>(term_store);
+}
+
+void Interpreter::compile(const std::string& path) {
+  // Definitions are resolved in source order, so compiling the same program gives the same image.
+  if (ski_ast) {
+    auto& ordered_defs = ski_ast->get_ordered_defs();
+    size_t first_position = definition_count - ordered_defs.size();
+    for (size_t i = 0; i < ordered_defs.size(); i++) {
+      if (definition_positions[ordered_defs[i]] == first_position + i)
+        resolve_definition(ordered_defs[i]);
+    }
+  }
+  std::unordered_map<std::string, Term> resolved = get_resolved_definitions_map();
+  std::map<std::string, Term> definitions(resolved.begin(), resolved.end());
+  std::vector<Term> exprs = resolve_exprs();
+  write_program_image(path, term_store, exprs, {definitions.begin(), definitions.end()},
+                      resolve_assertions());
+}
+
+// The encodings the graph engine runs natively. Programs that spell them the same way intern to
+// the same terms, whatever they name them.
+static const char* kChurchPrelude = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def inc = S (S (K S) K);
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def _0 = S K;
+)";
+
+void Interpreter::resolve_jets() {
+  // The prelude is interned with the store's symbols, so its variables need no translation.
+  Tokenizer tokenizer(kChurchPrelude, "<church-prelude>", term_store.get_symbols());
+  Parser parser(tokenizer, "<church-prelude>");
+  auto prelude = parser.parse();
+  std::unordered_map<Symbol, Term> prelude_map;
+  auto lookup = [&](Symbol symbol) -> std::optional<Term> {
+    auto it = prelude_map.find(symbol);
+    return it == prelude_map.end() ? std::nullopt : std::optional<Term>(it->second);
+  };
+  for (Symbol def : prelude->get_ordered_defs())
+    prelude_map[def] = term_store.intern(*prelude->get_definition(def), lookup);
+  auto jet = [&](const char* identifier) {
+    return prelude_map.at(*term_store.get_symbols()->find(identifier));
+  };
+  jets = {jet("_0"), jet("inc"), jet("add")};
+}
+
+const ChurchJets* Interpreter::active_jets() const {
+  return options.engine == Engine::kGraph && options.jets && !options.optimize ? &jets : nullptr;
+}
+
+void Interpreter::cache_definition(Term term) {
+  if (cache->is_full())
+    return;
+  GraphReducer reducer(term_store, active_jets(), cache.get());
+  if (reducer.try_normalize(term, options.cache_definition_steps))
+    reducer.record_normal_forms(term_store, *cache);
+  cache->count(reducer.get_cache_hits(), reducer.get_cache_misses());
+}
+
+void Interpreter::add_bytecode_globals() {
+  for (Symbol symbol = 0; symbol < resolved_definitions.size(); symbol++) {
+    if (is_resolved(symbol))
+      bytecode->add_global(resolved_definitions[symbol]);
+  }
+}
+
+Term Interpreter::apply_cache(Term term) {
+  // Replaces the outermost cached subterms by their normal forms. Shared subterms are visited once.
+  std::unordered_map<Term, Term> replaced;
+  size_t hits = 0;
+  size_t misses = 0;
+  std::vector<Term> pending{term};
+  while (!pending.empty()) {
+    Term current = pending.back();
+    if (term_store.kind(current) != TermKind::kApp || replaced.count(current)) {
+      pending.pop_back();
+      continue;
+    }
+    if (std::optional<Term> normal_form = cache->find(current)) {
+      hits++;
+      replaced[current] = *normal_form;
+      pending.pop_back();
+      continue;
+    }
+    Term left = term_store.left(current);
+    Term right = term_store.right(current);
+    bool left_done = term_store.kind(left) != TermKind::kApp || replaced.count(left);
+    bool right_done = term_store.kind(right) != TermKind::kApp || replaced.count(right);
+    if (!left_done)
+      pending.push_back(left);
+    if (!right_done)
+      pending.push_back(right);
+    if (left_done && right_done) {
+      misses++;
+      auto replacement = [&](Term child) {
+        return replaced.count(child) ? replaced.at(child) : child;
+      };
+      replaced[current] = term_store.app(replacement(left), replacement(right));
+      pending.pop_back();
+    }
+  }
+  cache->count(hits, misses);
+  return replaced.count(term) ? replaced.at(term) : term;
+}
+
+Term Interpreter::substitute_identifiers(const Expr& expr) {
+  return term_store.intern(expr, [&](Symbol symbol) -> std::optional<Term> {
+    if (!is_visible(symbol, kUndefined))
+      return std::nullopt;
+    return resolve_definition(symbol);
+  });
+}
+
+bool Interpreter::is_visible(Symbol symbol, size_t position) const {
+  return symbol < definition_positions.size() && definition_positions[symbol] < position;
+}
+
+Term Interpreter::resolve_definition(Symbol symbol) {
+  // Dependencies are resolved before the definitions using them. Resolved definitions are handles
+  // into the term store, so later definitions share the bodies of earlier ones instead of cloning
+  // them. An explicit stack keeps long chains of definitions off the C stack.
+  std::vector<Symbol> pending{symbol};
+  while (!pending.empty()) {
+    Symbol current = pending.back();
+    if (is_resolved(current)) {
+      pending.pop_back();
+      continue;
+    }
+    size_t position = definition_positions[current];
+    const Expr& body = *ski_ast->get_definition(current);
+    size_t resolvable = pending.size();
+    std::vector<const Expr*> exprs{&body};
+    while (!exprs.empty()) {
+      const Expr* expr = exprs.back();
+      exprs.pop_back();
+      if (expr->get_kind() == ExprKind::kApp) {
+        exprs.push_back(static_cast<const App*>(expr)->get_left());
+        exprs.push_back(static_cast<const App*>(expr)->get_right());
+      } else if (expr->get_kind() == ExprKind::kVar) {
+        Symbol name = static_cast<const Var*>(expr)->get_symbol();
+        if (is_visible(name, position) && !is_resolved(name))
+          pending.push_back(name);
+      }
+    }
+    if (pending.size() != resolvable)
+      continue;
+    pending.pop_back();
+    Term resolved = term_store.intern(body, [&](Symbol name) -> std::optional<Term> {
+      if (!is_visible(name, position))
+        return std::nullopt;
+      return resolved_definitions[name];
+    });
+    set_resolved(current, resolved);
+    if (cache)
+      cache_definition(resolved);
   }
-  return expr->clone();
+  return resolved_definitions[symbol];
 }
 
 std::vector<std::string> Interpreter::interpret_exprs() {
-  std::vector<std::string> output;
-  for (auto& expr : ski_ast->get_exprs()) {
-    std::unique_ptr<Expr> cloned_expr = expr->clone();
-    std::unique_ptr<Expr> result =
-        substitute_identifiers(std::move(cloned_expr), resolved_definitions_map);
-    std::unique_ptr<Expr> rewritten_expr = std::move(result);
-    std::string expr_string = "";
-    while (expr_string != static_cast<std::string>(*rewritten_expr)) {
-      expr_string = static_cast<std::string>(*rewritten_expr);
-      rewritten_expr = rewite_expr(std::move(rewritten_expr));
-    }
-    output.push_back(expr_string);
+  std::vector<std::string> output = reduce_exprs(resolve_exprs());
+  check_assertions(resolve_assertions());
+  return output;
+}
+
+void Interpreter::interpret_exprs(std::ostream& output) {
+  reduce_exprs(resolve_exprs(), {}, &output);
+  check_assertions(resolve_assertions());
+}
+
+void Interpreter::check_assertions(const std::vector<ResolvedAssertion>& assertions) {
+  assertion_results.clear();
+  for (const ResolvedAssertion& assertion : assertions) {
+    Term sides[2] = {assertion.left, assertion.right};
+    AssertionResult result{assertion.line, true, EvalStatus::kNormalForm};
+    // The store is hash-consed, so equal sides are the same term and need no reducing.
+    if (sides[0] != sides[1]) {
+      PhaseTimer timer(stats.phase_ns[static_cast<size_t>(Phase::kReduce)]);
+      // Graph and bytecode normal forms are interned, which makes equal ones the same handle. Tree
+      // normal forms carry their hashes already.
+      Term graph_forms[2];
+      std::unique_ptr<Expr> tree_forms[2];
+      if (bytecode)
+        add_bytecode_globals();
+      for (int side = 0; side < 2 && result.status == EvalStatus::kNormalForm; side++) {
+        std::optional<BudgetMeter> meter;
+        if (options.budget.is_limited())
+          meter.emplace(options.budget);
+        BudgetMeter* budget_meter = meter ? &*meter : nullptr;
+        if (options.engine == Engine::kGraph) {
+          GraphReducer reducer(term_store, active_jets());
+          if (reducer.evaluate(sides[side], budget_meter))
+            graph_forms[side] = reducer.normal_form_term(term_store);
+        } else if (options.engine == Engine::kBytecode) {
+          uint32_t address = bytecode->compile(sides[side]);
+          BytecodeVm machine(*bytecode);
+          if (machine.evaluate(address, budget_meter))
+            graph_forms[side] = machine.normal_form_term(term_store);
+        } else {
+          ReductionStats reductions;
+          tree_forms[side] = reduce_tree(sides[side], options.strategy, reductions, budget_meter);
+        }
+        if (meter)
+          result.status = meter->get_status();
+      }
+      if (result.status != EvalStatus::kNormalForm)
+        result.passed = false;
+      else if (options.engine != Engine::kTree)
+        result.passed = graph_forms[0] == graph_forms[1];
+      else
+        result.passed = equal_exprs(*tree_forms[0], *tree_forms[1]);
+    }
+    assertion_results.push_back(result);
+  }
+}
+
+std::vector<Term> Interpreter::resolve_exprs() {
+  PhaseTimer timer(stats.phase_ns[static_cast<size_t>(Phase::kResolve)]);
+  std::vector<Term> source_exprs = compiled_exprs;
+  if (ski_ast) {
+    for (auto& expr : ski_ast->get_exprs())
+      source_exprs.push_back(substitute_identifiers(*expr));
+  }
+  return source_exprs;
+}
+
+std::vector<ResolvedAssertion> Interpreter::resolve_assertions() {
+  std::vector<ResolvedAssertion> assertions = compiled_assertions;
+  for (const ResolvedAssertion& assertion : resolve_source_assertions(0))
+    assertions.push_back(assertion);
+  return assertions;
+}
+
+std::vector<ResolvedAssertion> Interpreter::resolve_source_assertions(size_t first) {
+  PhaseTimer timer(stats.phase_ns[static_cast<size_t>(Phase::kResolve)]);
+  std::vector<ResolvedAssertion> assertions;
+  if (ski_ast) {
+    const auto& source_assertions = ski_ast->get_assertions();
+    for (size_t i = first; i < source_assertions.size(); i++) {
+      assertions.push_back({source_assertions[i]->get_line(),
+                            substitute_identifiers(source_assertions[i]->get_left()),
+                            substitute_identifiers(source_assertions[i]->get_right())});
+    }
+  }
+  return assertions;
+}
+
+std::vector<std::string> Interpreter::extend(std::unique_ptr<Ski> addition) {
+  if (!ski_ast)
+    ski_ast = std::make_unique<Ski>(term_store.get_symbols());
+  // Lazily resolved definitions would see a redefinition that follows them, so they are resolved
+  // against the current ones before anything is redefined.
+  for (Symbol symbol : addition->get_ordered_defs()) {
+    if (is_visible(symbol, kUndefined)) {
+      for (Symbol defined = 0; defined < definition_positions.size(); defined++) {
+        if (is_visible(defined, kUndefined))
+          resolve_definition(defined);
+      }
+      break;
+    }
   }
+  definition_positions.resize(term_store.get_symbols()->size(), kUndefined);
+  for (Symbol symbol : addition->get_ordered_defs()) {
+    definition_positions[symbol] = definition_count++;
+    if (is_resolved(symbol))
+      resolved_definitions[symbol] = kUnresolved;
+  }
+  size_t first_expr = ski_ast->get_exprs().size();
+  size_t first_assertion = ski_ast->get_assertions().size();
+  ski_ast->append(std::move(*addition));
+  std::vector<Term> source_exprs;
+  {
+    PhaseTimer timer(stats.phase_ns[static_cast<size_t>(Phase::kResolve)]);
+    for (size_t i = first_expr; i < ski_ast->get_exprs().size(); i++)
+      source_exprs.push_back(substitute_identifiers(*ski_ast->get_exprs()[i]));
+  }
+  std::vector<std::string> output = reduce_exprs(source_exprs);
+  check_assertions(resolve_source_assertions(first_assertion));
   return output;
 }
 
-std::unique_ptr<Expr> Interpreter::rewite_expr(std::unique_ptr<Expr> expr) {
-  if (auto app = dynamic_cast<App*>(expr.get())) {
-    app->set_left(rewite_expr(std::move(app->move_left())));
-    app->set_right(rewite_expr(std::move(app->move_right())));
-    // I x = x
-    if (dynamic_cast<I*>(app->get_left()))
-      return app->move_right();
-    // K x y = x
-    if (auto app_1 = dynamic_cast<App*>(app->get_left())) {
-      if (dynamic_cast<K*>(app_1->get_left())) {
-        return app_1->move_right();
+// Partial terms of the graph and bytecode engines are cut off at this length, since shared cells
+// are printed once per use and would otherwise undo the node budget.
+static constexpr size_t kPartialFormLength = size_t{1} << 20;
+
+std::vector<std::string> Interpreter::reduce_exprs(const std::vector<Term>& source_exprs,
+                                                   const std::vector<Strategy>& strategies,
+                                                   std::ostream* stream) {
+  // Interning and optimizing grow the term store, so they run up front. Reduction only reads the
+  // store, which lets the expressions be reduced concurrently. Normal forms are added to the cache
+  // afterwards for the same reason.
+  std::vector<Term> resolved_exprs;
+  std::vector<Term> reduced_exprs;
+  for (Term resolved_expr : source_exprs) {
+    if (options.optimize)
+      resolved_expr = optimizer.optimize(resolved_expr);
+    resolved_exprs.push_back(resolved_expr);
+    // The graph engine looks terms up as it builds them instead.
+    if (cache && options.engine != Engine::kGraph)
+      resolved_expr = apply_cache(resolved_expr);
+    reduced_exprs.push_back(resolved_expr);
+  }
+  // Compiling grows the bytecode, so it runs up front as well.
+  std::vector<uint32_t> addresses;
+  if (bytecode) {
+    add_bytecode_globals();
+    for (Term reduced_expr : reduced_exprs)
+      addresses.push_back(bytecode->compile(reduced_expr));
+  }
+  std::vector<std::string> output(resolved_exprs.size());
+  allocation_stats.assign(resolved_exprs.size(), {});
+  reduction_stats.assign(resolved_exprs.size(), {});
+  statuses.assign(resolved_exprs.size(), EvalStatus::kNormalForm);
+  cycles.assign(resolved_exprs.size(), Cycle());
+  // Summed after the expressions are reduced, since several may be reduced at once.
+  std::vector<uint64_t> reduce_ns(resolved_exprs.size());
+  std::vector<uint64_t> print_ns(resolved_exprs.size());
+  // Kept until the normal forms are cached.
+  std::vector<std::unique_ptr<GraphReducer>> reducers(cache ? resolved_exprs.size() : 0);
+  std::vector<std::unique_ptr<BytecodeVm>> machines(cache ? resolved_exprs.size() : 0);
+  std::vector<std::unique_ptr<Expr>> normal_forms(cache ? resolved_exprs.size() : 0);
+  // Streamed normal forms wait for the ones before them, which other threads may still reduce.
+  std::mutex stream_mutex;
+  std::vector<bool> reduced(stream ? resolved_exprs.size() : 0);
+  size_t next_written = 0;
+  auto write_reduced = [&](size_t i) {
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    reduced[i] = true;
+    for (; next_written < reduced.size() && reduced[next_written]; next_written++) {
+      *stream << output[next_written] << '\n';
+      std::string().swap(output[next_written]);
+    }
+    stream->flush();
+  };
+  auto reduce = [&](size_t i) {
+    AllocationStats pool_before = NodePool::get_stats();
+    AllocationStats stats;
+    std::optional<BudgetMeter> meter;
+    if (options.budget.is_limited())
+      meter.emplace(options.budget);
+    BudgetMeter* budget_meter = meter ? &*meter : nullptr;
+    if (options.engine == Engine::kGraph) {
+      auto reducer = std::make_unique<GraphReducer>(term_store, active_jets(), cache.get());
+      {
+        PhaseTimer timer(reduce_ns[i]);
+        reducer->evaluate(reduced_exprs[i], budget_meter);
       }
+      {
+        PhaseTimer timer(print_ns[i]);
+        output[i] = reducer->normal_form(
+            meter && meter->is_exhausted() ? kPartialFormLength : ~size_t{0}, options.parens);
+      }
+      stats = reducer->get_allocation_stats();
+      reduction_stats[i] = reducer->get_stats();
+      if constexpr (kStatsEnabled)
+        reduction_stats[i].final_nodes = reducer->count_nodes();
+      if (cache)
+        reducers[i] = std::move(reducer);
+    } else if (options.engine == Engine::kBytecode) {
+      auto machine = std::make_unique<BytecodeVm>(*bytecode);
+      {
+        PhaseTimer timer(reduce_ns[i]);
+        machine->evaluate(addresses[i], budget_meter);
+      }
+      {
+        PhaseTimer timer(print_ns[i]);
+        output[i] = machine->normal_form(
+            meter && meter->is_exhausted() ? kPartialFormLength : ~size_t{0}, options.parens);
+      }
+      stats = machine->get_allocation_stats();
+      reduction_stats[i] = machine->get_stats();
+      if constexpr (kStatsEnabled)
+        reduction_stats[i].final_nodes = machine->count_nodes();
+      if (cache)
+        machines[i] = std::move(machine);
+    } else {
+      std::unique_ptr<Expr> normal_form;
+      {
+        PhaseTimer timer(reduce_ns[i]);
+        Strategy strategy = i < strategies.size() ? strategies[i] : options.strategy;
+        normal_form = reduce_tree(reduced_exprs[i], strategy, reduction_stats[i], budget_meter);
+      }
+      {
+        PhaseTimer timer(print_ns[i]);
+        print_expr(*normal_form, output[i], options.parens);
+      }
+      if constexpr (kStatsEnabled)
+        reduction_stats[i].final_nodes = normal_form->get_size();
+      if (scheduler) {
+        AllocationStats worker_stats = scheduler->take_worker_allocation_stats();
+        stats.nodes += worker_stats.nodes;
+        stats.bytes += worker_stats.bytes;
+      }
+      if (cache)
+        normal_forms[i] = std::move(normal_form);
     }
-    // S x y z = x z (y z)
-    if (auto app_1 = dynamic_cast<App*>(app->get_left())) {
-      if (auto app_2 = dynamic_cast<App*>(app_1->get_left())) {
-        if (dynamic_cast<S*>(app_2->get_left())) {
-          std::unique_ptr<Expr> x = app_2->move_right();
-          std::unique_ptr<Expr> y = app_1->move_right();
-          std::unique_ptr<Expr> z = app->move_right();
-          std::unique_ptr<Expr> x_z = std::make_unique<App>(std::move(x), std::move(z->clone()));
-          std::unique_ptr<Expr> y_z = std::make_unique<App>(std::move(y), std::move(z));
-          return std::make_unique<App>(std::move(x_z), std::move(y_z));
-        }
+    AllocationStats pool_after = NodePool::get_stats();
+    stats.nodes += pool_after.nodes - pool_before.nodes;
+    stats.bytes += pool_after.bytes - pool_before.bytes;
+    allocation_stats[i] = stats;
+    if (meter) {
+      statuses[i] = meter->get_status();
+      cycles[i] = meter->get_cycle();
+    }
+    if constexpr (kStatsEnabled) {
+      // Leaves take no graph cell, so the final nodes can outnumber the cells built.
+      reduction_stats[i].peak_nodes =
+          std::max(reduction_stats[i].peak_nodes, reduction_stats[i].final_nodes);
+    }
+    if (stream) {
+      PhaseTimer timer(print_ns[i]);
+      write_reduced(i);
+    }
+  };
+  if (pool) {
+    pool->parallel_for(resolved_exprs.size(), reduce);
+  } else {
+    for (size_t i = 0; i < resolved_exprs.size(); i++)
+      reduce(i);
+  }
+  if constexpr (kStatsEnabled) {
+    for (size_t i = 0; i < resolved_exprs.size(); i++) {
+      stats.reductions.add(reduction_stats[i]);
+      stats.exprs++;
+      // Only finished reductions have a normal form to size.
+      if (statuses[i] == EvalStatus::kNormalForm)
+        stats.add_normal_form(reduction_stats[i].final_nodes);
+      stats.phase_ns[static_cast<size_t>(Phase::kReduce)] += reduce_ns[i];
+      stats.phase_ns[static_cast<size_t>(Phase::kPrint)] += print_ns[i];
+    }
+  }
+  for (size_t i = 0; cache && i < resolved_exprs.size(); i++) {
+    // Terms left partially reduced by a budget are no normal forms.
+    bool finished = statuses[i] == EvalStatus::kNormalForm;
+    if (reducers[i]) {
+      cache->count(reducers[i]->get_cache_hits(), reducers[i]->get_cache_misses());
+      if (finished)
+        reducers[i]->record_normal_forms(term_store, *cache);
+      reducers[i].reset();
+    } else if (finished && !cache->is_full()) {
+      // Bytecode normal forms are graphs, tree ones expressions.
+      size_t store_size = term_store.size();
+      Term normal_form = machines[i] ? machines[i]->normal_form_term(term_store)
+                                     : term_store.intern(*normal_forms[i]);
+      cache->count_terms(term_store.size() - store_size);
+      cache->insert(resolved_exprs[i], normal_form);
+      cache->insert(reduced_exprs[i], normal_form);
+    }
+  }
+  return output;
+}
+
+std::unique_ptr<Expr> Interpreter::reduce_tree(Term term, Strategy strategy,
+                                               ReductionStats& reductions,
+                                               BudgetMeter* meter) const {
+  std::unique_ptr<Expr> rewritten_expr = term_store.to_expr(term);
+  if (meter)
+    meter->add_nodes(rewritten_expr->get_size());
+  if constexpr (kStatsEnabled)
+    reductions.peak_nodes = rewritten_expr->get_size();
+  if (strategy == Strategy::kLeftmostOutermost) {
+    std::vector<App*> spine;
+    return normalize_outermost(std::move(rewritten_expr), spine, reductions, meter);
+  }
+  if (strategy == Strategy::kLeftmostInnermost)
+    return normalize_innermost(std::move(rewritten_expr), reductions, meter);
+  // A pass that fires no redex leaves the expression in normal form. Each pass is a function of
+  // the expression alone, so one coming back after a later pass will keep coming back.
+  auto normalize = [&] {
+    CycleDetector cycles;
+    bool detect_cycles = meter && meter->detects_cycles();
+    if (detect_cycles)
+      cycles.visit(rewritten_expr->get_hash(), meter->get_steps());
+    size_t before;
+    do {
+      before = reductions.steps;
+      rewritten_expr = rewite_expr(std::move(rewritten_expr), reductions, meter);
+      if constexpr (kStatsEnabled) {
+        reductions.passes++;
+        reductions.peak_nodes = std::max<size_t>(reductions.peak_nodes, rewritten_expr->get_size());
       }
+      if (detect_cycles && reductions.steps != before &&
+          cycles.visit(rewritten_expr->get_hash(), meter->get_steps()))
+        meter->report_cycle(cycles.get_cycle());
+    } while (reductions.steps != before && !(meter && meter->is_exhausted()));
+  };
+  if (scheduler)
+    scheduler->run(normalize);
+  else
+    normalize();
+  return rewritten_expr;
+}
+
+static std::unique_ptr<Expr> make_app(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
+  return std::make_unique<App>(std::move(left), std::move(right));
+}
+
+static void count_step(ExprKind kind, ReductionStats& reductions) {
+  reductions.steps++;
+  if constexpr (kStatsEnabled)
+    reductions.rule_steps[static_cast<size_t>(kind) - static_cast<size_t>(ExprKind::kS)]++;
+}
+
+// If app applies a combinator to exactly as many arguments as it takes, returns the combinator
+// and fills redex with the applications from app down, so that argument i is the right child of
+// redex[args - 1 - i]. Otherwise returns ExprKind::kApp.
+static ExprKind match_redex(App* app, App* (&redex)[4]) {
+  redex[0] = app;
+  int args = 1;
+  Expr* head = app->get_left();
+  while (head->get_kind() == ExprKind::kApp && args < 4) {
+    redex[args++] = static_cast<App*>(head);
+    head = static_cast<App*>(head)->get_left();
+  }
+  ExprKind kind = head->get_kind();
+  return combinator_arity(kind) == args ? kind : ExprKind::kApp;
+}
+
+// The result of contracting the combinator kind applied to x, with the outermost application
+// built by root and every other one by apply. Inner and left applications are built first, which
+// is the order the leftmost-innermost strategy contracts the redexes they form.
+template <typename Apply, typename Root>
+static std::unique_ptr<Expr> contract(ExprKind kind, std::unique_ptr<Expr> (&x)[4], Apply apply,
+                                      Root root) {
+  switch (kind) {
+  case ExprKind::kI:
+    // I x = x
+  case ExprKind::kK:
+    // K x y = x
+    return std::move(x[0]);
+  case ExprKind::kS: {
+    // S x y z = x z (y z)
+    std::unique_ptr<Expr> z = x[2]->clone();
+    std::unique_ptr<Expr> left = apply(std::move(x[0]), std::move(z));
+    return root(std::move(left), apply(std::move(x[1]), std::move(x[2])));
+  }
+  case ExprKind::kB:
+    // B x y z = x (y z)
+    return root(std::move(x[0]), apply(std::move(x[1]), std::move(x[2])));
+  case ExprKind::kC:
+    // C x y z = x z y
+    return root(apply(std::move(x[0]), std::move(x[2])), std::move(x[1]));
+  case ExprKind::kSPrime: {
+    // S' c f g x = c (f x) (g x)
+    std::unique_ptr<Expr> arg = x[3]->clone();
+    std::unique_ptr<Expr> left = apply(std::move(x[0]), apply(std::move(x[1]), std::move(arg)));
+    return root(std::move(left), apply(std::move(x[2]), std::move(x[3])));
+  }
+  case ExprKind::kBStar:
+    // B* c f g x = c (f (g x))
+    return root(std::move(x[0]),
+                apply(std::move(x[1]), apply(std::move(x[2]), std::move(x[3]))));
+  case ExprKind::kCPrime:
+    // C' c f g x = c (f x) g
+    return root(apply(std::move(x[0]), apply(std::move(x[1]), std::move(x[3]))),
+                std::move(x[2]));
+  default:
+    // Callers only contract combinators.
+    return nullptr;
+  }
+}
+
+// Contracts the redex of kind whose applications, from its root down, are redex[0] to
+// redex[arity - 1]. Returns null, leaving the redex alone, if meter refuses the step.
+template <typename Apply, typename Root>
+static std::unique_ptr<Expr> contract_redex(ExprKind kind, App* const* redex,
+                                            ReductionStats& reductions, BudgetMeter* meter,
+                                            Apply apply, Root root) {
+  int arity = combinator_arity(kind);
+  auto arg_size = [&](int i) {
+    return static_cast<ptrdiff_t>(redex[arity - 1 - i]->get_right()->get_size());
+  };
+  if (meter) {
+    // B, C, B* and C' only rearrange their arguments, dropping the head and one application.
+    ptrdiff_t growth = -2;
+    if (kind == ExprKind::kK)
+      growth = -3 - arg_size(1);
+    else if (kind == ExprKind::kS)
+      growth = arg_size(2) - 1;
+    else if (kind == ExprKind::kSPrime)
+      growth = arg_size(3) - 1;
+    if (!meter->charge(growth))
+      return nullptr;
+  }
+  count_step(kind, reductions);
+  std::unique_ptr<Expr> x[4];
+  for (int i = 0; i < arity; i++)
+    x[i] = redex[arity - 1 - i]->move_right();
+  return contract(kind, x, apply, root);
+}
+
+std::unique_ptr<Expr> Interpreter::rewite_expr(std::unique_ptr<Expr> expr,
+                                               ReductionStats& reductions,
+                                               BudgetMeter* meter) const {
+  if (expr->get_kind() != ExprKind::kApp || (meter && meter->is_exhausted()))
+    return expr;
+  auto app = static_cast<App*>(expr.get());
+  if (scheduler && app->get_left()->get_size() >= options.subterm_threshold &&
+      app->get_right()->get_size() >= options.subterm_threshold) {
+    // Both children are big enough to be worth handing to another thread.
+    std::unique_ptr<Expr> left = app->move_left();
+    std::unique_ptr<Expr> right = app->move_right();
+    ReductionStats left_reductions;
+    ReductionStats right_reductions;
+    scheduler->fork_join([&] { left = rewite_expr(std::move(left), left_reductions, meter); },
+                         [&] { right = rewite_expr(std::move(right), right_reductions, meter); });
+    app->set_left(std::move(left));
+    app->set_right(std::move(right));
+    reductions.add(left_reductions);
+    reductions.add(right_reductions);
+  } else {
+    app->set_left(rewite_expr(std::move(app->move_left()), reductions, meter));
+    app->set_right(rewite_expr(std::move(app->move_right()), reductions, meter));
+  }
+  // Redexes nested in the left child were already contracted, so only a combinator whose arity
+  // matches the whole spine can fire here.
+  App* redex[4];
+  ExprKind kind = match_redex(app, redex);
+  if (kind == ExprKind::kApp)
+    return expr;
+  std::unique_ptr<Expr> contractum =
+      contract_redex(kind, redex, reductions, meter, make_app, make_app);
+  return contractum ? std::move(contractum) : std::move(expr);
+}
+
+std::unique_ptr<Expr> Interpreter::normalize_outermost(std::unique_ptr<Expr> expr,
+                                                       std::vector<App*>& spine,
+                                                       ReductionStats& reductions,
+                                                       BudgetMeter* meter) {
+  // spine holds the applications from expr down to the head, above those of the callers. Only
+  // the size of the topmost is kept up to date while contracting, so the rest are fixed on the
+  // way back up.
+  size_t base = spine.size();
+  // The expression at this level is all that changes until its head is normal. Its hash is
+  // folded up from the lowest application on the spine, the only one whose hash is up to date.
+  CycleDetector cycles;
+  bool detect_cycles = meter && meter->detects_cycles();
+  auto state_hash = [&] {
+    if (spine.size() == base)
+      return expr->get_hash();
+    uint64_t hash = spine.back()->get_hash();
+    for (size_t i = spine.size() - 1; i-- > base;)
+      hash = app_hash(hash, spine[i]->get_right()->get_hash());
+    return hash;
+  };
+  if (detect_cycles)
+    cycles.visit(expr->get_hash(), meter->get_steps());
+  while (true) {
+    Expr* head = spine.size() == base ? expr.get() : spine.back()->get_left();
+    if (head->get_kind() == ExprKind::kApp) {
+      spine.push_back(static_cast<App*>(head));
+      continue;
+    }
+    ExprKind kind = head->get_kind();
+    size_t arity = combinator_arity(kind);
+    if (arity == 0 || spine.size() - base < arity)
+      break;
+    std::unique_ptr<Expr> contractum =
+        contract_redex(kind, &spine[spine.size() - arity], reductions, meter, make_app, make_app);
+    if (!contractum)
+      break;
+    spine.resize(spine.size() - arity);
+    if (spine.size() == base)
+      expr = std::move(contractum);
+    else
+      spine.back()->set_left(std::move(contractum));
+    if (detect_cycles && cycles.visit(state_hash(), meter->get_steps())) {
+      meter->report_cycle(cycles.get_cycle());
+      break;
+    }
+  }
+  // The head is a variable or a combinator short of arguments, so no redex is left above the
+  // arguments, and the leftmost-outermost one is in the first argument not yet normal. After
+  // the meter refused a step this only brings the sizes up to date.
+  while (spine.size() > base) {
+    App* app = spine.back();
+    spine.pop_back();
+    app->set_right(normalize_outermost(app->move_right(), spine, reductions, meter));
+  }
+  return expr;
+}
+
+std::unique_ptr<Expr> Interpreter::normalize_innermost(std::unique_ptr<Expr> expr,
+                                                       ReductionStats& reductions,
+                                                       BudgetMeter* meter) {
+  if (expr->get_kind() != ExprKind::kApp)
+    return expr;
+  auto app = static_cast<App*>(expr.get());
+  app->set_left(normalize_innermost(app->move_left(), reductions, meter));
+  app->set_right(normalize_innermost(app->move_right(), reductions, meter));
+  return contract_innermost(std::move(expr), reductions, meter);
+}
+
+std::unique_ptr<Expr> Interpreter::contract_innermost(std::unique_ptr<Expr> expr,
+                                                      ReductionStats& reductions,
+                                                      BudgetMeter* meter) {
+  // The contractum's applications are built from normal parts, so only they can be redexes. The
+  // inner ones are contracted as they are built, and the root by the next iteration, so a root
+  // that keeps reducing does not grow the C stack.
+  auto apply = [&](std::unique_ptr<Expr> left, std::unique_ptr<Expr> right) {
+    return contract_innermost(make_app(std::move(left), std::move(right)), reductions, meter);
+  };
+  CycleDetector cycles;
+  bool detect_cycles = meter && meter->detects_cycles();
+  if (detect_cycles)
+    cycles.visit(expr->get_hash(), meter->get_steps());
+  while (expr->get_kind() == ExprKind::kApp) {
+    App* redex[4];
+    ExprKind kind = match_redex(static_cast<App*>(expr.get()), redex);
+    if (kind == ExprKind::kApp)
+      break;
+    std::unique_ptr<Expr> contractum =
+        contract_redex(kind, redex, reductions, meter, apply, make_app);
+    if (!contractum)
+      break;
+    expr = std::move(contractum);
+    if (detect_cycles && cycles.visit(expr->get_hash(), meter->get_steps())) {
+      meter->report_cycle(cycles.get_cycle());
+      break;
     }
   }
   return expr;
@@ -0,0 +1,77 @@
+#include <numeric>
+#include <sstream>
+
+#include "interpreter_stats.h"
+
+namespace Ski {
+
+static const char* kRuleNames[kRuleCount] = {"S", "K", "I", "B", "C", "S'", "B*", "C'"};
+static const char* kPhaseNames[kPhaseCount] = {"tokenize", "parse", "resolve", "reduce", "print"};
+
+// The nodes of the smallest and largest normal forms in a bucket.
+static std::string bucket_range(size_t bucket) {
+  size_t low = size_t{1} << bucket;
+  size_t high = (low << 1) - 1;
+  return low == high ? std::to_string(low) : std::to_string(low) + "-" + std::to_string(high);
+}
+
+std::string format_stats(const InterpreterStats& stats) {
+  const ReductionStats& reductions = stats.reductions;
+  std::ostringstream output;
+  output << "time:";
+  for (size_t phase = 0; phase < kPhaseCount; phase++) {
+    output << (phase ? ", " : " ") << kPhaseNames[phase] << " " << stats.phase_ns[phase] / 1e6
+           << " ms";
+  }
+  output << "\nsteps: " << reductions.steps << " (";
+  for (size_t rule = 0; rule < kRuleCount; rule++)
+    output << kRuleNames[rule] << " " << reductions.rule_steps[rule] << ", ";
+  output << "jets " << reductions.jet_steps << ")\n";
+  output << "passes: " << reductions.passes << "\n";
+  output << "nodes: " << reductions.peak_nodes << " peak, " << reductions.final_nodes
+         << " final\n";
+  // Expressions cut off by a budget have no normal form to count.
+  output << "normal forms: "
+         << std::accumulate(stats.normal_form_sizes.begin(), stats.normal_form_sizes.end(),
+                            size_t{0})
+         << " (";
+  bool first = true;
+  for (size_t bucket = 0; bucket < stats.normal_form_sizes.size(); bucket++) {
+    if (!stats.normal_form_sizes[bucket])
+      continue;
+    output << (first ? "" : ", ") << bucket_range(bucket) << " nodes: "
+           << stats.normal_form_sizes[bucket];
+    first = false;
+  }
+  output << ")\n";
+  return output.str();
+}
+
+std::string format_stats_json(const InterpreterStats& stats) {
+  const ReductionStats& reductions = stats.reductions;
+  std::ostringstream output;
+  output << "{\"phase_ns\": {";
+  for (size_t phase = 0; phase < kPhaseCount; phase++)
+    output << (phase ? ", " : "") << "\"" << kPhaseNames[phase] << "\": " << stats.phase_ns[phase];
+  output << "}, \"steps\": " << reductions.steps << ", \"rule_steps\": {";
+  for (size_t rule = 0; rule < kRuleCount; rule++) {
+    output << (rule ? ", " : "") << "\"" << kRuleNames[rule]
+           << "\": " << reductions.rule_steps[rule];
+  }
+  output << "}, \"jet_steps\": " << reductions.jet_steps << ", \"passes\": " << reductions.passes
+         << ", \"peak_nodes\": " << reductions.peak_nodes
+         << ", \"final_nodes\": " << reductions.final_nodes << ", \"exprs\": " << stats.exprs
+         << ", \"normal_form_sizes\": {";
+  bool first = true;
+  for (size_t bucket = 0; bucket < stats.normal_form_sizes.size(); bucket++) {
+    if (!stats.normal_form_sizes[bucket])
+      continue;
+    output << (first ? "" : ", ") << "\"" << bucket_range(bucket)
+           << "\": " << stats.normal_form_sizes[bucket];
+    first = false;
+  }
+  output << "}}";
+  return output.str();
+}
+
+} // namespace Ski
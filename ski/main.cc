@@ -1,40 +1,378 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
 
 #include "tokenizer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "mapped_file.h"
+#include "program_image.h"
+
+// Thread counts above this are rejected rather than spawned.
+static constexpr unsigned long kMaxThreads = 1024;
+
+// Parses the thread count of -j or --subterm-threads, where 0 means one per hardware thread.
+// Returns false unless text is a decimal number of at most kMaxThreads.
+static bool parse_thread_count(const char* text, unsigned& threads) {
+  if (!std::isdigit(static_cast<unsigned char>(*text)))
+    return false;
+  char* end;
+  unsigned long count = std::strtoul(text, &end, 10);
+  if (*end || count > kMaxThreads)
+    return false;
+  threads =
+      count ? static_cast<unsigned>(count) : std::max(1u, std::thread::hardware_concurrency());
+  return true;
+}
+
+static void print_usage() {
+  std::cerr << "Usage: ski [--engine=tree|graph|bytecode] "
+               "[--strategy=full-pass|leftmost-outermost|leftmost-innermost] [--optimize] "
+               "[--no-jets] [-j N] [--subterm-threads=N] [--cache=MiB] [--max-steps=N] "
+               "[--max-nodes=N] [--timeout=MS] [--detect-cycles] [--cache-stats] [--alloc-stats] "
+               "[--minimal-parens] [--stats[=json]] <ski-program-path>\n"
+               "       ski --compile <ski-program-path> -o <image-path>\n"
+               "       ski --repl [options] [<prelude-path>]\n";
+}
+
+// Ctrl-C in a session cancels the statement being evaluated rather than ending the session, which
+// it still does while waiting for input.
+static Ski::CancellationToken interrupt;
+static std::atomic<bool> evaluating{false};
+
+static void on_interrupt(int) {
+  if (!evaluating.load())
+    _exit(130);
+  interrupt.cancel();
+}
+
+// Tells on stderr which expressions of the last call a budget stopped short of their normal form.
+static void report_statuses(const Ski::Interpreter& interpreter) {
+  auto& statuses = interpreter.get_statuses();
+  for (size_t i = 0; i < statuses.size(); i++) {
+    if (statuses[i] == Ski::EvalStatus::kNormalForm)
+      continue;
+    std::cerr << "expr " << i + 1 << ": " << Ski::eval_status_name(statuses[i]) << " after "
+              << interpreter.get_reduction_stats()[i].steps << " steps";
+    if (statuses[i] == Ski::EvalStatus::kCycle) {
+      const Ski::Cycle& cycle = interpreter.get_cycles()[i];
+      std::cerr << ": the term after step " << cycle.start << " came back " << cycle.length
+                << " steps later";
+    }
+    std::cerr << "\n";
+  }
+}
+
+// Tells on stderr which assertions of the last call did not hold, and returns whether all did.
+static bool report_assertions(const Ski::Interpreter& interpreter, const std::string& filename) {
+  bool held = true;
+  for (auto& result : interpreter.get_assertion_results()) {
+    if (result.passed)
+      continue;
+    std::cerr << filename << ":" << result.line << ": assert_eq ";
+    if (result.status == Ski::EvalStatus::kNormalForm)
+      std::cerr << "failed: the normal forms differ\n";
+    else
+      std::cerr << "not decided: " << Ski::eval_status_name(result.status) << "\n";
+    held = false;
+  }
+  return held;
+}
+
+// Whether the definitions and expressions read so far end with a complete statement. Comments
+// and whitespace after the last semicolon do not count.
+static bool is_complete(const std::string& input) {
+  Ski::Tokenizer tokenizer(input, "<stdin>");
+  Ski::Kind last = Ski::Kind::kEnd;
+  try {
+    for (Ski::Token token = tokenizer.next(); token.kind != Ski::Kind::kEnd;
+         token = tokenizer.next())
+      last = token.kind;
+  } catch (const std::runtime_error&) {
+    // Let the parser report it.
+    return true;
+  }
+  return last == Ski::Kind::kSemiColon;
+}
+
+// Whether input holds anything but comments and whitespace.
+static bool has_tokens(const std::string& input) {
+  Ski::Tokenizer tokenizer(input, "<stdin>");
+  try {
+    return tokenizer.next().kind != Ski::Kind::kEnd;
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+}
+
+// Parses the statements of input one at a time and evaluates each, against the definitions of
+// the prelude and of the statements before it. Normal forms go to stdout and the time taken by
+// each expression to stderr.
+static void evaluate_statements(Ski::Interpreter& interpreter, const std::string& input) {
+  Ski::Tokenizer tokenizer(input, "<stdin>", interpreter.get_symbols());
+  Ski::Parser parser(tokenizer, "<stdin>");
+  while (true) {
+    auto start = std::chrono::steady_clock::now();
+    auto statement = parser.parse_statement();
+    if (!statement)
+      break;
+    bool is_query = !statement->get_exprs().empty();
+    interrupt.reset();
+    evaluating = true;
+    auto outputs = interpreter.extend(std::move(statement));
+    evaluating = false;
+    for (auto& output : outputs)
+      std::cout << output << "\n";
+    std::cout << std::flush;
+    report_statuses(interpreter);
+    report_assertions(interpreter, "<stdin>");
+    std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+    if (is_query)
+      std::cerr << "(" << std::fixed << std::setprecision(3) << latency.count() << " ms)\n";
+  }
+}
+
+// Reads statements from stdin until it ends and evaluates each as it is completed. Returns false
+// if stdin ends in the middle of a statement, after the parser has reported what is missing.
+static bool run_session(Ski::Interpreter& interpreter) {
+  bool interactive = isatty(STDIN_FILENO);
+  std::string input;
+  std::string line;
+  while (true) {
+    if (interactive)
+      std::cout << (input.empty() ? "ski> " : "...> ") << std::flush;
+    if (!std::getline(std::cin, line))
+      break;
+    input += line;
+    input += '\n';
+    if (!is_complete(input))
+      continue;
+    evaluate_statements(interpreter, input);
+    input.clear();
+  }
+  if (interactive)
+    std::cout << "\n";
+  if (!has_tokens(input))
+    return true;
+  evaluate_statements(interpreter, input);
+  return false;
+}
 
 int main(int argc, char** argv) {
-  if (argc != 2) {
-    std::cerr << "Usage: ski <ski-program-path>\n";
+  Ski::InterpreterOptions options;
+  bool alloc_stats = false;
+  bool cache_stats = false;
+  enum class StatsFormat { kNone, kHuman, kJson } stats_format = StatsFormat::kNone;
+  bool compile = false;
+  bool repl = false;
+  std::string image_path;
+  std::string ski_prog_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--engine=tree") {
+      options.engine = Ski::Engine::kTree;
+    } else if (arg == "--engine=graph") {
+      options.engine = Ski::Engine::kGraph;
+    } else if (arg == "--engine=bytecode") {
+      options.engine = Ski::Engine::kBytecode;
+    } else if (arg == "--strategy=full-pass") {
+      options.strategy = Ski::Strategy::kFullPass;
+    } else if (arg == "--strategy=leftmost-outermost") {
+      options.strategy = Ski::Strategy::kLeftmostOutermost;
+    } else if (arg == "--strategy=leftmost-innermost") {
+      options.strategy = Ski::Strategy::kLeftmostInnermost;
+    } else if (arg == "--optimize") {
+      options.optimize = true;
+    } else if (arg == "--no-jets") {
+      options.jets = false;
+    } else if (arg == "-j" && i + 1 < argc) {
+      if (!parse_thread_count(argv[++i], options.jobs)) {
+        print_usage();
+        return 1;
+      }
+    } else if (arg.rfind("--subterm-threads=", 0) == 0) {
+      if (!parse_thread_count(arg.c_str() + arg.find('=') + 1, options.subterm_threads)) {
+        print_usage();
+        return 1;
+      }
+    } else if (arg.rfind("--cache=", 0) == 0) {
+      char* end;
+      unsigned long mebibytes = std::strtoul(arg.c_str() + arg.find('=') + 1, &end, 10);
+      if (*end) {
+        print_usage();
+        return 1;
+      }
+      options.cache_bytes = size_t{mebibytes} << 20;
+    } else if (arg.rfind("--max-steps=", 0) == 0) {
+      char* end;
+      options.budget.max_steps = std::strtoull(arg.c_str() + arg.find('=') + 1, &end, 10);
+      if (*end) {
+        print_usage();
+        return 1;
+      }
+    } else if (arg.rfind("--max-nodes=", 0) == 0) {
+      char* end;
+      options.budget.max_nodes = std::strtoull(arg.c_str() + arg.find('=') + 1, &end, 10);
+      if (*end) {
+        print_usage();
+        return 1;
+      }
+    } else if (arg.rfind("--timeout=", 0) == 0) {
+      char* end;
+      unsigned long milliseconds = std::strtoul(arg.c_str() + arg.find('=') + 1, &end, 10);
+      if (*end) {
+        print_usage();
+        return 1;
+      }
+      options.budget.max_time = std::chrono::milliseconds(milliseconds);
+    } else if (arg == "--detect-cycles") {
+      options.budget.detect_cycles = true;
+    } else if (arg == "--minimal-parens") {
+      options.parens = Ski::Parens::kMinimal;
+    } else if (arg == "--cache-stats") {
+      cache_stats = true;
+    } else if (arg == "--alloc-stats") {
+      alloc_stats = true;
+    } else if (arg == "--stats" || arg == "--stats=json") {
+      if (!Ski::kStatsEnabled) {
+        std::cerr << "ski was built without SKI_ENABLE_STATS, so --stats is not available.\n";
+        return 1;
+      }
+      stats_format = arg == "--stats" ? StatsFormat::kHuman : StatsFormat::kJson;
+    } else if (arg == "--compile") {
+      compile = true;
+    } else if (arg == "--repl") {
+      repl = true;
+    } else if (arg == "-o" && i + 1 < argc) {
+      image_path = argv[++i];
+    } else if (ski_prog_path.empty() && arg[0] != '-') {
+      ski_prog_path = arg;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  if ((ski_prog_path.empty() && !repl) || compile != !image_path.empty() || (compile && repl)) {
+    print_usage();
     return 1;
   }
-  std::string ski_prog_path = argv[1];
-  std::filesystem::path path(ski_prog_path);
-  std::string ski_filename = path.filename().string();
 
-  std::ifstream ski_prog_fs(ski_prog_path);
-  if (!ski_prog_fs) {
-    std::cerr << "Failed to open file: " << ski_prog_path << "\n";
-    return 1;
+  if (repl) {
+    options.budget.cancellation = &interrupt;
+    std::signal(SIGINT, on_interrupt);
   }
 
-  std::stringstream buffer;
-  buffer << ski_prog_fs.rdbuf();
+  std::unique_ptr<Ski::Interpreter> interpreter;
+  if (ski_prog_path.empty()) {
+    // A session without a prelude starts from an empty program.
+    interpreter = std::make_unique<Ski::Interpreter>(
+        std::make_unique<Ski::Ski>(std::make_shared<Ski::SymbolTable>()), options);
+  } else if (Ski::ProgramImage::is_image(ski_prog_path)) {
+    // Compiled programs are evaluated straight from the mapped image.
+    try {
+      Ski::ProgramImage image(ski_prog_path);
+      interpreter = std::make_unique<Ski::Interpreter>(image, options);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+  } else {
+    std::filesystem::path path(ski_prog_path);
+    std::string ski_filename = path.filename().string();
+
+    // The source is mapped rather than read, and tokenized as the parser asks for tokens.
+    std::unique_ptr<Ski::MappedFile> ski_prog_file;
+    try {
+      ski_prog_file = std::make_unique<Ski::MappedFile>(ski_prog_path);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+
+    Ski::Tokenizer tokenizer(ski_prog_file->view(), ski_filename);
 
-  Ski::Tokenizer tokenizer(buffer.str(), ski_filename);
+    // Pulling tokens interleaves tokenizing with parsing, so with --stats the source is tokenized
+    // up front instead, which lets the two be timed apart.
+    uint64_t tokenize_ns = 0;
+    uint64_t parse_ns = 0;
+    std::unique_ptr<Ski::Ski> ski_ast;
+    if (stats_format != StatsFormat::kNone) {
+      std::unique_ptr<std::vector<Ski::Token>> tokens;
+      Ski::Token end{Ski::Kind::kEnd, {}, 1, 0};
+      {
+        Ski::PhaseTimer timer(tokenize_ns);
+        tokens = tokenizer.tokenize();
+        // The tokenizer stays at the end, where the pulling parser would report a missing token.
+        if (tokens)
+          end = tokenizer.next();
+      }
+      Ski::PhaseTimer timer(parse_ns);
+      if (tokens) {
+        Ski::Parser parser(std::move(tokens), ski_filename, end);
+        ski_ast = parser.parse();
+      }
+    } else {
+      Ski::Parser parser(tokenizer, ski_filename);
+      ski_ast = parser.parse();
+    }
 
-  Ski::Parser parser(std::move(tokenizer.tokenize()), ski_filename);
-  auto ski_ast = parser.parse();
+    if (!ski_ast && !repl)
+      return 0;
+    if (!ski_ast)
+      ski_ast = std::make_unique<Ski::Ski>(tokenizer.get_symbols());
 
-  if (!ski_ast)
+    interpreter = std::make_unique<Ski::Interpreter>(std::move(ski_ast), options);
+    interpreter->add_phase_time(Ski::Phase::kTokenize, tokenize_ns);
+    interpreter->add_phase_time(Ski::Phase::kParse, parse_ns);
+  }
+
+  if (compile) {
+    try {
+      interpreter->compile(image_path);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
     return 0;
+  }
 
-  Ski::Interpreter interpreter(std::move(ski_ast));
-  auto outputs = interpreter.interpret_exprs();
-  for (auto& output : outputs) {
-    std::cout << output << "\n";
+  // A session evaluates the expressions of its prelude before reading any. Normal forms are
+  // written as they are reached rather than after the last one.
+  evaluating = true;
+  interpreter->interpret_exprs(std::cout);
+  evaluating = false;
+  report_statuses(*interpreter);
+  // A failed assertion of the program fails the run, so that suites can be scripted.
+  bool held =
+      report_assertions(*interpreter, std::filesystem::path(ski_prog_path).filename().string());
+  // So does a session cut off in the middle of a statement.
+  if (repl && !run_session(*interpreter))
+    held = false;
+  if (alloc_stats) {
+    auto& stats = interpreter->get_allocation_stats();
+    for (size_t i = 0; i < stats.size(); i++)
+      std::cerr << "expr " << i + 1 << ": " << stats[i].nodes << " nodes, " << stats[i].bytes
+                << " bytes\n";
+  }
+  if (cache_stats) {
+    Ski::CacheStats stats = interpreter->get_cache_stats();
+    std::cerr << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.entries << " entries, " << stats.bytes << " bytes\n";
   }
+  if (stats_format == StatsFormat::kHuman)
+    std::cerr << Ski::format_stats(interpreter->get_stats());
+  else if (stats_format == StatsFormat::kJson)
+    std::cerr << Ski::format_stats_json(interpreter->get_stats()) << "\n";
+  return held ? 0 : 1;
 }
@@ -0,0 +1,39 @@
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace Ski {
+
+MappedFile::MappedFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open file: " + path);
+  struct stat status;
+  if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+    close(fd);
+    throw std::runtime_error("Failed to open file: " + path);
+  }
+  length = status.st_size;
+  if (length > 0) {
+    mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Failed to map file: " + path);
+    }
+    // Readers scan the file front to back, so the kernel can read ahead and drop pages behind.
+    madvise(mapping, length, MADV_SEQUENTIAL);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (length > 0)
+    munmap(mapping, length);
+}
+
+} // namespace Ski
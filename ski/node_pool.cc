@@ -0,0 +1,98 @@
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "node_pool.h"
+
+namespace Ski {
+
+namespace {
+
+constexpr size_t kGranularity = 16;
+constexpr size_t kSizeClasses = 4; // 16, 32, 48 and 64 bytes
+constexpr size_t kChunkSize = 64 * 1024;
+
+struct FreeNode {
+  FreeNode* next;
+};
+
+// Memory shared by all threads. It is never released, so nodes may outlive the thread that
+// allocated them.
+struct Depot {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<char[]>> chunks;
+  FreeNode* free_lists[kSizeClasses] = {};
+};
+
+Depot& get_depot() {
+  static Depot* depot = new Depot();
+  return *depot;
+}
+
+struct ThreadCache {
+  FreeNode* free_lists[kSizeClasses] = {};
+  AllocationStats stats;
+
+  ~ThreadCache() {
+    // Hand the free lists of an exiting thread over to the depot.
+    Depot& depot = get_depot();
+    std::lock_guard<std::mutex> lock(depot.mutex);
+    for (size_t size_class = 0; size_class < kSizeClasses; size_class++) {
+      while (FreeNode* node = free_lists[size_class]) {
+        free_lists[size_class] = node->next;
+        node->next = depot.free_lists[size_class];
+        depot.free_lists[size_class] = node;
+      }
+    }
+  }
+
+  void refill(size_t size_class) {
+    Depot& depot = get_depot();
+    std::lock_guard<std::mutex> lock(depot.mutex);
+    if (depot.free_lists[size_class]) {
+      free_lists[size_class] = depot.free_lists[size_class];
+      depot.free_lists[size_class] = nullptr;
+      return;
+    }
+    size_t node_size = (size_class + 1) * kGranularity;
+    depot.chunks.push_back(std::make_unique<char[]>(kChunkSize));
+    char* chunk = depot.chunks.back().get();
+    for (size_t offset = 0; offset + node_size <= kChunkSize; offset += node_size) {
+      FreeNode* node = reinterpret_cast<FreeNode*>(chunk + offset);
+      node->next = free_lists[size_class];
+      free_lists[size_class] = node;
+    }
+  }
+};
+
+thread_local ThreadCache thread_cache;
+
+} // namespace
+
+void* NodePool::allocate(size_t size) {
+  thread_cache.stats.nodes++;
+  thread_cache.stats.bytes += size;
+  if (size > kSizeClasses * kGranularity)
+    return ::operator new(size);
+  size_t size_class = (size - 1) / kGranularity;
+  if (!thread_cache.free_lists[size_class])
+    thread_cache.refill(size_class);
+  FreeNode* node = thread_cache.free_lists[size_class];
+  thread_cache.free_lists[size_class] = node->next;
+  return node;
+}
+
+void NodePool::deallocate(void* pointer, size_t size) {
+  if (size > kSizeClasses * kGranularity) {
+    ::operator delete(pointer);
+    return;
+  }
+  size_t size_class = (size - 1) / kGranularity;
+  FreeNode* node = static_cast<FreeNode*>(pointer);
+  node->next = thread_cache.free_lists[size_class];
+  thread_cache.free_lists[size_class] = node;
+}
+
+AllocationStats NodePool::get_stats() { return thread_cache.stats; }
+
+} // namespace Ski
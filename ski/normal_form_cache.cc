@@ -0,0 +1,17 @@
+#include "normal_form_cache.h"
+
+namespace Ski {
+
+bool NormalFormCache::insert(Term term, Term normal_form) {
+  if (is_full())
+    return false;
+  if (term == normal_form)
+    return true;
+  if (normal_forms.emplace(term, normal_form).second) {
+    stats.entries++;
+    stats.bytes += kEntryBytes;
+  }
+  return true;
+}
+
+} // namespace Ski
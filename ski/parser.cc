@@ -5,54 +5,118 @@
 
 namespace Ski {
 
-Parser::Parser(std::unique_ptr<std::vector<Token>> tokens, std::string ski_filename)
-    : tokens(std::move(tokens)), ski_filename(std::move(ski_filename)), token_index(0) {}
+Parser::Parser(std::unique_ptr<std::vector<Token>> tokens, std::string ski_filename,
+               std::optional<Token> end)
+    : tokens(std::move(tokens)), end(end), ski_filename(std::move(ski_filename)), token_index(0),
+      symbols(std::make_shared<SymbolTable>()) {}
+
+Parser::Parser(Tokenizer& tokenizer, std::string ski_filename)
+    : tokenizer(&tokenizer), ski_filename(std::move(ski_filename)), token_index(0),
+      symbols(tokenizer.get_symbols()) {}
 
 std::unique_ptr<Ski> Parser::parse() {
   try {
+    started = true;
+    advance();
     std::vector<std::unique_ptr<Defn>> defns;
     parse_dfns(defns);
     std::vector<std::unique_ptr<Expr>> exprs;
-    parse_exprs(exprs);
-    if (defns.empty() && exprs.empty())
+    std::vector<std::unique_ptr<Assertion>> assertions;
+    parse_exprs(exprs, assertions);
+    if (defns.empty() && exprs.empty() && assertions.empty())
       return nullptr;
-    return std::make_unique<Ski>(std::move(defns), std::move(exprs), std::move(ordered_defs),
-                                 std::move(def_map));
+    return make_ski(std::move(defns), std::move(exprs), std::move(assertions));
   } catch (std::exception& e) {
     std::cout << e.what() << "\n";
     return nullptr;
   }
 }
 
+std::unique_ptr<Ski> Parser::parse_statement() {
+  try {
+    if (!started) {
+      started = true;
+      advance();
+    }
+    if (!has_tokens())
+      return nullptr;
+    std::vector<std::unique_ptr<Defn>> defns;
+    std::vector<std::unique_ptr<Expr>> exprs;
+    std::vector<std::unique_ptr<Assertion>> assertions;
+    if (current_token_kind() == Kind::kDef)
+      add_dfn(parse_dfn(), defns);
+    else if (current_token_kind() == Kind::kAssertEq)
+      assertions.push_back(parse_assertion());
+    else
+      exprs.push_back(parse_expr());
+    read_and_ignore_token(Kind::kSemiColon);
+    return make_ski(std::move(defns), std::move(exprs), std::move(assertions));
+  } catch (std::exception& e) {
+    std::cout << e.what() << "\n";
+    return nullptr;
+  }
+}
+
+std::unique_ptr<Ski> Parser::make_ski(std::vector<std::unique_ptr<Defn>> defns,
+                                      std::vector<std::unique_ptr<Expr>> exprs,
+                                      std::vector<std::unique_ptr<Assertion>> assertions) {
+  auto ski = std::make_unique<Ski>(std::move(defns), std::move(exprs), std::move(assertions),
+                                   std::move(ordered_defs), std::move(definitions), symbols);
+  ordered_defs.clear();
+  definitions.clear();
+  return ski;
+}
+
 void Parser::parse_dfns(std::vector<std::unique_ptr<Defn>>& defns) {
   while (has_tokens() && current_token_kind() == Kind::kDef) {
-    std::unique_ptr<Defn> dfn = parse_dfn();
-    ordered_defs.push_back(dfn->get_identifier());
-    def_map[dfn->get_identifier()] = dfn->get_expr();
-    defns.push_back(std::move(dfn));
+    add_dfn(parse_dfn(), defns);
     read_and_ignore_token(Kind::kSemiColon);
   }
 }
 
+void Parser::add_dfn(std::unique_ptr<Defn> dfn, std::vector<std::unique_ptr<Defn>>& defns) {
+  ordered_defs.push_back(dfn->get_symbol());
+  if (dfn->get_symbol() >= definitions.size())
+    definitions.resize(symbols->size(), nullptr);
+  definitions[dfn->get_symbol()] = dfn->get_expr();
+  defns.push_back(std::move(dfn));
+}
+
 std::unique_ptr<Defn> Parser::parse_dfn() {
   read_and_ignore_token(Kind::kDef);
-  std::string def_idenritifier;
+  // A definition without a name defines the empty identifier, which no expression can refer to.
+  Symbol def_symbol;
   if (current_token_kind() == Kind::kIdentifier) {
-    def_idenritifier = tokens->at(token_index).lexeme;
+    def_symbol = intern_current_identifier();
     read_and_ignore_token(Kind::kIdentifier);
+  } else {
+    def_symbol = symbols->intern("");
   }
   read_and_ignore_token(Kind::kEqual);
   auto expr = parse_expr();
-  return std::make_unique<Defn>(def_idenritifier, std::move(expr));
+  return std::make_unique<Defn>(def_symbol, *symbols, std::move(expr));
 }
 
-void Parser::parse_exprs(std::vector<std::unique_ptr<Expr>>& exprs) {
-  while (has_tokens() && is_subexpr_start()) {
-    exprs.push_back(std::move(parse_expr()));
+void Parser::parse_exprs(std::vector<std::unique_ptr<Expr>>& exprs,
+                         std::vector<std::unique_ptr<Assertion>>& assertions) {
+  while (has_tokens() && (is_subexpr_start() || current_token_kind() == Kind::kAssertEq)) {
+    if (current_token_kind() == Kind::kAssertEq)
+      assertions.push_back(parse_assertion());
+    else
+      exprs.push_back(std::move(parse_expr()));
     read_and_ignore_token(Kind::kSemiColon);
   }
 }
 
+std::unique_ptr<Assertion> Parser::parse_assertion() {
+  int line = current_token.line;
+  read_and_ignore_token(Kind::kAssertEq);
+  // Juxtaposition is application, so each side is a single subexpression.
+  auto left = parse_subexpr();
+  auto right = parse_subexpr();
+  return std::make_unique<Assertion>(std::move(left), std::move(right), line);
+}
+
 std::unique_ptr<Expr> Parser::parse_expr() {
   std::unique_ptr<Expr> expr = parse_subexpr();
   while (is_subexpr_start()) {
@@ -73,73 +137,122 @@ std::unique_ptr<Expr> Parser::parse_subexpr() {
     return read_and_create_ast_node(Kind::kKCombinator);
   case Kind::kICombinator:
     return read_and_create_ast_node(Kind::kICombinator);
+  case Kind::kBCombinator:
+    return read_and_create_ast_node(Kind::kBCombinator);
+  case Kind::kCCombinator:
+    return read_and_create_ast_node(Kind::kCCombinator);
+  case Kind::kSPrimeCombinator:
+    return read_and_create_ast_node(Kind::kSPrimeCombinator);
+  case Kind::kBStarCombinator:
+    return read_and_create_ast_node(Kind::kBStarCombinator);
+  case Kind::kCPrimeCombinator:
+    return read_and_create_ast_node(Kind::kCPrimeCombinator);
   case Kind::kOpenParanthesis:
     read_and_ignore_token(Kind::kOpenParanthesis);
     expr = parse_expr();
     read_and_ignore_token(Kind::kCloseParanthesis);
     return expr;
   default:
-    throw std::runtime_error(ski_filename + ":" + std::to_string(tokens->at(token_index).line) +
-                             ":" + std::to_string(tokens->at(token_index).column) + ": " +
+    throw std::runtime_error(ski_filename + ":" + std::to_string(current_token.line) +
+                             ":" + std::to_string(current_token.column) + ": " +
                              "Invalid token found!");
   }
 }
 
-Kind Parser::current_token_kind() { return tokens->at(token_index).kind; }
+void Parser::advance() {
+  if (tokenizer)
+    current_token = tokenizer->next();
+  else if (tokens && token_index < tokens->size())
+    current_token = tokens->at(token_index++);
+  else if (end)
+    current_token = *end;
+  else
+    current_token = {Kind::kEnd, {}, current_token.line, current_token.column};
+}
+
+Symbol Parser::intern_current_identifier() const {
+  // Materialized tokens may come from any tokenizer, so only pulled ones are interned already.
+  return tokenizer ? current_token.symbol : symbols->intern(current_token.lexeme);
+}
+
+Kind Parser::current_token_kind() { return current_token.kind; }
 
 inline void Parser::read_and_ignore_token(Kind kind) {
-  if (tokens->at(token_index).kind != kind) {
-    throw std::runtime_error(ski_filename + ":" + std::to_string(tokens->at(token_index).line) +
-                             ":" + std::to_string(tokens->at(token_index).column) + ": " +
+  if (current_token.kind != kind) {
+    throw std::runtime_error(ski_filename + ":" + std::to_string(current_token.line) +
+                             ":" + std::to_string(current_token.column) + ": " +
                              "Expected: '" + kind_to_name[kind] + "'");
   }
-  token_index++;
+  advance();
 }
 
 std::unique_ptr<Expr> Parser::read_and_create_ast_node(Kind kind) {
-  auto curr_token = tokens->at(token_index);
-  if (tokens->at(token_index).kind != kind) {
-    throw std::runtime_error(ski_filename + ":" + std::to_string(tokens->at(token_index).line) +
-                             ":" + std::to_string(tokens->at(token_index).column) + ": " +
+  if (current_token.kind != kind) {
+    throw std::runtime_error(ski_filename + ":" + std::to_string(current_token.line) +
+                             ":" + std::to_string(current_token.column) + ": " +
                              "Expected: '" + kind_to_name[kind] + "'");
   }
-  token_index++;
+  Symbol symbol = kind == Kind::kIdentifier ? intern_current_identifier() : 0;
+  advance();
   switch (kind) {
   case Kind::kIdentifier:
-    return std::make_unique<Var>(curr_token.lexeme);
+    return std::make_unique<Var>(symbol, *symbols);
   case Kind::kSCombinator:
     return std::make_unique<S>();
   case Kind::kKCombinator:
     return std::make_unique<K>();
   case Kind::kICombinator:
     return std::make_unique<I>();
+  case Kind::kBCombinator:
+    return std::make_unique<B>();
+  case Kind::kCCombinator:
+    return std::make_unique<C>();
+  case Kind::kSPrimeCombinator:
+    return std::make_unique<SPrime>();
+  case Kind::kBStarCombinator:
+    return std::make_unique<BStar>();
+  case Kind::kCPrimeCombinator:
+    return std::make_unique<CPrime>();
   default:
-    throw std::runtime_error(ski_filename + ":" + std::to_string(tokens->at(token_index).line) +
-                             ":" + std::to_string(tokens->at(token_index).column) + ": " +
+    throw std::runtime_error(ski_filename + ":" + std::to_string(current_token.line) +
+                             ":" + std::to_string(current_token.column) + ": " +
                              "Invalid token found!");
   }
 }
 
-inline bool Parser::has_tokens() {
-  if (token_index < tokens->size()) {
-    return true;
-  }
-  return false;
-}
+inline bool Parser::has_tokens() { return current_token.kind != Kind::kEnd; }
 
 inline bool Parser::is_subexpr_start() {
-  return current_token_kind() == Kind::kIdentifier || current_token_kind() == Kind::kSCombinator ||
-         current_token_kind() == Kind::kKCombinator || current_token_kind() == Kind::kICombinator ||
-         current_token_kind() == Kind::kOpenParanthesis;
+  switch (current_token_kind()) {
+  case Kind::kIdentifier:
+  case Kind::kSCombinator:
+  case Kind::kKCombinator:
+  case Kind::kICombinator:
+  case Kind::kBCombinator:
+  case Kind::kCCombinator:
+  case Kind::kSPrimeCombinator:
+  case Kind::kBStarCombinator:
+  case Kind::kCPrimeCombinator:
+  case Kind::kOpenParanthesis:
+    return true;
+  default:
+    return false;
+  }
 }
 
 std::unordered_map<Kind, std::string> Parser::kind_to_name = {{Kind::kIdentifier, "identifier"},
                                                               {Kind::kSCombinator, "S"},
                                                               {Kind::kKCombinator, "K"},
                                                               {Kind::kICombinator, "I"},
+                                                              {Kind::kBCombinator, "B"},
+                                                              {Kind::kCCombinator, "C"},
+                                                              {Kind::kSPrimeCombinator, "S'"},
+                                                              {Kind::kBStarCombinator, "B*"},
+                                                              {Kind::kCPrimeCombinator, "C'"},
                                                               {Kind::kOpenParanthesis, "("},
                                                               {Kind::kCloseParanthesis, ")"},
                                                               {Kind::kDef, "def"},
+                                                              {Kind::kAssertEq, "assert_eq"},
                                                               {Kind::kSemiColon, ";"},
                                                               {Kind::kEqual, "="}};
 
@@ -0,0 +1,190 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "program_image.h"
+
+namespace Ski {
+
+static constexpr char kMagic[4] = {'S', 'K', 'I', 'C'};
+static constexpr uint32_t kVersion = 2;
+
+void write_program_image(const std::string& path, const TermStore& term_store,
+                         const std::vector<Term>& exprs,
+                         const std::vector<std::pair<std::string, Term>>& definitions,
+                         const std::vector<ResolvedAssertion>& assertions) {
+  // Variables and definitions name their identifier by its offset, so each is stored once.
+  std::string identifiers;
+  std::unordered_map<std::string, uint32_t> identifier_offsets;
+  auto identifier_offset = [&](const std::string& identifier) {
+    auto [it, inserted] = identifier_offsets.emplace(identifier, identifiers.size());
+    if (inserted)
+      identifiers.append(identifier).push_back('\0');
+    return it->second;
+  };
+  std::vector<ProgramImageNode> nodes(term_store.size());
+  for (Term term = 0; term < term_store.size(); term++) {
+    TermKind kind = term_store.kind(term);
+    nodes[term] = {static_cast<uint32_t>(kind), 0, 0};
+    if (kind == TermKind::kApp)
+      nodes[term] = {nodes[term].kind, term_store.left(term), term_store.right(term)};
+    else if (kind == TermKind::kVar)
+      nodes[term].left = identifier_offset(term_store.identifier(term));
+  }
+  std::vector<ProgramImageDefinition> image_definitions;
+  for (auto& [identifier, term] : definitions)
+    image_definitions.push_back({identifier_offset(identifier), term});
+  std::vector<ProgramImageAssertion> image_assertions;
+  for (const ResolvedAssertion& assertion : assertions) {
+    image_assertions.push_back(
+        {static_cast<uint32_t>(assertion.line), assertion.left, assertion.right});
+  }
+  identifiers.resize((identifiers.size() + 3) / 4 * 4, '\0');
+
+  ProgramImageHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.node_count = nodes.size();
+  header.expr_count = exprs.size();
+  header.definition_count = image_definitions.size();
+  header.assertion_count = image_assertions.size();
+  header.identifier_bytes = identifiers.size();
+
+  std::ofstream image(path, std::ios::binary | std::ios::trunc);
+  image.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  image.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(nodes[0]));
+  image.write(reinterpret_cast<const char*>(exprs.data()), exprs.size() * sizeof(exprs[0]));
+  image.write(reinterpret_cast<const char*>(image_definitions.data()),
+              image_definitions.size() * sizeof(image_definitions[0]));
+  image.write(reinterpret_cast<const char*>(image_assertions.data()),
+              image_assertions.size() * sizeof(image_assertions[0]));
+  image.write(identifiers.data(), identifiers.size());
+  if (!image)
+    throw std::runtime_error(path + ": Failed to write program image!");
+}
+
+ProgramImage::ProgramImage(const std::string& path) : path(path), file(path) {
+  if (file.size() < sizeof(ProgramImageHeader))
+    throw std::runtime_error(path + ": Truncated program image!");
+  validate();
+}
+
+bool ProgramImage::is_image(const std::string& path) {
+  char magic[sizeof(kMagic)] = {};
+  std::ifstream image(path, std::ios::binary);
+  image.read(magic, sizeof(magic));
+  return image && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+void ProgramImage::validate() const {
+  auto fail = [&](const char* reason) {
+    throw std::runtime_error(path + ": " + reason);
+  };
+  const ProgramImageHeader& image = header();
+  if (std::memcmp(image.magic, kMagic, sizeof(kMagic)) != 0)
+    fail("Not a program image!");
+  if (image.version != kVersion)
+    fail("Unsupported program image version!");
+  size_t expected = sizeof(ProgramImageHeader) + image.node_count * sizeof(ProgramImageNode) +
+                    size_t{image.expr_count} * sizeof(uint32_t) +
+                    image.definition_count * sizeof(ProgramImageDefinition) +
+                    image.assertion_count * sizeof(ProgramImageAssertion) +
+                    image.identifier_bytes;
+  if (file.size() != expected)
+    fail("Truncated program image!");
+  // Every handle must point at a term stored before it, and every identifier must end in the
+  // identifier section.
+  const char* names = identifiers();
+  auto is_identifier = [&](uint32_t offset) {
+    return offset < image.identifier_bytes &&
+           std::memchr(names + offset, '\0', image.identifier_bytes - offset);
+  };
+  for (uint32_t term = 0; term < image.node_count; term++) {
+    const ProgramImageNode& node = nodes()[term];
+    if (node.kind > static_cast<uint32_t>(TermKind::kApp) ||
+        (node.kind == static_cast<uint32_t>(TermKind::kApp) &&
+         (node.left >= term || node.right >= term)) ||
+        (node.kind == static_cast<uint32_t>(TermKind::kVar) && !is_identifier(node.left)))
+      fail("Corrupt program image!");
+  }
+  for (uint32_t i = 0; i < image.expr_count; i++) {
+    if (exprs()[i] >= image.node_count)
+      fail("Corrupt program image!");
+  }
+  for (uint32_t i = 0; i < image.definition_count; i++) {
+    if (definitions()[i].term >= image.node_count || !is_identifier(definitions()[i].identifier))
+      fail("Corrupt program image!");
+  }
+  for (uint32_t i = 0; i < image.assertion_count; i++) {
+    if (assertions()[i].left >= image.node_count || assertions()[i].right >= image.node_count)
+      fail("Corrupt program image!");
+  }
+}
+
+const ProgramImageNode* ProgramImage::nodes() const {
+  return reinterpret_cast<const ProgramImageNode*>(file.data() + sizeof(ProgramImageHeader));
+}
+
+const uint32_t* ProgramImage::exprs() const {
+  return reinterpret_cast<const uint32_t*>(nodes() + header().node_count);
+}
+
+const ProgramImageDefinition* ProgramImage::definitions() const {
+  return reinterpret_cast<const ProgramImageDefinition*>(exprs() + header().expr_count);
+}
+
+const ProgramImageAssertion* ProgramImage::assertions() const {
+  return reinterpret_cast<const ProgramImageAssertion*>(definitions() +
+                                                        header().definition_count);
+}
+
+const char* ProgramImage::identifiers() const {
+  return reinterpret_cast<const char*>(assertions() + header().assertion_count);
+}
+
+void ProgramImage::load(TermStore& term_store) const {
+  // The image holds every term once, in store order, so appending them hands out the same handles.
+  // Variables still go through var, which keeps their identifiers unique.
+  const ProgramImageNode* image_nodes = nodes();
+  uint32_t node_count = header().node_count;
+  term_store.reserve(node_count);
+  for (uint32_t term = 0; term < node_count; term++) {
+    TermKind kind = static_cast<TermKind>(image_nodes[term].kind);
+    Term loaded;
+    if (term < term_store.size())
+      loaded = term_store.kind(term) == kind ? term : ~0u;
+    else if (kind == TermKind::kApp)
+      loaded = term_store.append_app(image_nodes[term].left, image_nodes[term].right);
+    else if (kind == TermKind::kVar)
+      loaded = term_store.var(identifiers() + image_nodes[term].left);
+    else
+      loaded = ~0u;
+    if (loaded != term)
+      throw std::runtime_error(path + ": Corrupt program image!");
+  }
+}
+
+std::vector<Term> ProgramImage::get_exprs() const {
+  return std::vector<Term>(exprs(), exprs() + header().expr_count);
+}
+
+std::vector<std::pair<std::string, Term>> ProgramImage::get_definitions() const {
+  std::vector<std::pair<std::string, Term>> image_definitions;
+  for (uint32_t i = 0; i < header().definition_count; i++)
+    image_definitions.push_back({identifiers() + definitions()[i].identifier,
+                                 definitions()[i].term});
+  return image_definitions;
+}
+
+std::vector<ResolvedAssertion> ProgramImage::get_assertions() const {
+  std::vector<ResolvedAssertion> image_assertions;
+  for (uint32_t i = 0; i < header().assertion_count; i++) {
+    const ProgramImageAssertion& assertion = assertions()[i];
+    image_assertions.push_back(
+        {static_cast<int>(assertion.line), assertion.left, assertion.right});
+  }
+  return image_assertions;
+}
+
+} // namespace Ski
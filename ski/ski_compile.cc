@@ -0,0 +1,67 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "mapped_file.h"
+#include "aot_compiler.h"
+
+static void print_usage() {
+  std::cerr << "Usage: ski-compile [--library] [--symbol=NAME] <ski-program-path> -o <cpp-path>\n";
+}
+
+int main(int argc, char** argv) {
+  Ski::AotOptions options;
+  std::string ski_prog_path;
+  std::string cpp_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--library") {
+      options.library = true;
+    } else if (arg.rfind("--symbol=", 0) == 0) {
+      options.symbol = arg.substr(arg.find('=') + 1);
+    } else if (arg == "-o" && i + 1 < argc) {
+      cpp_path = argv[++i];
+    } else if (ski_prog_path.empty() && arg[0] != '-') {
+      ski_prog_path = arg;
+    } else {
+      print_usage();
+      return 1;
+    }
+  }
+  if (ski_prog_path.empty() || cpp_path.empty() || options.symbol.empty()) {
+    print_usage();
+    return 1;
+  }
+
+  std::string ski_filename = std::filesystem::path(ski_prog_path).filename().string();
+  std::unique_ptr<Ski::MappedFile> ski_prog_file;
+  try {
+    ski_prog_file = std::make_unique<Ski::MappedFile>(ski_prog_path);
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  Ski::Tokenizer tokenizer(ski_prog_file->view(), ski_filename);
+  Ski::Parser parser(tokenizer, ski_filename);
+  std::unique_ptr<Ski::Ski> ski_ast = parser.parse();
+  // The parser has reported why.
+  if (!ski_ast)
+    return 1;
+
+  Ski::Interpreter interpreter(std::move(ski_ast));
+  Ski::AotCompiler compiler(interpreter.get_term_store(), options);
+  compiler.add_program(interpreter);
+  std::ofstream output(cpp_path);
+  compiler.emit(output, ski_filename);
+  output.close();
+  if (!output) {
+    std::cerr << "Cannot write " << cpp_path << "\n";
+    return 1;
+  }
+  return 0;
+}
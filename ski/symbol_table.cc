@@ -0,0 +1,22 @@
+#include "symbol_table.h"
+
+namespace Ski {
+
+Symbol SymbolTable::intern(std::string_view identifier) {
+  auto it = symbols.find(identifier);
+  if (it != symbols.end())
+    return it->second;
+  Symbol symbol = names.size();
+  names.emplace_back(identifier);
+  symbols.emplace(names.back(), symbol);
+  return symbol;
+}
+
+std::optional<Symbol> SymbolTable::find(std::string_view identifier) const {
+  auto it = symbols.find(identifier);
+  if (it == symbols.end())
+    return std::nullopt;
+  return it->second;
+}
+
+} // namespace Ski
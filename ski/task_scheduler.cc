@@ -0,0 +1,152 @@
+#include <algorithm>
+
+#include "task_scheduler.h"
+
+namespace Ski {
+
+namespace {
+
+// The scheduler and worker slot of the calling thread, if it is one of the workers.
+thread_local TaskScheduler* current_scheduler = nullptr;
+thread_local unsigned current_worker = 0;
+
+} // namespace
+
+TaskScheduler::TaskScheduler(unsigned threads) {
+  for (unsigned i = 0; i < std::max(threads, 1u); i++)
+    workers.push_back(std::make_unique<Worker>());
+  for (unsigned i = 1; i < workers.size(); i++)
+    this->threads.emplace_back(&TaskScheduler::work, this, i);
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& thread : threads)
+    thread.join();
+}
+
+void TaskScheduler::run(const std::function<void()>& root) {
+  std::lock_guard<std::mutex> lock(run_mutex);
+  TaskScheduler* outer_scheduler = current_scheduler;
+  unsigned outer_worker = current_worker;
+  current_scheduler = this;
+  current_worker = 0;
+  try {
+    root();
+  } catch (...) {
+    current_scheduler = outer_scheduler;
+    current_worker = outer_worker;
+    throw;
+  }
+  current_scheduler = outer_scheduler;
+  current_worker = outer_worker;
+}
+
+void TaskScheduler::fork_join(const std::function<void()>& first,
+                              const std::function<void()>& second) {
+  if (current_scheduler != this || workers.size() == 1) {
+    first();
+    second();
+    return;
+  }
+  Worker& self = *workers[current_worker];
+  Task task{&first, {}, {}};
+  {
+    std::lock_guard<std::mutex> lock(self.mutex);
+    self.tasks.push_back(&task);
+  }
+  queued++;
+  if (sleeping > 0) {
+    // Taking the lock orders this notification after a sleeper has checked queued.
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    wake.notify_one();
+  }
+
+  std::exception_ptr error;
+  try {
+    second();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  bool stolen;
+  {
+    std::lock_guard<std::mutex> lock(self.mutex);
+    stolen = self.tasks.empty() || self.tasks.back() != &task;
+    if (!stolen)
+      self.tasks.pop_back();
+  }
+  if (!stolen) {
+    queued--;
+    execute(&task);
+  }
+  while (!task.done.load(std::memory_order_acquire)) {
+    if (Task* other = steal(current_worker))
+      execute(other);
+    else
+      std::this_thread::yield();
+  }
+  if (error)
+    std::rethrow_exception(error);
+  if (task.error)
+    std::rethrow_exception(task.error);
+}
+
+AllocationStats TaskScheduler::take_worker_allocation_stats() {
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  AllocationStats stats = worker_stats;
+  worker_stats = {};
+  return stats;
+}
+
+void TaskScheduler::work(unsigned index) {
+  current_scheduler = this;
+  current_worker = index;
+  while (true) {
+    if (Task* task = steal(index)) {
+      // Tasks stolen while joining run nested in this one, so they are counted here too.
+      AllocationStats before = NodePool::get_stats();
+      execute(task);
+      AllocationStats after = NodePool::get_stats();
+      std::lock_guard<std::mutex> lock(stats_mutex);
+      worker_stats.nodes += after.nodes - before.nodes;
+      worker_stats.bytes += after.bytes - before.bytes;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    sleeping++;
+    wake.wait(lock, [&] { return stopping || queued > 0; });
+    sleeping--;
+    if (stopping)
+      return;
+  }
+}
+
+TaskScheduler::Task* TaskScheduler::steal(unsigned thief) {
+  for (unsigned offset = 1; offset < workers.size() && queued > 0; offset++) {
+    Worker& victim = *workers[(thief + offset) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty())
+      continue;
+    Task* task = victim.tasks.front();
+    victim.tasks.pop_front();
+    queued--;
+    return task;
+  }
+  return nullptr;
+}
+
+void TaskScheduler::execute(Task* task) {
+  try {
+    (*task->body)();
+  } catch (...) {
+    task->error = std::current_exception();
+  }
+  task->done.store(true, std::memory_order_release);
+}
+
+} // namespace Ski
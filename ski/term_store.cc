@@ -0,0 +1,293 @@
+#include <algorithm>
+
+#include "term_store.h"
+
+namespace Ski {
+
+TermStore::TermStore() : TermStore(std::make_shared<SymbolTable>()) {}
+
+TermStore::TermStore(std::shared_ptr<SymbolTable> symbols) : symbols(std::move(symbols)) {
+  nodes.push_back({TermKind::kS, 0, 0});
+  nodes.push_back({TermKind::kK, 0, 0});
+  nodes.push_back({TermKind::kI, 0, 0});
+  nodes.push_back({TermKind::kB, 0, 0});
+  nodes.push_back({TermKind::kC, 0, 0});
+  nodes.push_back({TermKind::kSPrime, 0, 0});
+  nodes.push_back({TermKind::kBStar, 0, 0});
+  nodes.push_back({TermKind::kCPrime, 0, 0});
+  app_slot_bits = 10;
+  app_slots.assign(size_t{1} << app_slot_bits, kEmptySlot);
+}
+
+void TermStore::reserve(size_t terms) { nodes.reserve(terms); }
+
+Term TermStore::append_app(Term left, Term right) {
+  nodes.push_back({TermKind::kApp, left, right});
+  return nodes.size() - 1;
+}
+
+Term TermStore::var(Symbol symbol) {
+  if (symbol >= var_terms.size())
+    var_terms.resize(std::max<size_t>(symbol + 1, symbols->size()), kEmptySlot);
+  if (var_terms[symbol] == kEmptySlot) {
+    var_terms[symbol] = nodes.size();
+    nodes.push_back({TermKind::kVar, symbol, 0});
+  }
+  return var_terms[symbol];
+}
+
+Term TermStore::app(Term left, Term right) {
+  if (indexed_terms < nodes.size()) {
+    for (Term term = indexed_terms; term < nodes.size(); term++) {
+      if (nodes[term].kind == TermKind::kApp)
+        index_app(term);
+    }
+    indexed_terms = nodes.size();
+  }
+  size_t mask = app_slots.size() - 1;
+  size_t slot = app_slot(left, right);
+  for (; app_slots[slot] != kEmptySlot; slot = (slot + 1) & mask) {
+    const Node& node = nodes[app_slots[slot]];
+    if (node.left == left && node.right == right)
+      return app_slots[slot];
+  }
+  Term term = nodes.size();
+  nodes.push_back({TermKind::kApp, left, right});
+  index_app(term);
+  indexed_terms = nodes.size();
+  return term;
+}
+
+size_t TermStore::app_slot(Term left, Term right) const {
+  uint64_t key = (static_cast<uint64_t>(left) << 32) | right;
+  // Fibonacci hashing spreads the neighbouring handles of fresh terms over the table.
+  return (key * 0x9E3779B97F4A7C15ull) >> (64 - app_slot_bits);
+}
+
+void TermStore::index_app(Term term) {
+  // Linear probing stays short while at most half of the slots are taken.
+  if (2 * (app_count + 1) > app_slots.size()) {
+    std::vector<Term> slots(2 * app_slots.size(), kEmptySlot);
+    std::swap(slots, app_slots);
+    app_slot_bits++;
+    app_count = 0;
+    for (Term indexed : slots) {
+      if (indexed != kEmptySlot)
+        index_app(indexed);
+    }
+  }
+  size_t mask = app_slots.size() - 1;
+  size_t slot = app_slot(nodes[term].left, nodes[term].right);
+  while (app_slots[slot] != kEmptySlot)
+    slot = (slot + 1) & mask;
+  app_slots[slot] = term;
+  app_count++;
+}
+
+Term TermStore::intern(const Expr& expr,
+                       const std::unordered_map<std::string, Term>* substitutions) {
+  return intern(expr, [&](Symbol symbol) -> std::optional<Term> {
+    if (substitutions) {
+      auto it = substitutions->find(symbols->name(symbol));
+      if (it != substitutions->end())
+        return it->second;
+    }
+    return std::nullopt;
+  });
+}
+
+Term TermStore::intern(const Expr& expr, const std::function<std::optional<Term>(Symbol)>& lookup) {
+  // Post-order walk with explicit stacks, since parsed application chains can be very deep.
+  std::vector<std::pair<const Expr*, bool>> pending{{&expr, false}};
+  std::vector<Term> results;
+  while (!pending.empty()) {
+    auto [current, expanded] = pending.back();
+    pending.pop_back();
+    switch (current->get_kind()) {
+    case ExprKind::kVar: {
+      // Variables parsed with another table are interned again by name.
+      auto variable = static_cast<const Var*>(current);
+      Symbol symbol = &variable->get_symbols() == symbols.get()
+                          ? variable->get_symbol()
+                          : symbols->intern(variable->get_identifier());
+      std::optional<Term> substitute = lookup(symbol);
+      results.push_back(substitute ? *substitute : var(symbol));
+      break;
+    }
+    case ExprKind::kApp: {
+      auto app = static_cast<const App*>(current);
+      if (!expanded) {
+        pending.push_back({current, true});
+        pending.push_back({app->get_right(), false});
+        pending.push_back({app->get_left(), false});
+        break;
+      }
+      Term right = results.back();
+      results.pop_back();
+      Term left = results.back();
+      results.pop_back();
+      results.push_back(this->app(left, right));
+      break;
+    }
+    case ExprKind::kS:
+      results.push_back(s());
+      break;
+    case ExprKind::kK:
+      results.push_back(k());
+      break;
+    case ExprKind::kI:
+      results.push_back(i());
+      break;
+    case ExprKind::kB:
+      results.push_back(b());
+      break;
+    case ExprKind::kC:
+      results.push_back(c());
+      break;
+    case ExprKind::kSPrime:
+      results.push_back(s_prime());
+      break;
+    case ExprKind::kBStar:
+      results.push_back(b_star());
+      break;
+    case ExprKind::kCPrime:
+      results.push_back(c_prime());
+      break;
+    }
+  }
+  return results.back();
+}
+
+std::unique_ptr<Expr> TermStore::to_expr(Term term) const {
+  // Post-order walk with explicit stacks, like intern, since terms can be very deep.
+  std::vector<std::pair<Term, bool>> pending{{term, false}};
+  std::vector<std::unique_ptr<Expr>> results;
+  while (!pending.empty()) {
+    auto [current, expanded] = pending.back();
+    pending.pop_back();
+    switch (kind(current)) {
+    case TermKind::kS:
+      results.push_back(std::make_unique<S>());
+      break;
+    case TermKind::kK:
+      results.push_back(std::make_unique<K>());
+      break;
+    case TermKind::kI:
+      results.push_back(std::make_unique<I>());
+      break;
+    case TermKind::kB:
+      results.push_back(std::make_unique<B>());
+      break;
+    case TermKind::kC:
+      results.push_back(std::make_unique<C>());
+      break;
+    case TermKind::kSPrime:
+      results.push_back(std::make_unique<SPrime>());
+      break;
+    case TermKind::kBStar:
+      results.push_back(std::make_unique<BStar>());
+      break;
+    case TermKind::kCPrime:
+      results.push_back(std::make_unique<CPrime>());
+      break;
+    case TermKind::kVar:
+      results.push_back(std::make_unique<Var>(symbol(current), *symbols));
+      break;
+    case TermKind::kApp: {
+      if (!expanded) {
+        pending.push_back({current, true});
+        pending.push_back({right(current), false});
+        pending.push_back({left(current), false});
+        break;
+      }
+      std::unique_ptr<Expr> right_expr = std::move(results.back());
+      results.pop_back();
+      std::unique_ptr<Expr> left_expr = std::move(results.back());
+      results.pop_back();
+      results.push_back(std::make_unique<App>(std::move(left_expr), std::move(right_expr)));
+      break;
+    }
+    }
+  }
+  return std::move(results.back());
+}
+
+std::string TermStore::to_string(Term term, Parens parens) const {
+  // Either a term still to print or, when text is set, a literal character. argument tells
+  // whether the term is the right child of an application.
+  struct Item {
+    Term term;
+    char text;
+    bool argument;
+  };
+  std::string output;
+  std::vector<Item> pending{{term, 0, false}};
+  while (!pending.empty()) {
+    Item item = pending.back();
+    pending.pop_back();
+    if (item.text) {
+      output += item.text;
+      continue;
+    }
+    switch (kind(item.term)) {
+    case TermKind::kS:
+      output += 'S';
+      break;
+    case TermKind::kK:
+      output += 'K';
+      break;
+    case TermKind::kI:
+      output += 'I';
+      break;
+    case TermKind::kB:
+      output += 'B';
+      break;
+    case TermKind::kC:
+      output += 'C';
+      break;
+    case TermKind::kSPrime:
+      output += "S'";
+      break;
+    case TermKind::kBStar:
+      output += "B*";
+      break;
+    case TermKind::kCPrime:
+      output += "C'";
+      break;
+    case TermKind::kVar:
+      output += identifier(item.term);
+      break;
+    case TermKind::kApp:
+      if (parens == Parens::kAll || item.argument) {
+        output += '(';
+        pending.push_back({0, ')', false});
+      }
+      pending.push_back({right(item.term), 0, true});
+      pending.push_back({0, ' ', false});
+      pending.push_back({left(item.term), 0, false});
+      break;
+    }
+  }
+  return output;
+}
+
+size_t TermStore::count_nodes(Term term, std::unordered_set<Term>& counted) const {
+  size_t count = 0;
+  std::vector<Term> pending{term};
+  while (!pending.empty()) {
+    Term current = pending.back();
+    pending.pop_back();
+    if (kind(current) != TermKind::kApp) {
+      count++;
+      continue;
+    }
+    if (!counted.insert(current).second)
+      continue;
+    count++;
+    pending.push_back(left(current));
+    pending.push_back(right(current));
+  }
+  return count;
+}
+
+} // namespace Ski
@@ -0,0 +1,79 @@
+#include "thread_pool.h"
+
+namespace Ski {
+
+ThreadPool::ThreadPool(unsigned threads) {
+  // The thread calling parallel_for is a worker too.
+  for (unsigned i = 1; i < threads; i++)
+    workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& body) {
+  std::unique_lock<std::mutex> lock(mutex);
+  this->body = &body;
+  this->count = count;
+  next = 0;
+  finished = 0;
+  error = nullptr;
+  generation++;
+  busy++;
+  lock.unlock();
+  wake.notify_all();
+  run_iterations();
+  lock.lock();
+  // Workers may still be inside body, and must have let go of it before it goes out of scope.
+  done.wait(lock, [&] { return finished == count && busy == 0; });
+  this->body = nullptr;
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void ThreadPool::work() {
+  size_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [&] { return stopping || (body && generation != seen); });
+    if (stopping)
+      return;
+    seen = generation;
+    busy++;
+    lock.unlock();
+    run_iterations();
+    lock.lock();
+  }
+}
+
+// Claims and runs iterations of the current loop until none are left. Called with busy already
+// counting this thread, and releases it.
+void ThreadPool::run_iterations() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (next < count) {
+    size_t i = next++;
+    lock.unlock();
+    std::exception_ptr thrown;
+    try {
+      (*body)(i);
+    } catch (...) {
+      thrown = std::current_exception();
+    }
+    lock.lock();
+    if (thrown && !error)
+      error = thrown;
+    finished++;
+  }
+  busy--;
+  if (busy == 0)
+    done.notify_all();
+}
+
+} // namespace Ski
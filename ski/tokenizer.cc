@@ -1,4 +1,6 @@
+#include <array>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -6,106 +8,130 @@
 
 namespace Ski {
 
-Tokenizer::Tokenizer(std::string ski_string, std::string ski_filename)
-    : ski_string(std::move(ski_string)), ski_filename(std::move(ski_filename)),
-      tokens(std::make_unique<std::vector<Token>>()) {
+// Characters that can continue an identifier, looked up instead of calling islower and isdigit
+// for every character.
+static constexpr std::array<bool, 256> kIdentifierChars = [] {
+  std::array<bool, 256> chars{};
+  for (char c = 'a'; c <= 'z'; c++)
+    chars[static_cast<unsigned char>(c)] = true;
+  for (char c = '0'; c <= '9'; c++)
+    chars[static_cast<unsigned char>(c)] = true;
+  chars['_'] = true;
+  return chars;
+}();
+
+Tokenizer::Tokenizer(std::string_view ski_source, std::string ski_filename,
+                     std::shared_ptr<SymbolTable> symbols)
+    : ski_source(ski_source), ski_filename(std::move(ski_filename)),
+      symbols(symbols ? std::move(symbols) : std::make_shared<SymbolTable>()) {
   position = 0;
   line = 1;
   column = 0;
 }
 
 std::unique_ptr<std::vector<Token>> Tokenizer::tokenize() {
-  while (position < ski_string.size()) {
-    try {
-      Token token = find_next_token();
+  auto tokens = std::make_unique<std::vector<Token>>();
+  try {
+    for (Token token = next(); token.kind != Kind::kEnd; token = next())
       tokens->push_back(token);
-    } catch (const std::runtime_error& e) {
-      std::cout << e.what() << "\n";
-      return nullptr;
-    }
+  } catch (const std::runtime_error& e) {
+    std::cout << e.what() << "\n";
+    return nullptr;
   }
-  tokens->erase(std::remove_if(tokens->begin(), tokens->end(),
-                               [](const Token& token) {
-                                 return token.kind == Kind::kLineComment ||
-                                        token.kind == Kind::kIngored;
-                               }),
-                tokens->end());
-  return std::move(tokens);
+  return tokens;
 }
 
-char Tokenizer::get_current_char() { return ski_string[position]; }
+// The NUL past the end stops every scan, like the terminator of a std::string.
+char Tokenizer::get_current_char() const {
+  return position < ski_source.size() ? ski_source[position] : '\0';
+}
 
 Token Tokenizer::find_identifier() {
-  int start = position;
-  if (islower(get_current_char()) || get_current_char() == '_') {
-    position++;
-    column++;
-    while (islower(get_current_char()) || isdigit(get_current_char()) ||
-           get_current_char() == '_') {
-      position++;
-      column++;
-    }
-  } else {
+  size_t start = position;
+  unsigned char first = get_current_char();
+  if (!kIdentifierChars[first] || isdigit(first)) {
     throw std::runtime_error(ski_filename + ":" + std::to_string(line) + ":" +
                              std::to_string(column) + ": " + "Invalid character found!");
   }
-  std::string lexeme = ski_string.substr(start, position - start);
-  if (lexeme == "def") {
-    return {Kind::kDef, "def", line, column};
-  }
-  return {Kind::kIdentifier, lexeme, line, column};
-}
-
-Token Tokenizer::find_next_token() {
-  char current_char = get_current_char();
-  switch (current_char) {
-  case 'S':
-    position++;
-    return {Kind::kSCombinator, "S", line, column++};
-  case 'K':
-    position++;
-    return {Kind::kKCombinator, "K", line, column++};
-  case 'I':
+  while (position < ski_source.size() &&
+         kIdentifierChars[static_cast<unsigned char>(ski_source[position])])
     position++;
-    return {Kind::kICombinator, "I", line, column++};
-  case '(':
-    position++;
-    return {Kind::kOpenParanthesis, "(", line, column++};
-  case ')':
-    position++;
-    return {Kind::kCloseParanthesis, ")", line, column++};
-  case ';':
-    position++;
-    return {Kind::kSemiColon, ";", line, column++};
-  case '=':
-    position++;
-    return {Kind::kEqual, "=", line, column++};
-  case '#':
-    return find_line_comment();
-  case ' ':
-  case '\t':
-    position++;
-    return {Kind::kIngored, " ", line, column++};
-  case '\n':
-    position++;
-    // start a new line
-    line++;
-    column = 0;
-    return {Kind::kIngored, "\n", line, column++};
-  default:
-    return find_identifier();
+  column += position - start;
+  std::string_view identifier = lexeme(start, position - start);
+  if (identifier == "def") {
+    return {Kind::kDef, identifier, line, column};
   }
+  if (identifier == "assert_eq") {
+    return {Kind::kAssertEq, identifier, line, column};
+  }
+  return {Kind::kIdentifier, identifier, line, column, symbols->intern(identifier)};
 }
 
-Token Tokenizer::find_line_comment() {
-  int start = position;
-  position++;
-  column++;
-  while (get_current_char() != '\n') {
-    position++;
-    column++;
+Token Tokenizer::next() {
+  // Blanks are by far the most common characters, so they are skipped in a tight loop first.
+  const char* source = ski_source.data();
+  size_t size = ski_source.size();
+  while (true) {
+    size_t blanks = position;
+    while (position < size && (source[position] == ' ' || source[position] == '\t'))
+      position++;
+    column += position - blanks;
+    if (position >= size)
+      return {Kind::kEnd, {}, line, column};
+    size_t start = position;
+    char current_char = source[position++];
+    switch (current_char) {
+    case 'S':
+      if (get_current_char() == '\'') {
+        position++;
+        column += 2;
+        return {Kind::kSPrimeCombinator, lexeme(start, 2), line, column - 2};
+      }
+      return {Kind::kSCombinator, lexeme(start, 1), line, column++};
+    case 'K':
+      return {Kind::kKCombinator, lexeme(start, 1), line, column++};
+    case 'I':
+      return {Kind::kICombinator, lexeme(start, 1), line, column++};
+    case 'B':
+      if (get_current_char() == '*') {
+        position++;
+        column += 2;
+        return {Kind::kBStarCombinator, lexeme(start, 2), line, column - 2};
+      }
+      return {Kind::kBCombinator, lexeme(start, 1), line, column++};
+    case 'C':
+      if (get_current_char() == '\'') {
+        position++;
+        column += 2;
+        return {Kind::kCPrimeCombinator, lexeme(start, 2), line, column - 2};
+      }
+      return {Kind::kCCombinator, lexeme(start, 1), line, column++};
+    case '(':
+      return {Kind::kOpenParanthesis, lexeme(start, 1), line, column++};
+    case ')':
+      return {Kind::kCloseParanthesis, lexeme(start, 1), line, column++};
+    case ';':
+      return {Kind::kSemiColon, lexeme(start, 1), line, column++};
+    case '=':
+      return {Kind::kEqual, lexeme(start, 1), line, column++};
+    case '#': {
+      // A comment runs to the end of the line, which is left for the newline case.
+      size_t end = ski_source.find('\n', position);
+      end = end == std::string_view::npos ? ski_source.size() : end;
+      column += end - start;
+      position = end;
+      continue;
+    }
+    case '\n':
+      // start a new line
+      line++;
+      column = 1;
+      continue;
+    default:
+      position = start;
+      return find_identifier();
+    }
   }
-  return Token{Kind::kLineComment, ski_string.substr(start, position - start), line, column};
 }
 
 } // namespace Ski
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "aot_compiler.h"
+#include "aot_runtime.h"
+
+// The sample programs, compiled by ski-compile as the test is built.
+extern const Ski::Aot::Program arithmetic_program;
+extern const Ski::Aot::Program boolean_program;
+extern const Ski::Aot::Program fibbonacci_program;
+extern const Ski::Aot::Program pair_program;
+extern const Ski::Aot::Program test_program;
+
+using namespace Ski;
+
+static std::unique_ptr<Ski::Ski> parse(const std::string& ski_program) {
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  return parser.parse();
+}
+
+// The supercombinators compiled for the definitions ski_program uses, by name.
+static std::map<std::string, std::string> compile(const std::string& ski_program,
+                                                  const AotOptions& options = {}) {
+  Interpreter interpreter(parse(ski_program));
+  AotCompiler compiler(interpreter.get_term_store(), options);
+  compiler.add_program(interpreter);
+  std::map<std::string, std::string> bodies;
+  for (auto& supercombinator : compiler.get_supercombinators()) {
+    std::string head = supercombinator.name;
+    for (uint32_t param = 0; param < supercombinator.arity; param++)
+      head += " x" + std::to_string(param);
+    bodies[supercombinator.name] =
+        head + " = " + format_body(supercombinator, interpreter.get_term_store());
+  }
+  return bodies;
+}
+
+TEST(AotCompilerTest, TestDerivesSupercombinators) {
+  auto bodies = compile(R"(
+    def compose = S (K S) K;
+    def swap = S (K (S I)) K;
+    def twice = S I I;
+    compose; swap; twice;
+  )");
+  EXPECT_EQ(bodies.size(), 3);
+  EXPECT_EQ(bodies["compose"], "compose x0 x1 x2 = x0 (x1 x2)");
+  EXPECT_EQ(bodies["swap"], "swap x0 x1 = x1 (K x0 x1)");
+  EXPECT_EQ(bodies["twice"], "twice x0 = x0 (I x0)");
+}
+
+TEST(AotCompilerTest, TestLeavesDefinitionsWithoutArgumentsAlone) {
+  // A leaf, a head normal form and a term that reduces to one without any argument.
+  auto bodies = compile(R"(
+    def id = I;
+    def free = x y;
+    def value = I x;
+    def partial = S K;
+    id; free; value; partial;
+  )");
+  EXPECT_EQ(bodies.size(), 1);
+  EXPECT_EQ(bodies["partial"], "partial x0 x1 = x1");
+}
+
+TEST(AotCompilerTest, TestKeepsPartialApplicationsShared) {
+  // inc n f needs a third argument once x0 x1 is built. A shared inc n f would reduce n f again in
+  // every call if the function took that argument too.
+  auto bodies = compile("def inc = S (S (K S) K); inc;");
+  EXPECT_EQ(bodies["inc"], "inc x0 x1 = S (K x1) (x0 x1)");
+}
+
+TEST(AotCompilerTest, TestBoundsTheArity) {
+  AotOptions options;
+  options.max_arity = 2;
+  auto bodies = compile("def compose = S (K S) K; compose;", options);
+  EXPECT_EQ(bodies["compose"], "compose x0 = S (K x0)");
+}
+
+TEST(AotCompilerTest, TestEmitsALibraryWithoutMain) {
+  Interpreter interpreter(parse("def inc = S (S (K S) K); inc x; assert_eq x x;"));
+  AotOptions options;
+  std::ostringstream program;
+  AotCompiler(interpreter.get_term_store(), options).emit(program, "test.ski");
+  EXPECT_NE(program.str().find("int main()"), std::string::npos);
+  options.library = true;
+  options.symbol = "inc_program";
+  AotCompiler compiler(interpreter.get_term_store(), options);
+  compiler.add_program(interpreter);
+  std::ostringstream library;
+  compiler.emit(library, "test.ski");
+  EXPECT_EQ(library.str().find("int main()"), std::string::npos);
+  EXPECT_NE(library.str().find("extern const Ski::Aot::Program inc_program"), std::string::npos);
+  EXPECT_NE(library.str().find("kAssertions"), std::string::npos);
+}
+
+TEST(AotCompilerTest, TestCompiledProgramsPrintWhatTheInterpreterPrints) {
+  std::pair<const char*, const Aot::Program*> programs[] = {
+      {"arithmetic", &arithmetic_program},
+      {"boolean", &boolean_program},
+      {"fibbonacci", &fibbonacci_program},
+      {"pair", &pair_program},
+      {"test", &test_program}};
+  for (auto [name, program] : programs) {
+    std::ifstream file(std::string(SKI_PROGRAMS_DIR) + "/" + name + ".ski");
+    std::stringstream source;
+    source << file.rdbuf();
+    Interpreter interpreter(parse(source.str()));
+    std::ostringstream expected;
+    interpreter.interpret_exprs(expected);
+    std::ostringstream output;
+    std::ostringstream errors;
+    EXPECT_EQ(Aot::run(*program, output, errors), 0) << name;
+    EXPECT_EQ(output.str(), expected.str()) << name;
+    EXPECT_EQ(errors.str(), "") << name;
+  }
+}
+
+TEST(AotCompilerTest, TestFailedAssertionsAreReportedLikeTheInterpreter) {
+  // The table of x; K x; assert_eq x (K x), written out by hand.
+  const Aot::TermEntry terms[] = {
+      {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry},
+      {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry}, {0, Aot::kLeafEntry},
+      {0, Aot::kLeafEntry}, {1, 8}};
+  const char* const names[] = {"x"};
+  const uint32_t exprs[] = {8, 9};
+  const Aot::Assertion assertions[] = {{3, 8, 9}, {4, 9, 9}};
+  Aot::Program program = {"test.ski", terms, 10, names, nullptr, 0, exprs, 2, assertions, 2};
+  std::ostringstream output;
+  std::ostringstream errors;
+  EXPECT_EQ(Aot::run(program, output, errors), 1);
+  EXPECT_EQ(output.str(), "x\n(K x)\n");
+  EXPECT_EQ(errors.str(), "test.ski:3: assert_eq failed: the normal forms differ\n");
+}
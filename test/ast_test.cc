@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "tokenizer.h"
+#include "parser.h"
+
+using namespace Ski;
+
+static std::unique_ptr<Ski::Ski> parse(const std::string& ski_program) {
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  return parser.parse();
+}
+
+static std::string print(const Expr& expr, Parens parens) {
+  std::string output;
+  print_expr(expr, output, parens);
+  return output;
+}
+
+TEST(SkiAstTest, TestAllParensWrapEveryApplication) {
+  auto ski_ast = parse(R"(S K (K I) (x y z); S' B* C' x;)");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[0], Parens::kAll), "(((S K) (K I)) ((x y) z))");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[1], Parens::kAll), "(((S' B*) C') x)");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[0], Parens::kAll),
+            static_cast<std::string>(*ski_ast->get_exprs()[0]));
+}
+
+TEST(SkiAstTest, TestMinimalParensOnlyWrapArguments) {
+  auto ski_ast = parse(R"(S K (K I) (x y z); f (f (f x)); I;)");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[0], Parens::kMinimal), "S K (K I) (x y z)");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[1], Parens::kMinimal), "f (f (f x))");
+  EXPECT_EQ(print(*ski_ast->get_exprs()[2], Parens::kMinimal), "I");
+}
+
+TEST(SkiAstTest, TestMinimalParensReadBackAsTheSameTerm) {
+  std::string ski_program = R"(S (K (S I)) (S (K K) I) ((x y) (z (w v))) (K I);)";
+  auto ski_ast = parse(ski_program);
+  std::string minimal = print(*ski_ast->get_exprs()[0], Parens::kMinimal);
+  auto reparsed = parse(minimal + ";");
+  EXPECT_EQ(print(*reparsed->get_exprs()[0], Parens::kAll),
+            print(*ski_ast->get_exprs()[0], Parens::kAll));
+}
+
+TEST(SkiAstTest, TestDeepTermsPrintWithoutRecursion) {
+  // Deep enough to overflow the C stack of a recursive printer.
+  constexpr size_t kDepth = 1000000;
+  SymbolTable symbols;
+  Symbol f = symbols.intern("f");
+  std::unique_ptr<Expr> right_nested = std::make_unique<Var>(symbols.intern("x"), symbols);
+  std::unique_ptr<Expr> left_nested = std::make_unique<Var>(f, symbols);
+  for (size_t i = 0; i < kDepth; i++) {
+    right_nested =
+        std::make_unique<App>(std::make_unique<Var>(f, symbols), std::move(right_nested));
+    left_nested = std::make_unique<App>(std::move(left_nested), std::make_unique<I>());
+  }
+  std::string all = print(*right_nested, Parens::kAll);
+  EXPECT_EQ(all.size(), 4 * kDepth + 1);
+  EXPECT_EQ(all.substr(0, 6), "(f (f ");
+  std::string minimal = print(*left_nested, Parens::kMinimal);
+  EXPECT_EQ(minimal.size(), 2 * kDepth + 1);
+  EXPECT_EQ(minimal.substr(0, 6), "f I I ");
+}
+
+TEST(SkiAstTest, TestStreamMatchesString) {
+  // Longer than one chunk of the stream printer.
+  std::string ski_program;
+  for (int i = 0; i < 20000; i++)
+    ski_program += "(S K x" + std::to_string(i) + ") ";
+  ski_program += ";";
+  auto ski_ast = parse(ski_program);
+  for (Parens parens : {Parens::kAll, Parens::kMinimal}) {
+    std::ostringstream stream;
+    print_expr(*ski_ast->get_exprs()[0], stream, parens);
+    EXPECT_EQ(stream.str(), print(*ski_ast->get_exprs()[0], parens));
+  }
+}
+
+TEST(SkiAstTest, TestEqualTreesHashEqually) {
+  auto ski_ast = parse(R"(S K (x y); S K (x y); S K (y x); x y; y x; S' x; B* x;)");
+  auto& exprs = ski_ast->get_exprs();
+  EXPECT_EQ(exprs[0]->get_hash(), exprs[1]->get_hash());
+  EXPECT_TRUE(equal_exprs(*exprs[0], *exprs[1]));
+  EXPECT_TRUE(equal_exprs(*exprs[0], *exprs[0]->clone()));
+  // Application is not commutative, and neither is its hash.
+  EXPECT_NE(exprs[0]->get_hash(), exprs[2]->get_hash());
+  EXPECT_NE(exprs[3]->get_hash(), exprs[4]->get_hash());
+  EXPECT_FALSE(equal_exprs(*exprs[3], *exprs[4]));
+  EXPECT_NE(exprs[5]->get_hash(), exprs[6]->get_hash());
+}
+
+TEST(SkiAstTest, TestSettersUpdateHash) {
+  auto ski_ast = parse(R"(f x; f y;)");
+  auto expr = ski_ast->get_exprs()[0]->clone();
+  auto app = static_cast<App*>(expr.get());
+  EXPECT_FALSE(equal_exprs(*app, *ski_ast->get_exprs()[1]));
+  app->set_right(ski_ast->get_exprs()[1]->clone());
+  EXPECT_NE(app->get_hash(), ski_ast->get_exprs()[1]->get_hash());
+  app->set_right(static_cast<const App*>(ski_ast->get_exprs()[1].get())->get_right()->clone());
+  EXPECT_EQ(app->get_hash(), ski_ast->get_exprs()[1]->get_hash());
+  EXPECT_TRUE(equal_exprs(*app, *ski_ast->get_exprs()[1]));
+}
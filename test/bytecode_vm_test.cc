@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "bytecode_vm.h"
+#include "term_store.h"
+
+using namespace Ski;
+
+TEST(BytecodeVmTest, TestCompilesTermsToLinearCode) {
+  TermStore store;
+  Term kx = store.app(store.k(), store.var("x"));
+  BytecodeProgram program(store);
+  uint32_t address = program.compile(store.app(kx, kx));
+  // The shared K x is built once and loaded for its second use.
+  EXPECT_EQ(program.disassemble(address), "push_leaf K\n"
+                                          "push_leaf x\n"
+                                          "mkap\n"
+                                          "store 0\n"
+                                          "load 0\n"
+                                          "mkap\n"
+                                          "return\n");
+  EXPECT_EQ(program.compile(store.app(kx, kx)), address);
+}
+
+TEST(BytecodeVmTest, TestCombinatorsRunTheirRules) {
+  TermStore store;
+  auto apply = [&](Term head, std::initializer_list<const char*> args) {
+    for (const char* arg : args)
+      head = store.app(head, store.var(arg));
+    return head;
+  };
+  struct Case {
+    Term term;
+    const char* normal_form;
+    size_t steps;
+  };
+  Case cases[] = {{apply(store.s(), {"x", "y", "z"}), "((x z) (y z))", 1},
+                  {apply(store.k(), {"x", "y"}), "x", 1},
+                  {apply(store.i(), {"x"}), "x", 1},
+                  {apply(store.b(), {"x", "y", "z"}), "(x (y z))", 1},
+                  {apply(store.c(), {"x", "y", "z"}), "((x z) y)", 1},
+                  {apply(store.s_prime(), {"c", "f", "g", "x"}), "((c (f x)) (g x))", 1},
+                  {apply(store.b_star(), {"c", "f", "g", "x"}), "(c (f (g x)))", 1},
+                  {apply(store.c_prime(), {"c", "f", "g", "x"}), "((c (f x)) g)", 1},
+                  // Unsaturated combinators are left alone.
+                  {apply(store.s(), {"x", "y"}), "((S x) y)", 0}};
+  BytecodeProgram program(store);
+  for (const Case& test_case : cases) {
+    BytecodeVm machine(program);
+    EXPECT_TRUE(machine.evaluate(program.compile(test_case.term)));
+    EXPECT_EQ(machine.normal_form(), test_case.normal_form);
+    EXPECT_EQ(machine.get_steps(), test_case.steps) << test_case.normal_form;
+  }
+}
+
+TEST(BytecodeVmTest, TestGlobalsAreInstantiatedOnce) {
+  TermStore store;
+  Term x = store.var("x");
+  Term twice = store.app(store.i(), store.app(store.i(), x));
+  BytecodeProgram program(store);
+  program.add_global(twice);
+  Term term = store.app(store.app(store.app(store.s(), store.i()), store.i()), twice);
+  uint32_t address = program.compile(term);
+  EXPECT_NE(program.disassemble(address).find("push_global 0\n"), std::string::npos);
+  BytecodeVm machine(program);
+  EXPECT_TRUE(machine.evaluate(address));
+  EXPECT_EQ(machine.normal_form(), "(x x)");
+  // S I I t = I t (I t) = t (I t), after which both copies of t share its two I steps.
+  EXPECT_EQ(machine.get_steps(), 5);
+  EXPECT_EQ(machine.normal_form_term(store), store.app(x, x));
+}
+
+TEST(BytecodeVmTest, TestStopsWhenTheBudgetRunsOut) {
+  TermStore store;
+  Term sii = store.app(store.app(store.s(), store.i()), store.i());
+  BytecodeProgram program(store);
+  EvaluationBudget budget;
+  budget.max_steps = 10;
+  BudgetMeter meter(budget);
+  BytecodeVm machine(program);
+  EXPECT_FALSE(machine.evaluate(program.compile(store.app(sii, sii)), &meter));
+  EXPECT_EQ(meter.get_status(), EvalStatus::kStepLimit);
+  EXPECT_EQ(machine.get_steps(), 10);
+}
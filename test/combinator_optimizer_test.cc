@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "term_store.h"
+#include "combinator_optimizer.h"
+
+using namespace Ski;
+
+static std::string optimize(const std::string& ski_program) {
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  TermStore store;
+  CombinatorOptimizer optimizer(store);
+  return store.to_string(optimizer.optimize(store.intern(*ski_ast->get_exprs()[0])));
+}
+
+TEST(SkiCombinatorOptimizerTest, TestConstantComposition) {
+  EXPECT_EQ(optimize("S (K p) (K q);"), "((B p) (K q))");
+}
+
+TEST(SkiCombinatorOptimizerTest, TestNoRedexIsCreated) {
+  // K (p q) would apply S I I to itself, so a normal form would diverge.
+  EXPECT_EQ(optimize("S (K (S I I)) (K (S I I));"), "((B ((S I) I)) (K ((S I) I)))");
+}
+
+TEST(SkiCombinatorOptimizerTest, TestEta) { EXPECT_EQ(optimize("S (K p) I;"), "p"); }
+
+TEST(SkiCombinatorOptimizerTest, TestBStar) {
+  EXPECT_EQ(optimize("S (K p) (S (K q) r);"), "(((B* p) q) r)");
+}
+
+TEST(SkiCombinatorOptimizerTest, TestB) { EXPECT_EQ(optimize("S (K p) q;"), "((B p) q)"); }
+
+TEST(SkiCombinatorOptimizerTest, TestCPrime) {
+  EXPECT_EQ(optimize("S (S (K p) q) (K r);"), "(((C' p) q) r)");
+}
+
+TEST(SkiCombinatorOptimizerTest, TestC) { EXPECT_EQ(optimize("S p (K q);"), "((C p) q)"); }
+
+TEST(SkiCombinatorOptimizerTest, TestSPrime) {
+  EXPECT_EQ(optimize("S (S (K p) q) r;"), "(((S' p) q) r)");
+}
+
+TEST(SkiCombinatorOptimizerTest, TestUnmatchedTermIsUnchanged) {
+  EXPECT_EQ(optimize("S p q r;"), "(((S p) q) r)");
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "evaluation_budget.h"
+
+using namespace Ski;
+
+TEST(SkiEvaluationBudgetTest, TestUnlimitedBudget) {
+  EvaluationBudget budget;
+  EXPECT_FALSE(budget.is_limited());
+  BudgetMeter meter(budget);
+  for (int i = 0; i < 10000; i++)
+    ASSERT_TRUE(meter.charge(1));
+  EXPECT_EQ(meter.get_status(), EvalStatus::kNormalForm);
+}
+
+TEST(SkiEvaluationBudgetTest, TestStepLimitRefusesTheNextStep) {
+  EvaluationBudget budget;
+  budget.max_steps = 3;
+  BudgetMeter meter(budget);
+  EXPECT_TRUE(meter.charge(0));
+  EXPECT_TRUE(meter.charge(0));
+  EXPECT_TRUE(meter.charge(0));
+  EXPECT_FALSE(meter.charge(0));
+  EXPECT_EQ(meter.get_status(), EvalStatus::kStepLimit);
+  // Once exhausted, every later step is refused too.
+  EXPECT_FALSE(meter.charge(-10));
+}
+
+TEST(SkiEvaluationBudgetTest, TestNodeLimitFollowsGrowth) {
+  EvaluationBudget budget;
+  budget.max_nodes = 10;
+  BudgetMeter meter(budget);
+  meter.add_nodes(8);
+  EXPECT_TRUE(meter.charge(2));
+  EXPECT_TRUE(meter.charge(-5));
+  EXPECT_TRUE(meter.charge(5));
+  EXPECT_FALSE(meter.charge(1));
+  EXPECT_EQ(meter.get_status(), EvalStatus::kNodeLimit);
+}
+
+TEST(SkiEvaluationBudgetTest, TestTimeLimit) {
+  EvaluationBudget budget;
+  budget.max_time = std::chrono::milliseconds(1);
+  BudgetMeter meter(budget);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  bool refused = false;
+  // The clock is read every few hundred steps.
+  for (int i = 0; i < 1000 && !refused; i++)
+    refused = !meter.charge(0);
+  EXPECT_TRUE(refused);
+  EXPECT_EQ(meter.get_status(), EvalStatus::kTimeLimit);
+}
+
+TEST(SkiEvaluationBudgetTest, TestCancellation) {
+  CancellationToken token;
+  EvaluationBudget budget;
+  budget.cancellation = &token;
+  EXPECT_TRUE(budget.is_limited());
+  BudgetMeter meter(budget);
+  EXPECT_TRUE(meter.charge(0));
+  token.cancel();
+  bool refused = false;
+  for (int i = 0; i < 1000 && !refused; i++)
+    refused = !meter.charge(0);
+  EXPECT_TRUE(refused);
+  EXPECT_EQ(meter.get_status(), EvalStatus::kCancelled);
+  EXPECT_STREQ(eval_status_name(meter.get_status()), "cancelled");
+}
+
+TEST(SkiEvaluationBudgetTest, TestCycleDetectorFindsTheExactLength) {
+  // 10 states lead into a cycle of 7.
+  auto state = [](size_t step) { return step < 10 ? step : 10 + (step - 10) % 7; };
+  CycleDetector cycles;
+  size_t step = 0;
+  while (!cycles.visit(state(step) * 0x9e3779b97f4a7c15, step))
+    ASSERT_LT(++step, 100);
+  Cycle cycle = cycles.get_cycle();
+  EXPECT_EQ(cycle.length, 7);
+  EXPECT_GE(cycle.start, 10);
+  EXPECT_EQ(state(cycle.start), state(cycle.start + cycle.length));
+  cycles.reset();
+  for (step = 0; step < 1000; step++)
+    ASSERT_FALSE(cycles.visit(step, step));
+}
+
+TEST(SkiEvaluationBudgetTest, TestReportedCycleStopsTheMeter) {
+  EvaluationBudget budget;
+  budget.detect_cycles = true;
+  EXPECT_TRUE(budget.is_limited());
+  BudgetMeter meter(budget);
+  EXPECT_TRUE(meter.detects_cycles());
+  EXPECT_TRUE(meter.charge(0));
+  meter.report_cycle({1, 3});
+  EXPECT_FALSE(meter.charge(0));
+  EXPECT_EQ(meter.get_status(), EvalStatus::kCycle);
+  EXPECT_EQ(meter.get_cycle().length, 3);
+  // The first reason to stop wins.
+  budget.detect_cycles = false;
+  budget.max_steps = 1;
+  BudgetMeter limited(budget);
+  EXPECT_TRUE(limited.charge(0));
+  EXPECT_FALSE(limited.charge(0));
+  limited.report_cycle({0, 1});
+  EXPECT_EQ(limited.get_status(), EvalStatus::kStepLimit);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "interpreter_stats.h"
+
+using namespace Ski;
+
+TEST(SkiInterpreterStatsTest, TestAddKeepsTheLargerPeak) {
+  ReductionStats left;
+  left.steps = 3;
+  left.rule_steps[0] = 2;
+  left.peak_nodes = 10;
+  left.final_nodes = 1;
+  ReductionStats right;
+  right.steps = 4;
+  right.rule_steps[0] = 1;
+  right.jet_steps = 1;
+  right.peak_nodes = 7;
+  right.final_nodes = 3;
+  left.add(right);
+  EXPECT_EQ(left.steps, 7);
+  EXPECT_EQ(left.rule_steps[0], 3);
+  EXPECT_EQ(left.jet_steps, 1);
+  EXPECT_EQ(left.peak_nodes, 10);
+  EXPECT_EQ(left.final_nodes, 4);
+}
+
+TEST(SkiInterpreterStatsTest, TestNormalFormsAreBucketedByPowersOfTwo) {
+  InterpreterStats stats;
+  stats.add_normal_form(1);
+  stats.add_normal_form(2);
+  stats.add_normal_form(3);
+  stats.add_normal_form(4);
+  stats.add_normal_form(7);
+  EXPECT_EQ(stats.normal_form_sizes[0], 1);
+  EXPECT_EQ(stats.normal_form_sizes[1], 2);
+  EXPECT_EQ(stats.normal_form_sizes[2], 2);
+  EXPECT_EQ(stats.normal_form_sizes[3], 0);
+}
+
+TEST(SkiInterpreterStatsTest, TestFormatStats) {
+  InterpreterStats stats;
+  stats.reductions.steps = 3;
+  stats.reductions.rule_steps[0] = 1;
+  stats.reductions.rule_steps[1] = 2;
+  stats.reductions.passes = 2;
+  stats.reductions.peak_nodes = 9;
+  stats.reductions.final_nodes = 3;
+  // The second expression was cut off by a budget.
+  stats.exprs = 2;
+  stats.add_normal_form(3);
+  stats.phase_ns[static_cast<size_t>(Phase::kReduce)] = 1500000;
+  std::string human = format_stats(stats);
+  EXPECT_NE(human.find("reduce 1.5 ms"), std::string::npos);
+  EXPECT_NE(human.find("steps: 3 (S 1, K 2, I 0,"), std::string::npos);
+  EXPECT_NE(human.find("nodes: 9 peak, 3 final"), std::string::npos);
+  EXPECT_NE(human.find("normal forms: 1 (2-3 nodes: 1)\n"), std::string::npos);
+  std::string json = format_stats_json(stats);
+  EXPECT_NE(json.find("\"reduce\": 1500000"), std::string::npos);
+  EXPECT_NE(json.find("\"rule_steps\": {\"S\": 1, \"K\": 2,"), std::string::npos);
+  EXPECT_NE(json.find("\"normal_form_sizes\": {\"2-3\": 1}"), std::string::npos);
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.back(), '}');
+}
@@ -1,56 +1,60 @@
 #include <gtest/gtest.h>
 
+#include <sstream>
+
 #include "tokenizer.h"
 #include "parser.h"
 #include "interpreter.h"
 
 using namespace Ski;
 
-TEST(SkiInterpreterTest, TestICombinatorExpression) {
+class SkiInterpreterTest : public ::testing::TestWithParam<Engine> {};
+
+TEST_P(SkiInterpreterTest, TestICombinatorExpression) {
   std::string ski_program = R"(I i;)";
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 1);
   ASSERT_EQ(outputs[0], "i");
 }
 
-TEST(SkiInterpreterTest, TestKCombinatorExpression) {
+TEST_P(SkiInterpreterTest, TestKCombinatorExpression) {
   std::string ski_program = R"(K x y;)";
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 1);
   ASSERT_EQ(outputs[0], "x");
 }
 
-TEST(SkiInterpreterTest, TestSCombinatorExpression) {
+TEST_P(SkiInterpreterTest, TestSCombinatorExpression) {
   std::string ski_program = R"(S p q r;)";
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 1);
   EXPECT_STREQ(outputs[0].c_str(), "((p r) (q r))");
 }
 
-TEST(SkiInterpreterTest, TestMultipleCombinatorApplications) {
+TEST_P(SkiInterpreterTest, TestMultipleCombinatorApplications) {
   std::string ski_program = R"(S I I I;)";
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 1);
   EXPECT_STREQ(outputs[0].c_str(), "I");
 }
 
-TEST(SkiInterpreterTest, TestSKINaturalNumbers) {
+TEST_P(SkiInterpreterTest, TestSKINaturalNumbers) {
   std::string ski_program = R"(
 def inc = S (S (K S) K);
 def _0  = S K;
@@ -63,7 +67,7 @@ _1 f x;
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 3);
   EXPECT_STREQ(outputs[0].c_str(), "x");
@@ -71,7 +75,7 @@ _1 f x;
   EXPECT_STREQ(outputs[2].c_str(), "(f (f x))");
 }
 
-TEST(SkiInterpreterTest, TestSwapCombinator) {
+TEST_P(SkiInterpreterTest, TestSwapCombinator) {
   std::string ski_program = R"(
 def swap = S (K (SI)) (S (K K) I);
 swap a b;
@@ -79,13 +83,13 @@ swap a b;
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 1);
   EXPECT_STREQ(outputs[0].c_str(), "(b a)");
 }
 
-TEST(SkiInterpreterTest, TestIsOddCombinator) {
+TEST_P(SkiInterpreterTest, TestIsOddCombinator) {
   std::string ski_program = R"(
 def ff = S K;
 def tt = K;
@@ -106,7 +110,7 @@ is_odd _2;
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 3);
   EXPECT_STREQ(outputs[0].c_str(), "(S K)");
@@ -114,7 +118,7 @@ is_odd _2;
   EXPECT_STREQ(outputs[2].c_str(), "(S K)");
 }
 
-TEST(SkiInterpreterTest, TestArithmeticOperations) {
+TEST_P(SkiInterpreterTest, TestArithmeticOperations) {
   std::string ski_program = R"(
 def c1 = S (K S) K;
 def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
@@ -135,7 +139,7 @@ add _3 _2;
   Tokenizer tokenizer(ski_program, "test.ski");
   Parser parser(std::move(tokenizer.tokenize()), "test.ski");
   auto ski_ast = parser.parse();
-  Interpreter interpreter(std::move(ski_ast));
+  Interpreter interpreter(std::move(ski_ast), GetParam());
   auto outputs = interpreter.interpret_exprs();
   ASSERT_EQ(outputs.size(), 2);
   EXPECT_STREQ(outputs[0].c_str(), "((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S "
@@ -143,3 +147,921 @@ add _3 _2;
   EXPECT_STREQ(outputs[1].c_str(), "((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S "
                                    "((S (K S)) K)) ((S ((S (K S)) K)) (S K))))))");
 }
+
+TEST_P(SkiInterpreterTest, TestBCombinatorExpression) {
+  std::string ski_program = R"(B x y z;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), GetParam());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "(x (y z))");
+}
+
+TEST_P(SkiInterpreterTest, TestCCombinatorExpression) {
+  std::string ski_program = R"(C x y z;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), GetParam());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "((x z) y)");
+}
+
+TEST_P(SkiInterpreterTest, TestSPrimeCombinatorExpression) {
+  std::string ski_program = R"(S' c f g x;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), GetParam());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "((c (f x)) (g x))");
+}
+
+TEST_P(SkiInterpreterTest, TestBStarCombinatorExpression) {
+  std::string ski_program = R"(B* c f g x;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), GetParam());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "(c (f (g x)))");
+}
+
+TEST_P(SkiInterpreterTest, TestCPrimeCombinatorExpression) {
+  std::string ski_program = R"(C' c f g x;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), GetParam());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "((c (f x)) g)");
+}
+
+TEST_P(SkiInterpreterTest, TestOptimizedFibonacciNumbers) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def second = S K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I second)))(c2 I first);
+
+inc _1;
+(_1 fib (pair _1 _1)) first f x;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.optimize = true;
+  Interpreter interpreter(std::move(ski_ast), options);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 2);
+  // Unsaturated combinators are left in their optimized form.
+  EXPECT_STREQ(outputs[0].c_str(), "(((S' S) K) (((S' S) K) (S K)))");
+  EXPECT_STREQ(outputs[1].c_str(), "(f (f x))");
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, SkiInterpreterTest,
+                         ::testing::Values(Engine::kTree, Engine::kGraph, Engine::kBytecode),
+                         [](const ::testing::TestParamInfo<Engine>& info) {
+                           switch (info.param) {
+                           case Engine::kTree:
+                             return "Tree";
+                           case Engine::kGraph:
+                             return "Graph";
+                           case Engine::kBytecode:
+                             return "Bytecode";
+                           }
+                           return "Unknown";
+                         });
+
+TEST(SkiGraphInterpreterTest, TestDiscardedDivergentArgument) {
+  std::string ski_program = R"(K I (S I I (S I I)) x;)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), Engine::kGraph);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "x");
+}
+
+TEST(SkiGraphInterpreterTest, TestFibonacciNumbers) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def second = S K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def _4  = _2 inc _2;
+def _8  = _4 inc _4;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I second)))(c2 I first);
+
+(_8 fib (pair _1 _1)) first f x;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), Engine::kGraph);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  std::string expected = "x";
+  for (int i = 0; i < 55; i++)
+    expected = "(f " + expected + ")";
+  EXPECT_EQ(outputs[0], expected);
+}
+
+TEST(SkiGraphInterpreterTest, TestDeepApplicationChain) {
+  std::string ski_program;
+  for (int i = 0; i < 300000; i++)
+    ski_program += "I ";
+  ski_program += "x;";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), Engine::kGraph);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_STREQ(outputs[0].c_str(), "x");
+}
+
+TEST(SkiGraphInterpreterTest, TestDeepNormalForm) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _5  = inc (inc (inc (inc (inc _0))));
+def _10 = _5 inc _5;
+
+_5 _10 f x;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  Interpreter interpreter(std::move(ski_ast), Engine::kGraph);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  // 10^5 nested applications of f.
+  EXPECT_EQ(outputs[0].size(), 100000 * 4 + 1);
+  EXPECT_EQ(outputs[0].substr(0, 8), "(f (f (f");
+}
+
+TEST(SkiGraphInterpreterTest, TestChurchJetsMatchCombinatorRules) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def _3  = inc _2;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def _5  = add _2 _3;
+
+_0; _3; inc; add; _3 f; _0 f; _3 f x; _0 f x; _2 _3 f x; _0 inc _3; _2 inc _3;
+inc x; inc _3; inc (I _3); add _2; add _2 _3; add x _1; add _1 x f y; add _5 _5 f x;
+S K K; _3 K x y z w; _2 _2 inc _0; (_3 (add _2) _1) f x;
+)";
+  auto interpret = [&](bool jets) {
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = Engine::kGraph;
+    options.jets = jets;
+    Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  auto with_jets = interpret(true);
+  auto without_jets = interpret(false);
+  ASSERT_EQ(with_jets.size(), 23);
+  EXPECT_EQ(with_jets, without_jets);
+  EXPECT_EQ(with_jets[15], "((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S ((S (K S)) K)) ((S ((S (K "
+                           "S)) K)) ((S ((S (K S)) K)) (S K))))))");
+}
+
+TEST(SkiGraphInterpreterTest, TestPartialTermsPrintJetCells) {
+  std::string definitions = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def inc = S (S (K S) K);
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+)";
+  auto interpret = [&](const std::string& exprs, size_t max_steps) {
+    std::string ski_program = definitions + exprs;
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = Engine::kGraph;
+    options.budget.max_steps = max_steps;
+    Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  // The partial term still refers to the add cell built for the jet.
+  auto partial = interpret("add (K y y) add;", 1);
+  ASSERT_EQ(partial.size(), 1);
+  EXPECT_LT(partial[0].size(), 1000);
+  EXPECT_EQ(interpret(partial[0] + ";", 0), interpret("add (K y y) add;", 0));
+}
+
+TEST_P(SkiInterpreterTest, TestParallelExpressionsKeepSourceOrder) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _2  = inc (inc _0);
+def _4  = _2 _2;
+
+_4 _2 f x; I a; K b c; _2 g y; S K K d; _4 f x; B e h i; C j k l;
+)";
+  auto interpret = [&](unsigned jobs) {
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = GetParam();
+    options.jobs = jobs;
+    Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  auto serial = interpret(1);
+  ASSERT_EQ(serial.size(), 8);
+  EXPECT_EQ(serial[1], "a");
+  EXPECT_EQ(serial[3], "(g (g y))");
+  EXPECT_EQ(serial[7], "((j l) k)");
+  EXPECT_EQ(interpret(4), serial);
+}
+
+TEST_P(SkiInterpreterTest, TestStreamedOutputKeepsSourceOrder) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _2  = inc (inc _0);
+def _4  = _2 _2;
+
+_4 _2 f x; I a; K b c; _2 g y; S K K d; _4 f x; B e h i; C j k l;
+)";
+  auto interpret = [&](unsigned jobs, std::ostream* stream) {
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = GetParam();
+    options.jobs = jobs;
+    Interpreter interpreter(parser.parse(), options);
+    if (!stream)
+      return interpreter.interpret_exprs();
+    interpreter.interpret_exprs(*stream);
+    return std::vector<std::string>{};
+  };
+  std::string expected;
+  for (auto& output : interpret(1, nullptr))
+    expected += output + "\n";
+  for (unsigned jobs : {1u, 4u}) {
+    std::ostringstream stream;
+    interpret(jobs, &stream);
+    EXPECT_EQ(stream.str(), expected);
+  }
+}
+
+TEST_P(SkiInterpreterTest, TestMinimalParensReadBackAsTheSameNormalForms) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _3  = inc (inc (inc _0));
+
+S p q r; _3; K _3; _3 f x; K (x y) (z w);
+)";
+  auto interpret = [&](const std::string& source, Parens parens) {
+    Tokenizer tokenizer(source, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = GetParam();
+    options.parens = parens;
+    Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  auto all = interpret(ski_program, Parens::kAll);
+  auto minimal = interpret(ski_program, Parens::kMinimal);
+  ASSERT_EQ(minimal.size(), 5);
+  EXPECT_EQ(minimal[0], "p r (q r)");
+  EXPECT_EQ(minimal[3], "f (f (f x))");
+  EXPECT_EQ(minimal[4], "x y");
+  // Normal forms do not reduce further, so reading one back yields it unchanged.
+  std::string reread;
+  for (auto& output : minimal)
+    reread += output + ";";
+  EXPECT_EQ(interpret(reread, Parens::kAll), all);
+}
+
+TEST(SkiTreeInterpreterTest, TestParallelSubtermReduction) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I (S K))))(c2 I first);
+
+(_2 fib (pair _1 _1)) first f x;
+(_2 fib (pair _2 _1)) first;
+)";
+  auto interpret = [&](unsigned threads) {
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.subterm_threads = threads;
+    options.subterm_threshold = 8;
+    Interpreter interpreter(parser.parse(), options);
+    return interpreter.interpret_exprs();
+  };
+  auto serial = interpret(1);
+  ASSERT_EQ(serial.size(), 2);
+  EXPECT_EQ(serial[0], "(f (f (f x)))");
+  EXPECT_EQ(interpret(4), serial);
+}
+
+TEST_P(SkiInterpreterTest, TestDefinitionsResolvedOnFirstUse) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _1  = inc _0;
+def later = K y;
+def loop = S I I (S I I);
+def self = K self;
+def early = later;
+
+_1 f x;
+early;
+self;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  Interpreter interpreter(parser.parse(), GetParam());
+  EXPECT_TRUE(interpreter.get_resolved_definitions_map().empty());
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 3);
+  EXPECT_EQ(outputs[0], "(f x)");
+  EXPECT_EQ(outputs[1], "(K y)");
+  // A definition only sees the ones before it, so self refers to a free variable.
+  EXPECT_EQ(outputs[2], "(K self)");
+  auto resolved = interpreter.get_resolved_definitions_map();
+  EXPECT_EQ(resolved.size(), 6);
+  EXPECT_FALSE(resolved.count("loop"));
+}
+
+TEST(SkiGraphInterpreterTest, TestDiscardedDefinitionsAreNotBuilt) {
+  std::string ski_program = R"(
+def inc = S (S (K S) K);
+def _0  = S K;
+def _2  = inc (inc _0);
+def _4  = _2 _2;
+def big = _4 _4 _4 (S (K S) K) (S (K S) K);
+
+K x big;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  Interpreter interpreter(parser.parse(), Engine::kGraph);
+  auto outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 1);
+  EXPECT_EQ(outputs[0], "x");
+  // The root, K x and an unbuilt cell for big.
+  EXPECT_EQ(interpreter.get_allocation_stats()[0].nodes, 3);
+}
+
+TEST_P(SkiInterpreterTest, TestCachedNormalFormsMatchUncached) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def second = S K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I second)))(c2 I first);
+def loop = S I I (S I I);
+
+(_2 fib (pair _1 _1)) first f x;
+(_2 fib (pair _1 _1)) second f x;
+(_2 fib (pair _1 _1)) first f x;
+add _2 _2;
+K x loop;
+)";
+  auto interpret = [&](size_t cache_bytes) {
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+    InterpreterOptions options;
+    options.engine = GetParam();
+    options.cache_bytes = cache_bytes;
+    options.cache_definition_steps = 1000;
+    Interpreter interpreter(parser.parse(), options);
+    auto outputs = interpreter.interpret_exprs();
+    // A second run of the same session reuses the normal forms of the first.
+    EXPECT_EQ(interpreter.interpret_exprs(), outputs);
+    return std::make_pair(outputs, interpreter.get_cache_stats());
+  };
+  auto [uncached, no_stats] = interpret(0);
+  ASSERT_EQ(uncached.size(), 5);
+  EXPECT_EQ(uncached[0], "(f (f (f x)))");
+  EXPECT_EQ(no_stats.hits, 0);
+  auto [cached, stats] = interpret(1 << 20);
+  EXPECT_EQ(cached, uncached);
+  EXPECT_GT(stats.hits, 0);
+  EXPECT_GT(stats.entries, 0);
+  EXPECT_LE(stats.bytes, 1 << 20);
+  // A cache too small for anything leaves the results alone.
+  auto [capped, capped_stats] = interpret(1);
+  EXPECT_EQ(capped, uncached);
+  EXPECT_EQ(capped_stats.entries, 0);
+}
+
+TEST_P(SkiInterpreterTest, TestCompiledProgramMatchesSource) {
+  std::string ski_program = R"(
+def c1 = S (K S) K;
+def c2 = S (c1 S (c1 K (c1 S (S (c1 c1 I) (K I)))))(K (c1 K I));
+def pair = c2 (c1 c1 (c1 c2 (c1 (c2 I) I)))I;
+def first = K;
+def second = S K;
+def _0  = S K;
+def inc = S (S (K S) K);
+def _1  = inc _0;
+def _2  = inc _1;
+def add = c2 ( c1 c1 ( c2 I inc) ) I;
+def fib = S (c1 pair (S (c1 add (c2 I first))(c2 I second)))(c2 I first);
+def unused = K free;
+
+(_2 fib (pair _1 _1)) first f x;
+add _2 _1;
+K x y;
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  Interpreter source(parser.parse(), options);
+  std::string path = ::testing::TempDir() + "compiled.skic";
+  source.compile(path);
+  auto expected = source.interpret_exprs();
+
+  ProgramImage image(path);
+  Interpreter compiled(image, options);
+  // Every definition is resolved when compiling, used or not.
+  EXPECT_EQ(compiled.get_resolved_definitions_map().size(), 12);
+  EXPECT_EQ(compiled.interpret_exprs(), expected);
+  EXPECT_EQ(expected[0], "(f (f (f x)))");
+}
+
+// Evaluates the statements of source one at a time, like a session does.
+static std::vector<std::string> extend(Interpreter& interpreter, const std::string& source) {
+  Tokenizer tokenizer(source, "session.ski", interpreter.get_symbols());
+  Parser parser(tokenizer, "session.ski");
+  std::vector<std::string> outputs;
+  while (auto statement = parser.parse_statement()) {
+    for (auto& output : interpreter.extend(std::move(statement)))
+      outputs.push_back(output);
+  }
+  return outputs;
+}
+
+TEST_P(SkiInterpreterTest, TestExtendEvaluatesOnlyNewExpressions) {
+  std::string ski_program = R"(
+def _0 = S K;
+def inc = S (S (K S) K);
+inc _0 f x;
+)";
+  Tokenizer tokenizer(ski_program, "prelude.ski");
+  Parser parser(tokenizer, "prelude.ski");
+  Interpreter interpreter(parser.parse(), GetParam());
+  EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"(f x)"});
+  EXPECT_EQ(extend(interpreter, "def _1 = inc _0; _1 f x; inc _1 f x;"),
+            (std::vector<std::string>{"(f x)", "(f (f x))"}));
+  EXPECT_EQ(extend(interpreter, "K y;"), std::vector<std::string>{"(K y)"});
+  EXPECT_EQ(interpreter.get_resolved_definitions_map().size(), 3);
+  // The whole program is still there to interpret again.
+  EXPECT_EQ(interpreter.interpret_exprs(),
+            (std::vector<std::string>{"(f x)", "(f x)", "(f (f x))", "(K y)"}));
+}
+
+TEST_P(SkiInterpreterTest, TestRedefinitionOnlyAppliesToLaterStatements) {
+  std::string ski_program = R"(
+def f = K;
+def g = f x;
+)";
+  Tokenizer tokenizer(ski_program, "prelude.ski");
+  Parser parser(tokenizer, "prelude.ski");
+  Interpreter interpreter(parser.parse(), GetParam());
+  // g is not resolved yet, but still sees the f it was defined with.
+  EXPECT_EQ(extend(interpreter, "def f = I; g y z; f y;"),
+            (std::vector<std::string>{"(x z)", "y"}));
+  EXPECT_EQ(extend(interpreter, "def g = f x; g;"), std::vector<std::string>{"x"});
+}
+
+TEST_P(SkiInterpreterTest, TestExtendCompiledProgram) {
+  std::string ski_program = R"(
+def _0 = S K;
+def inc = S (S (K S) K);
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  Tokenizer tokenizer(ski_program, "prelude.ski");
+  Parser parser(tokenizer, "prelude.ski");
+  Interpreter source(parser.parse(), options);
+  std::string path = ::testing::TempDir() + "prelude.skic";
+  source.compile(path);
+
+  ProgramImage image(path);
+  Interpreter compiled(image, options);
+  EXPECT_TRUE(compiled.interpret_exprs().empty());
+  EXPECT_EQ(extend(compiled, "def _1 = inc _0; inc _1 f x;"),
+            std::vector<std::string>{"(f (f x))"});
+}
+
+TEST_P(SkiInterpreterTest, TestReductionsAreCounted) {
+  std::string ski_program = R"(
+def id = S K K;
+id x;
+K y;
+)";
+  // S K is the zero jet, which would take a shortcut.
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.jets = false;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  std::vector<Term> exprs = interpreter.resolve_exprs();
+  ASSERT_EQ(exprs.size(), 2);
+  EXPECT_EQ(interpreter.reduce_exprs(exprs), (std::vector<std::string>{"x", "(K y)"}));
+  // S K K x = K x (K x) = x
+  auto& reductions = interpreter.get_reduction_stats();
+  ASSERT_EQ(reductions.size(), 2);
+  EXPECT_EQ(reductions[0].steps, 2);
+  EXPECT_EQ(reductions[1].steps, 0);
+  if constexpr (kStatsEnabled) {
+    EXPECT_EQ(reductions[0].rule_steps[static_cast<size_t>(TermKind::kS)], 1);
+    EXPECT_EQ(reductions[0].rule_steps[static_cast<size_t>(TermKind::kK)], 1);
+    EXPECT_EQ(reductions[0].jet_steps, 0);
+    EXPECT_EQ(reductions[0].final_nodes, 1);
+    EXPECT_EQ(reductions[1].final_nodes, 3);
+    const InterpreterStats& stats = interpreter.get_stats();
+    EXPECT_EQ(stats.reductions.steps, 2);
+    EXPECT_EQ(stats.exprs, 2);
+    EXPECT_EQ(stats.normal_form_sizes[0], 1);
+    EXPECT_EQ(stats.normal_form_sizes[1], 1);
+  }
+}
+
+TEST_P(SkiInterpreterTest, TestStepLimitStopsOnlyItsExpression) {
+  std::string ski_program = R"(
+S I I (S I I);
+K x (I y);
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.budget.max_steps = 100;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  std::vector<std::string> outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 2);
+  EXPECT_EQ(outputs[1], "x");
+  EXPECT_EQ(interpreter.get_statuses(),
+            (std::vector<EvalStatus>{EvalStatus::kStepLimit, EvalStatus::kNormalForm}));
+  EXPECT_EQ(interpreter.get_reduction_stats()[0].steps, 100);
+  EXPECT_NE(outputs[0].find("((S I) I)"), std::string::npos);
+  if constexpr (kStatsEnabled) {
+    // Only x, of a single node, is a normal form.
+    const InterpreterStats& stats = interpreter.get_stats();
+    EXPECT_EQ(stats.normal_form_sizes[0], 1);
+    for (size_t bucket = 1; bucket < stats.normal_form_sizes.size(); bucket++)
+      EXPECT_EQ(stats.normal_form_sizes[bucket], 0);
+    EXPECT_GT(interpreter.get_reduction_stats()[0].final_nodes, 1);
+  }
+}
+
+TEST_P(SkiInterpreterTest, TestNodeLimitStopsExplodingTerm) {
+  // Each step of S S I (S S I) ... copies a growing argument.
+  std::string ski_program = R"(
+def grow = S (S I I) (S I I);
+grow grow;
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.budget.max_nodes = 1000;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  std::vector<std::string> outputs = interpreter.interpret_exprs();
+  EXPECT_EQ(interpreter.get_statuses(), std::vector<EvalStatus>{EvalStatus::kNodeLimit});
+  EXPECT_FALSE(outputs[0].empty());
+}
+
+TEST_P(SkiInterpreterTest, TestCancelledEvaluation) {
+  std::string ski_program = R"(S I I (S I I);)";
+  CancellationToken token;
+  token.cancel();
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.budget.cancellation = &token;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  interpreter.interpret_exprs();
+  EXPECT_EQ(interpreter.get_statuses(), std::vector<EvalStatus>{EvalStatus::kCancelled});
+}
+
+TEST_P(SkiInterpreterTest, TestCycleStopsDivergentTerm) {
+  // w w -> C I w (I w) -> I (I w) w -> I w w -> w w for w = S (C I) I, on every engine.
+  std::string ski_program = R"(
+def w = S (C I) I;
+w w;
+S K K x;
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.budget.detect_cycles = true;
+  options.budget.max_steps = 100000;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  std::vector<std::string> outputs = interpreter.interpret_exprs();
+  ASSERT_EQ(outputs.size(), 2);
+  EXPECT_EQ(outputs[1], "x");
+  EXPECT_EQ(interpreter.get_statuses(),
+            (std::vector<EvalStatus>{EvalStatus::kCycle, EvalStatus::kNormalForm}));
+  EXPECT_EQ(interpreter.get_cycles()[0].length, 4);
+  EXPECT_LT(interpreter.get_reduction_stats()[0].steps, 100);
+}
+
+TEST_P(SkiInterpreterTest, TestAssertionsCompareNormalForms) {
+  std::string ski_program = R"(
+def inc  = S (S (K S) K);
+def _0   = S K;
+def _1   = inc _0;
+def _2   = inc _1;
+def swap = S (K (S I)) K;
+
+assert_eq (_2 f x) (f (f x));
+assert_eq (_1 _2 f x) (_2 f x);
+assert_eq (_2 f x) (f x);
+_2 f x;
+assert_eq (swap a b) (b a);
+assert_eq x x;
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"(f (f x))"});
+  auto& results = interpreter.get_assertion_results();
+  ASSERT_EQ(results.size(), 5);
+  std::vector<bool> passed;
+  for (auto& result : results) {
+    passed.push_back(result.passed);
+    EXPECT_EQ(result.status, EvalStatus::kNormalForm);
+  }
+  EXPECT_EQ(passed, (std::vector<bool>{true, true, false, true, true}));
+  EXPECT_EQ(results[0].line, 8);
+  EXPECT_EQ(results[3].line, 12);
+
+  extend(interpreter, "def k = K; assert_eq (k a b) a;");
+  ASSERT_EQ(interpreter.get_assertion_results().size(), 1);
+  EXPECT_TRUE(interpreter.get_assertion_results()[0].passed);
+}
+
+TEST_P(SkiInterpreterTest, TestAssertionsWithinBudget) {
+  std::string ski_program = R"(assert_eq (S I I (S I I)) x; assert_eq (K x y) x;)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  options.budget.max_steps = 100;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  interpreter.interpret_exprs();
+  auto& results = interpreter.get_assertion_results();
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_FALSE(results[0].passed);
+  EXPECT_EQ(results[0].status, EvalStatus::kStepLimit);
+  EXPECT_TRUE(results[1].passed);
+}
+
+TEST_P(SkiInterpreterTest, TestCompiledProgramKeepsItsAssertions) {
+  std::string ski_program = R"(
+def swap = S (K (S I)) K;
+assert_eq (swap a b) (b a);
+assert_eq (swap a b) (a b);
+)";
+  InterpreterOptions options;
+  options.engine = GetParam();
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter source(parser.parse(), options);
+  std::string path = ::testing::TempDir() + "assertions.skic";
+  source.compile(path);
+
+  ProgramImage image(path);
+  Interpreter compiled(image, options);
+  EXPECT_TRUE(compiled.interpret_exprs().empty());
+  auto& results = compiled.get_assertion_results();
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_TRUE(results[0].passed);
+  EXPECT_FALSE(results[1].passed);
+  EXPECT_EQ(results[1].line, 4);
+  // Additions only check their own assertions.
+  extend(compiled, "assert_eq (I a) a;");
+  ASSERT_EQ(compiled.get_assertion_results().size(), 1);
+  EXPECT_TRUE(compiled.get_assertion_results()[0].passed);
+}
+
+TEST(SkiTreeStrategyTest, TestBudgetsLeaveValidPartialTerms) {
+  std::string ski_program = R"(
+def two = S (S (K S) K) (S (S (K S) K) (S K));
+two two two f x;
+)";
+  for (Strategy strategy : {Strategy::kFullPass, Strategy::kLeftmostOutermost,
+                            Strategy::kLeftmostInnermost}) {
+    for (size_t max_steps = 1; max_steps < 60; max_steps += 7) {
+      InterpreterOptions options;
+      options.strategy = strategy;
+      options.budget.max_steps = max_steps;
+      Tokenizer tokenizer(ski_program, "test.ski");
+      Parser parser(tokenizer, "test.ski");
+      Interpreter interpreter(parser.parse(), options);
+      std::vector<std::string> partial = interpreter.interpret_exprs();
+      ASSERT_EQ(interpreter.get_statuses()[0], EvalStatus::kStepLimit);
+      EXPECT_LE(interpreter.get_reduction_stats()[0].steps, max_steps);
+      // Reducing the partial term finishes the job.
+      std::string rest_program = partial[0] + ";";
+      Tokenizer rest_tokenizer(rest_program, "rest.ski");
+      Parser rest_parser(rest_tokenizer, "rest.ski");
+      Interpreter rest(rest_parser.parse(), Engine::kTree);
+      EXPECT_EQ(rest.interpret_exprs(), std::vector<std::string>{"(f (f (f (f (f (f (f (f "
+                                                                 "(f (f (f (f (f (f (f (f x)))))"
+                                                                 ")))))))))))"});
+    }
+  }
+}
+
+static const Strategy kStrategies[] = {Strategy::kFullPass, Strategy::kLeftmostOutermost,
+                                       Strategy::kLeftmostInnermost};
+
+TEST(SkiTreeStrategyTest, TestStrategiesReachTheSameNormalForm) {
+  std::string ski_program = R"(
+def zero = S K;
+def inc = S (S (K S) K);
+def two = inc (inc zero);
+two two f x;
+B (C K x) (S I I) y;
+S (K (S I)) K a b;
+)";
+  std::vector<std::string> expected;
+  for (Strategy strategy : kStrategies) {
+    InterpreterOptions options;
+    options.strategy = strategy;
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(tokenizer, "test.ski");
+    Interpreter interpreter(parser.parse(), options);
+    std::vector<std::string> outputs = interpreter.interpret_exprs();
+    if (expected.empty())
+      expected = outputs;
+    EXPECT_EQ(outputs, expected);
+  }
+  EXPECT_EQ(expected, (std::vector<std::string>{"(f (f (f (f x))))", "(y y)", "(b a)"}));
+}
+
+TEST(SkiTreeStrategyTest, TestOnlyInnermostReducesDiscardedArguments) {
+  std::string ski_program = R"(K x (I y);)";
+  std::vector<size_t> steps;
+  for (Strategy strategy : kStrategies) {
+    InterpreterOptions options;
+    options.strategy = strategy;
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(tokenizer, "test.ski");
+    Interpreter interpreter(parser.parse(), options);
+    EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"x"});
+    steps.push_back(interpreter.get_reduction_stats()[0].steps);
+  }
+  // The full pass reduces the argument in the same pass that discards it.
+  EXPECT_EQ(steps, (std::vector<size_t>{2, 1, 2}));
+}
+
+TEST(SkiTreeStrategyTest, TestOutermostDiscardsDivergentArgument) {
+  std::string ski_program = R"(K I (S I I (S I I)) x;)";
+  InterpreterOptions options;
+  options.strategy = Strategy::kLeftmostOutermost;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"x"});
+  EXPECT_EQ(interpreter.get_reduction_stats()[0].steps, 2);
+}
+
+TEST(SkiTreeStrategyTest, TestCyclesPerStrategy) {
+  // Outermost reduction of S I I (S I I) keeps wrapping the argument in I, so it never repeats.
+  std::string ski_program = R"(S I I (S I I); S (C I) I (S (C I) I);)";
+  std::vector<EvalStatus> statuses;
+  std::vector<size_t> lengths;
+  for (Strategy strategy : kStrategies) {
+    InterpreterOptions options;
+    options.strategy = strategy;
+    options.budget.detect_cycles = true;
+    options.budget.max_steps = 10000;
+    Tokenizer tokenizer(ski_program, "test.ski");
+    Parser parser(tokenizer, "test.ski");
+    Interpreter interpreter(parser.parse(), options);
+    interpreter.interpret_exprs();
+    for (size_t i = 0; i < 2; i++) {
+      statuses.push_back(interpreter.get_statuses()[i]);
+      lengths.push_back(interpreter.get_cycles()[i].length);
+    }
+  }
+  EXPECT_EQ(statuses, (std::vector<EvalStatus>{EvalStatus::kCycle, EvalStatus::kCycle,
+                                               EvalStatus::kStepLimit, EvalStatus::kCycle,
+                                               EvalStatus::kCycle, EvalStatus::kCycle}));
+  EXPECT_EQ(lengths, (std::vector<size_t>{3, 4, 0, 4, 3, 4}));
+}
+
+TEST(SkiTreeStrategyTest, TestInnermostLoopDoesNotGrowTheStack) {
+  std::string ski_program = R"(S I I (S I I);)";
+  InterpreterOptions options;
+  options.strategy = Strategy::kLeftmostInnermost;
+  options.budget.max_steps = 3000000;
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), options);
+  interpreter.interpret_exprs();
+  EXPECT_EQ(interpreter.get_statuses(), std::vector<EvalStatus>{EvalStatus::kStepLimit});
+}
+
+TEST(SkiTreeStrategyTest, TestStrategyPerExpression) {
+  std::string ski_program = R"(
+def dup = S I I;
+dup (I y);
+dup (I y);
+K x (I y);
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), Engine::kTree);
+  std::vector<Term> exprs = interpreter.resolve_exprs();
+  // The last expression falls back to the full pass of the options.
+  EXPECT_EQ(interpreter.reduce_exprs(exprs, {Strategy::kLeftmostOutermost,
+                                             Strategy::kLeftmostInnermost}),
+            (std::vector<std::string>{"(y y)", "(y y)", "x"}));
+  auto& reductions = interpreter.get_reduction_stats();
+  ASSERT_EQ(reductions.size(), 3);
+  // Normal order reduces the copied argument twice, applicative order once.
+  EXPECT_EQ(reductions[0].steps, 5);
+  EXPECT_EQ(reductions[1].steps, 4);
+  EXPECT_EQ(reductions[2].steps, 2);
+}
+
+TEST(SkiGraphInterpreterTest, TestJetStepsAreCounted) {
+  if constexpr (!kStatsEnabled)
+    GTEST_SKIP() << "Built without SKI_ENABLE_STATS.";
+  std::string ski_program = R"(
+def zero = S K;
+zero f x;
+)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), Engine::kGraph);
+  EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"x"});
+  auto& reductions = interpreter.get_reduction_stats();
+  ASSERT_EQ(reductions.size(), 1);
+  EXPECT_GT(reductions[0].jet_steps, 0);
+  EXPECT_GT(reductions[0].peak_nodes, 0);
+}
+
+TEST(SkiGraphInterpreterTest, TestSharedCellsCountOnce) {
+  if constexpr (!kStatsEnabled)
+    GTEST_SKIP() << "Built without SKI_ENABLE_STATS.";
+  std::string ski_program = "S I I (f x);";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(tokenizer, "test.ski");
+  Interpreter interpreter(parser.parse(), Engine::kGraph);
+  EXPECT_EQ(interpreter.interpret_exprs(), std::vector<std::string>{"((f x) (f x))"});
+  // Both halves are the one cell of f x, which prints twice but is counted once.
+  EXPECT_EQ(interpreter.get_reduction_stats()[0].final_nodes, 4);
+}
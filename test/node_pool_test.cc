@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "node_pool.h"
+
+using namespace Ski;
+
+TEST(SkiNodePoolTest, TestFreedNodesAreReused) {
+  void* first = NodePool::allocate(24);
+  NodePool::deallocate(first, 24);
+  void* second = NodePool::allocate(24);
+  EXPECT_EQ(first, second);
+  NodePool::deallocate(second, 24);
+}
+
+TEST(SkiNodePoolTest, TestStatsCountAllocations) {
+  AllocationStats before = NodePool::get_stats();
+  void* small = NodePool::allocate(16);
+  void* large = NodePool::allocate(100);
+  AllocationStats after = NodePool::get_stats();
+  EXPECT_EQ(after.nodes - before.nodes, 2);
+  EXPECT_EQ(after.bytes - before.bytes, 116);
+  NodePool::deallocate(small, 16);
+  NodePool::deallocate(large, 100);
+}
+
+TEST(SkiNodePoolTest, TestNodesOutliveTheirThread) {
+  void* pointer = nullptr;
+  std::thread([&] { pointer = NodePool::allocate(32); }).join();
+  static_cast<char*>(pointer)[31] = 'x';
+  NodePool::deallocate(pointer, 32);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include "normal_form_cache.h"
+#include "term_store.h"
+
+using namespace Ski;
+
+TEST(SkiNormalFormCacheTest, TestFindReturnsInsertedNormalForm) {
+  TermStore store;
+  NormalFormCache cache(1 << 20);
+  Term ix = store.app(store.i(), store.var("x"));
+  EXPECT_FALSE(cache.find(ix));
+  EXPECT_TRUE(cache.insert(ix, store.var("x")));
+  ASSERT_TRUE(cache.find(ix));
+  EXPECT_EQ(*cache.find(ix), store.var("x"));
+  EXPECT_EQ(cache.get_stats().entries, 1);
+}
+
+TEST(SkiNormalFormCacheTest, TestTermsInNormalFormAreNotStored) {
+  TermStore store;
+  NormalFormCache cache(1 << 20);
+  Term kx = store.app(store.k(), store.var("x"));
+  EXPECT_TRUE(cache.insert(kx, kx));
+  EXPECT_FALSE(cache.find(kx));
+  EXPECT_EQ(cache.get_stats().entries, 0);
+}
+
+TEST(SkiNormalFormCacheTest, TestFullCacheDropsNewEntries) {
+  TermStore store;
+  NormalFormCache cache(64);
+  Term x = store.var("x");
+  Term ix = store.app(store.i(), x);
+  EXPECT_TRUE(cache.insert(ix, x));
+  cache.count_terms(1);
+  EXPECT_TRUE(cache.is_full());
+  Term kxy = store.app(store.app(store.k(), x), store.var("y"));
+  EXPECT_FALSE(cache.insert(kxy, x));
+  EXPECT_FALSE(cache.find(kxy));
+  // Entries stored before the cap was reached stay.
+  EXPECT_TRUE(cache.find(ix));
+}
+
+TEST(SkiNormalFormCacheTest, TestCountsHitsAndMisses) {
+  NormalFormCache cache(1 << 20);
+  cache.count(3, 1);
+  cache.count(2, 0);
+  EXPECT_EQ(cache.get_stats().hits, 5);
+  EXPECT_EQ(cache.get_stats().misses, 1);
+}
@@ -100,3 +100,140 @@ def _1 = (inc _0);
 )",
       std::string(*ski_ast).c_str());
 }
+
+TEST(SkiParserTest, TestExtendedCombinators) {
+  std::string ski_program = R"(S' C (B* K) C' (B I) x;)";
+  Tokenizer tokenizer(ski_program, "exprs.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "exprs.ski");
+  auto ski_ast = parser.parse();
+  EXPECT_STREQ(R"(
+(((((S' C) (B* K)) C') (B I)) x);
+)",
+               std::string(*ski_ast).c_str());
+}
+
+TEST(SkiParserTest, TestParsePullsFromTokenizer) {
+  std::string ski_program = R"(
+def _0 = S K;  # zero
+_0 f x;
+)";
+  Tokenizer tokenizer(ski_program, "pull.ski");
+  Parser parser(tokenizer, "pull.ski");
+  auto ski_ast = parser.parse();
+  ASSERT_NE(ski_ast, nullptr);
+  EXPECT_STREQ(R"(def _0 = (S K);
+
+((_0 f) x);
+)",
+               std::string(*ski_ast).c_str());
+}
+
+TEST(SkiParserTest, TestMissingSemiColonAtEnd) {
+  std::string ski_program = "S K";
+  Tokenizer tokenizer(ski_program, "missing.ski");
+  Parser parser(tokenizer, "missing.ski");
+  EXPECT_EQ(parser.parse(), nullptr);
+}
+
+TEST(SkiParserTest, TestDefinitionsAreIndexedBySymbol) {
+  std::string ski_program = R"(
+def f = K;
+def g = f x;
+def f = I;
+g f;
+)";
+  Tokenizer tokenizer(ski_program, "symbols.ski");
+  Parser parser(tokenizer, "symbols.ski");
+  auto ski_ast = parser.parse();
+  ASSERT_NE(ski_ast, nullptr);
+  Symbol f = *ski_ast->get_symbols()->find("f");
+  ASSERT_EQ(ski_ast->get_ordered_defs().size(), 3);
+  EXPECT_EQ(ski_ast->get_ordered_defs()[0], f);
+  EXPECT_EQ(ski_ast->get_ordered_defs()[2], f);
+  // A redefinition replaces the body.
+  EXPECT_EQ(std::string(*ski_ast->get_definition(f)), "I");
+  EXPECT_EQ(ski_ast->get_definition("x"), nullptr);
+  auto use = static_cast<const App*>(ski_ast->get_exprs()[0].get());
+  EXPECT_EQ(static_cast<const Var*>(use->get_right())->get_symbol(), f);
+}
+
+TEST(SkiParserTest, TestDefinitionWithoutName) {
+  std::string ski_program = "def a = S;\ndef = K;\na x y;";
+  Tokenizer tokenizer(ski_program, "nameless.ski");
+  Parser parser(tokenizer, "nameless.ski");
+  auto ski_ast = parser.parse();
+  ASSERT_NE(ski_ast, nullptr);
+  // The nameless definition defines the empty identifier and leaves a alone.
+  EXPECT_EQ(std::string(*ski_ast->get_definition("a")), "S");
+  EXPECT_EQ(std::string(*ski_ast->get_definition("")), "K");
+  ASSERT_EQ(ski_ast->get_ordered_defs().size(), 2);
+  EXPECT_NE(ski_ast->get_ordered_defs()[0], ski_ast->get_ordered_defs()[1]);
+}
+
+TEST(SkiParserTest, TestParseStatementsInAnyOrder) {
+  std::string ski_program = "f x; def f = K; f x y;";
+  Tokenizer tokenizer(ski_program, "statements.ski");
+  Parser parser(tokenizer, "statements.ski");
+  auto program = parser.parse_statement();
+  ASSERT_NE(program, nullptr);
+  EXPECT_EQ(program->get_exprs().size(), 1);
+  while (auto statement = parser.parse_statement())
+    program->append(std::move(*statement));
+  EXPECT_STREQ(R"(def f = K;
+
+(f x);
+((f x) y);
+)",
+               std::string(*program).c_str());
+  EXPECT_NE(program->get_definition("f"), nullptr);
+}
+
+TEST(SkiParserTest, TestAppendNeedsSharedSymbols) {
+  Tokenizer first_tokenizer("x;", "first.ski");
+  Tokenizer second_tokenizer("y;", "second.ski");
+  auto first = Parser(first_tokenizer, "first.ski").parse();
+  auto second = Parser(second_tokenizer, "second.ski").parse();
+  EXPECT_THROW(first->append(std::move(*second)), std::runtime_error);
+}
+
+TEST(SkiParserTest, TestAssertionsBetweenExpressions) {
+  std::string ski_program = "def f = K;\nf x;\nassert_eq (f x y) x;\nassert_eq I (S K K); y;";
+  Tokenizer tokenizer(ski_program, "assert.ski");
+  Parser parser(tokenizer, "assert.ski");
+  auto ski_ast = parser.parse();
+  ASSERT_NE(ski_ast, nullptr);
+  EXPECT_EQ(ski_ast->get_exprs().size(), 2);
+  ASSERT_EQ(ski_ast->get_assertions().size(), 2);
+  EXPECT_EQ(ski_ast->get_assertions()[0]->get_line(), 3);
+  EXPECT_EQ(ski_ast->get_assertions()[1]->get_line(), 4);
+  EXPECT_STREQ(R"(def f = K;
+
+(f x);
+y;
+assert_eq ((f x) y) x;
+assert_eq I ((S K) K);
+)",
+               std::string(*ski_ast).c_str());
+}
+
+TEST(SkiParserTest, TestAssertionTakesTwoSubexpressions) {
+  std::string ski_program = "assert_eq f x y;";
+  Tokenizer tokenizer(ski_program, "assert.ski");
+  Parser parser(tokenizer, "assert.ski");
+  EXPECT_EQ(parser.parse(), nullptr);
+}
+
+TEST(SkiParserTest, TestMaterializedTokensReportTheEndLikePulledOnes) {
+  std::string ski_program = "def a = S;\na K\n";
+  Tokenizer pulling_tokenizer(ski_program, "end.ski");
+  testing::internal::CaptureStdout();
+  EXPECT_EQ(Parser(pulling_tokenizer, "end.ski").parse(), nullptr);
+  std::string pulled = testing::internal::GetCapturedStdout();
+  EXPECT_EQ(pulled, "end.ski:3:1: Expected: ';'\n");
+  Tokenizer tokenizer(ski_program, "end.ski");
+  auto tokens = tokenizer.tokenize();
+  Token end = tokenizer.next();
+  testing::internal::CaptureStdout();
+  EXPECT_EQ(Parser(std::move(tokens), "end.ski", end).parse(), nullptr);
+  EXPECT_EQ(testing::internal::GetCapturedStdout(), pulled);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "program_image.h"
+#include "term_store.h"
+
+using namespace Ski;
+
+static std::string temp_path(const std::string& name) { return ::testing::TempDir() + name; }
+
+TEST(SkiProgramImageTest, TestLoadedTermsKeepTheirHandles) {
+  Tokenizer tokenizer("def one = S (S (K S) K) (S K); one f x; K y;", "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  TermStore store;
+  Term one = store.intern(*ski_ast->get_definition("one"));
+  std::unordered_map<std::string, Term> definitions{{"one", one}};
+  std::vector<Term> exprs;
+  for (auto& expr : ski_ast->get_exprs())
+    exprs.push_back(store.intern(*expr, &definitions));
+  std::string path = temp_path("handles.skic");
+  write_program_image(path, store, exprs, {{"one", one}}, {{7, exprs[0], exprs[1]}});
+
+  ASSERT_TRUE(ProgramImage::is_image(path));
+  ProgramImage image(path);
+  TermStore loaded;
+  image.load(loaded);
+  EXPECT_EQ(loaded.size(), store.size());
+  EXPECT_EQ(image.get_exprs(), exprs);
+  ASSERT_EQ(image.get_definitions().size(), 1);
+  EXPECT_EQ(image.get_definitions()[0].first, "one");
+  EXPECT_EQ(image.get_definitions()[0].second, one);
+  ASSERT_EQ(image.get_assertions().size(), 1);
+  EXPECT_EQ(image.get_assertions()[0].line, 7);
+  EXPECT_EQ(image.get_assertions()[0].left, exprs[0]);
+  EXPECT_EQ(image.get_assertions()[0].right, exprs[1]);
+  for (Term expr : exprs)
+    EXPECT_EQ(loaded.to_string(expr), store.to_string(expr));
+  // Loaded terms are hash-consed like any other.
+  EXPECT_EQ(loaded.app(loaded.k(), loaded.var("y")), exprs[1]);
+}
+
+TEST(SkiProgramImageTest, TestSourceIsNotAnImage) {
+  std::string path = temp_path("source.ski");
+  std::ofstream(path) << "S K K x;\n";
+  EXPECT_FALSE(ProgramImage::is_image(path));
+  EXPECT_THROW(ProgramImage image(path), std::runtime_error);
+}
+
+TEST(SkiProgramImageTest, TestTruncatedImageIsRejected) {
+  TermStore store;
+  Term expr = store.app(store.i(), store.var("x"));
+  std::string path = temp_path("truncated.skic");
+  write_program_image(path, store, {expr}, {});
+  std::string bytes;
+  {
+    std::ifstream image(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(image), {});
+  }
+  std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size() - 4);
+  EXPECT_TRUE(ProgramImage::is_image(path));
+  EXPECT_THROW(ProgramImage image(path), std::runtime_error);
+}
+
+TEST(SkiProgramImageTest, TestOutOfRangeHandleIsRejected) {
+  TermStore store;
+  Term expr = store.app(store.i(), store.var("x"));
+  std::string path = temp_path("corrupt.skic");
+  write_program_image(path, store, {expr}, {});
+  // Point the expression past the last term.
+  std::fstream image(path, std::ios::binary | std::ios::in | std::ios::out);
+  image.seekp(sizeof(ProgramImageHeader) + store.size() * sizeof(ProgramImageNode));
+  uint32_t handle = store.size();
+  image.write(reinterpret_cast<const char*>(&handle), sizeof(handle));
+  image.close();
+  EXPECT_THROW(ProgramImage corrupt(path), std::runtime_error);
+}
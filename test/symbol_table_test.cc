@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+
+#include "symbol_table.h"
+
+using namespace Ski;
+
+TEST(SkiSymbolTableTest, TestSymbolsAreDense) {
+  SymbolTable symbols;
+  EXPECT_EQ(symbols.intern("x"), 0);
+  EXPECT_EQ(symbols.intern("y"), 1);
+  EXPECT_EQ(symbols.intern("x"), 0);
+  EXPECT_EQ(symbols.size(), 2);
+  EXPECT_EQ(symbols.name(1), "y");
+}
+
+TEST(SkiSymbolTableTest, TestFindDoesNotIntern) {
+  SymbolTable symbols;
+  symbols.intern("x");
+  EXPECT_EQ(symbols.find("x"), 0);
+  EXPECT_FALSE(symbols.find("y"));
+  EXPECT_EQ(symbols.size(), 1);
+}
+
+TEST(SkiSymbolTableTest, TestNamesStayValidAsTheTableGrows) {
+  SymbolTable symbols;
+  const std::string& first = symbols.name(symbols.intern("first"));
+  for (int i = 0; i < 10000; i++)
+    symbols.intern("x" + std::to_string(i));
+  EXPECT_EQ(first, "first");
+  EXPECT_EQ(symbols.find("x9999"), 10000);
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include "task_scheduler.h"
+
+using namespace Ski;
+
+static long fib(TaskScheduler& scheduler, int n) {
+  if (n < 2)
+    return n;
+  long first = 0;
+  long second = 0;
+  scheduler.fork_join([&] { first = fib(scheduler, n - 1); },
+                      [&] { second = fib(scheduler, n - 2); });
+  return first + second;
+}
+
+TEST(SkiTaskSchedulerTest, TestNestedForkJoin) {
+  TaskScheduler scheduler(4);
+  long result = 0;
+  scheduler.run([&] { result = fib(scheduler, 20); });
+  EXPECT_EQ(result, 6765);
+}
+
+TEST(SkiTaskSchedulerTest, TestForkJoinOutsideRunIsInline) {
+  TaskScheduler scheduler(4);
+  std::thread::id caller = std::this_thread::get_id();
+  std::thread::id first;
+  std::thread::id second;
+  scheduler.fork_join([&] { first = std::this_thread::get_id(); },
+                      [&] { second = std::this_thread::get_id(); });
+  EXPECT_EQ(first, caller);
+  EXPECT_EQ(second, caller);
+}
+
+TEST(SkiTaskSchedulerTest, TestForkedTasksAreStolen) {
+  TaskScheduler scheduler(2);
+  ASSERT_EQ(scheduler.size(), 2);
+  // The second branch waits for the first, which only finishes if another worker steals it.
+  std::atomic<bool> first_done = false;
+  scheduler.run([&] {
+    scheduler.fork_join([&] { first_done = true; },
+                        [&] {
+                          while (!first_done)
+                            std::this_thread::yield();
+                        });
+  });
+  EXPECT_TRUE(first_done);
+}
+
+TEST(SkiTaskSchedulerTest, TestExceptionIsRethrown) {
+  TaskScheduler scheduler(3);
+  std::atomic<int> calls = 0;
+  EXPECT_THROW(scheduler.run([&] {
+    scheduler.fork_join([&] { throw std::runtime_error("failed"); }, [&] { calls++; });
+  }),
+               std::runtime_error);
+  EXPECT_EQ(calls, 1);
+  long result = 0;
+  scheduler.run([&] { result = fib(scheduler, 10); });
+  EXPECT_EQ(result, 55);
+}
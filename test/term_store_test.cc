@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "term_store.h"
+
+using namespace Ski;
+
+TEST(SkiTermStoreTest, TestCombinatorsAreCanonical) {
+  TermStore store;
+  EXPECT_EQ(store.kind(store.s()), TermKind::kS);
+  EXPECT_EQ(store.kind(store.k()), TermKind::kK);
+  EXPECT_EQ(store.kind(store.i()), TermKind::kI);
+  EXPECT_NE(store.s(), store.k());
+  EXPECT_NE(store.k(), store.i());
+}
+
+TEST(SkiTermStoreTest, TestVariablesAreShared) {
+  TermStore store;
+  Term x = store.var("x");
+  EXPECT_EQ(x, store.var("x"));
+  EXPECT_NE(x, store.var("y"));
+  EXPECT_EQ(store.identifier(x), "x");
+}
+
+TEST(SkiTermStoreTest, TestApplicationsAreShared) {
+  TermStore store;
+  Term sk = store.app(store.s(), store.k());
+  size_t size = store.size();
+  EXPECT_EQ(sk, store.app(store.s(), store.k()));
+  EXPECT_EQ(store.size(), size);
+  EXPECT_NE(sk, store.app(store.k(), store.s()));
+  EXPECT_EQ(store.left(sk), store.s());
+  EXPECT_EQ(store.right(sk), store.k());
+}
+
+TEST(SkiTermStoreTest, TestInternSharesIdenticalSubterms) {
+  std::string ski_program = R"((S K (S K)) (S K (S K));)";
+  Tokenizer tokenizer(ski_program, "test.ski");
+  Parser parser(std::move(tokenizer.tokenize()), "test.ski");
+  auto ski_ast = parser.parse();
+  TermStore store;
+  size_t size = store.size();
+  Term term = store.intern(*ski_ast->get_exprs()[0]);
+  EXPECT_EQ(store.left(term), store.right(term));
+  // (S K), ((S K) (S K)) and the root.
+  EXPECT_EQ(store.size(), size + 3);
+  EXPECT_EQ(store.to_string(term), "(((S K) (S K)) ((S K) (S K)))");
+  EXPECT_EQ(static_cast<std::string>(*store.to_expr(term)), store.to_string(term));
+}
+
+TEST(SkiTermStoreTest, TestDeepTermsConvertToExpressions) {
+  TermStore store;
+  Term term = store.var("x");
+  for (int i = 0; i < 300000; i++)
+    term = store.app(store.i(), term);
+  auto expr = store.to_expr(term);
+  EXPECT_EQ(expr->get_size(), 2 * 300000 + 1);
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+using namespace Ski;
+
+TEST(SkiThreadPoolTest, TestEveryIterationRunsOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<int>> calls(1000);
+  pool.parallel_for(calls.size(), [&](size_t i) { calls[i]++; });
+  for (auto& count : calls)
+    EXPECT_EQ(count, 1);
+}
+
+TEST(SkiThreadPoolTest, TestLoopsCanBeReused) {
+  ThreadPool pool(3);
+  std::atomic<size_t> sum = 0;
+  for (int loop = 0; loop < 100; loop++)
+    pool.parallel_for(10, [&](size_t i) { sum += i; });
+  EXPECT_EQ(sum, 100 * 45);
+  pool.parallel_for(0, [&](size_t) { sum = 0; });
+  EXPECT_EQ(sum, 100 * 45);
+}
+
+TEST(SkiThreadPoolTest, TestIterationsRunConcurrently) {
+  ThreadPool pool(4);
+  ASSERT_EQ(pool.size(), 4);
+  // Every iteration waits until all four have started, which only finishes if they overlap.
+  std::atomic<int> started = 0;
+  pool.parallel_for(4, [&](size_t) {
+    started++;
+    while (started < 4)
+      std::this_thread::yield();
+  });
+  EXPECT_EQ(started, 4);
+}
+
+TEST(SkiThreadPoolTest, TestExceptionIsRethrown) {
+  ThreadPool pool(2);
+  std::atomic<int> calls = 0;
+  EXPECT_THROW(pool.parallel_for(8,
+                                 [&](size_t i) {
+                                   calls++;
+                                   if (i == 3)
+                                     throw std::runtime_error("failed");
+                                 }),
+               std::runtime_error);
+  EXPECT_EQ(calls, 8);
+}
@@ -28,6 +28,46 @@ TEST(SkiTokenizerTest, TestICombinatorToken) {
   ASSERT_EQ(tokens->at(0).lexeme, "I");
 }
 
+TEST(SkiTokenizerTest, TestBCombinatorToken) {
+  Tokenizer tokenizer("B", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 1);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kBCombinator);
+  ASSERT_EQ(tokens->at(0).lexeme, "B");
+}
+
+TEST(SkiTokenizerTest, TestCCombinatorToken) {
+  Tokenizer tokenizer("C", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 1);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kCCombinator);
+  ASSERT_EQ(tokens->at(0).lexeme, "C");
+}
+
+TEST(SkiTokenizerTest, TestSPrimeCombinatorToken) {
+  Tokenizer tokenizer("S'", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 1);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kSPrimeCombinator);
+  ASSERT_EQ(tokens->at(0).lexeme, "S'");
+}
+
+TEST(SkiTokenizerTest, TestBStarCombinatorToken) {
+  Tokenizer tokenizer("B*", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 1);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kBStarCombinator);
+  ASSERT_EQ(tokens->at(0).lexeme, "B*");
+}
+
+TEST(SkiTokenizerTest, TestCPrimeCombinatorToken) {
+  Tokenizer tokenizer("C'", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 1);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kCPrimeCombinator);
+  ASSERT_EQ(tokens->at(0).lexeme, "C'");
+}
+
 TEST(SkiTokenizerTest, TestDefinitionToken) {
   Tokenizer tokenizer("def", "test");
   auto tokens = tokenizer.tokenize();
@@ -36,6 +76,15 @@ TEST(SkiTokenizerTest, TestDefinitionToken) {
   ASSERT_EQ(tokens->at(0).lexeme, "def");
 }
 
+TEST(SkiTokenizerTest, TestAssertEqToken) {
+  Tokenizer tokenizer("assert_eq assert_eqs", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 2);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kAssertEq);
+  ASSERT_EQ(tokens->at(0).lexeme, "assert_eq");
+  ASSERT_EQ(tokens->at(1).kind, Kind::kIdentifier);
+}
+
 TEST(SkiTokenizerTest, TestIdentifierToken) {
   Tokenizer tokenizer("inc", "test");
   auto tokens = tokenizer.tokenize();
@@ -143,3 +192,61 @@ TEST(SkiTokenizerTest, TestTokensForADefinition) {
   ASSERT_EQ(tokens->at(5).kind, Kind::kSemiColon);
   ASSERT_EQ(tokens->at(5).lexeme, ";");
 }
+
+TEST(SkiTokenizerTest, TestTokensForExtendedCombinators) {
+  Tokenizer tokenizer("S'SB*BC'C", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 6);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kSPrimeCombinator);
+  ASSERT_EQ(tokens->at(1).kind, Kind::kSCombinator);
+  ASSERT_EQ(tokens->at(2).kind, Kind::kBStarCombinator);
+  ASSERT_EQ(tokens->at(3).kind, Kind::kBCombinator);
+  ASSERT_EQ(tokens->at(4).kind, Kind::kCPrimeCombinator);
+  ASSERT_EQ(tokens->at(4).column, 6);
+  ASSERT_EQ(tokens->at(5).kind, Kind::kCCombinator);
+  ASSERT_EQ(tokens->at(5).column, 8);
+}
+
+TEST(SkiTokenizerTest, TestWhitespaceAndCommentsAreSkipped) {
+  Tokenizer tokenizer("# leading comment\n  S\t(K # trailing comment\nI) ;\n# no newline", "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 6);
+  ASSERT_EQ(tokens->at(0).kind, Kind::kSCombinator);
+  ASSERT_EQ(tokens->at(0).line, 2);
+  ASSERT_EQ(tokens->at(3).kind, Kind::kICombinator);
+  ASSERT_EQ(tokens->at(3).line, 3);
+  ASSERT_EQ(tokens->at(5).kind, Kind::kSemiColon);
+}
+
+TEST(SkiTokenizerTest, TestNextPullsTokensUntilEnd) {
+  std::string source = "def one = inc _0;";
+  Tokenizer tokenizer(source, "test");
+  std::vector<Kind> kinds;
+  for (Token token = tokenizer.next(); token.kind != Kind::kEnd; token = tokenizer.next()) {
+    kinds.push_back(token.kind);
+    // Lexemes are views into the source rather than copies.
+    ASSERT_GE(token.lexeme.data(), source.data());
+    ASSERT_LE(token.lexeme.data() + token.lexeme.size(), source.data() + source.size());
+  }
+  ASSERT_EQ(kinds, (std::vector<Kind>{Kind::kDef, Kind::kIdentifier, Kind::kEqual,
+                                      Kind::kIdentifier, Kind::kIdentifier, Kind::kSemiColon}));
+  ASSERT_EQ(tokenizer.next().kind, Kind::kEnd);
+}
+
+TEST(SkiTokenizerTest, TestCombinatorAtEndOfSource) {
+  // S and B look one character ahead for S' and B*.
+  std::string source = "x SB";
+  Tokenizer tokenizer(std::string_view(source).substr(0, 3), "test");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 2);
+  ASSERT_EQ(tokens->at(1).kind, Kind::kSCombinator);
+}
+
+TEST(SkiTokenizerTest, TestIdentifiersAreInterned) {
+  Tokenizer tokenizer("def f = g f;", "test.ski");
+  auto tokens = tokenizer.tokenize();
+  ASSERT_EQ(tokens->size(), 6);
+  EXPECT_EQ(tokens->at(1).symbol, tokens->at(4).symbol);
+  EXPECT_NE(tokens->at(1).symbol, tokens->at(3).symbol);
+  EXPECT_EQ(tokenizer.get_symbols()->name(tokens->at(3).symbol), "g");
+}